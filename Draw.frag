@@ -8,18 +8,23 @@ layout(push_constant) uniform colorBlock {
     float mixerValue;
 } pushConstantsColorBlock;
 
+// Color mode baked at pipeline creation (SPEC_ID_COLOR_MODE), the branches on it
+// are folded away by the driver. 0 (COLOR_MODE_DYNAMIC) reads it from the push constants.
+layout (constant_id = 0) const int COLOR_MODE = 0;
+
 vec4 red   = vec4(1.0, 0.0, 0.0, 1.0);
 vec4 green = vec4(0.0, 1.0, 0.0, 1.0);
 vec4 blue  = vec4(0.0, 0.0, 1.0, 1.0);
 
 void main()
 {
-    if (pushConstantsColorBlock.constColor == 1)
+    int constColor = (COLOR_MODE == 0) ? pushConstantsColorBlock.constColor : COLOR_MODE;
+    if (constColor == 1)
     outColor = red;
-    else if (pushConstantsColorBlock.constColor == 2)
+    else if (constColor == 2)
     outColor = green;
-    else if (pushConstantsColorBlock.constColor == 3)
+    else if (constColor == 3)
     outColor = blue;
     else
     outColor = color*pushConstantsColorBlock.mixerValue;
-}
\ No newline at end of file
+}
@@ -8,6 +8,9 @@ layout (location = 0) in vec4 pos;
 layout (location = 1) in vec4 inColor;
 layout (location = 0) out vec4 outColor;
 
+// The depth pre-pass and the scene pass must compute the same depth for the EQUAL test
+invariant gl_Position;
+
 void main() {
     outColor      = inColor;
     gl_Position   = myBufferVals.mvp * pos;
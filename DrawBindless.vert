@@ -0,0 +1,25 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Global bindless table, see VulkanBindlessTable (BINDLESS_BINDING_UNIFORM_BUFFER)
+layout (std140, set = 0, binding = 0) uniform bufferVals {
+    mat4 mvp;
+} myBufferVals[];
+
+// The fragment stage owns bytes [0, 8) of the push constant range
+layout (push_constant) uniform drawBlock {
+    layout (offset = 16) uint uniformIndex;
+} pushConstantsDrawBlock;
+
+layout (location = 0) in vec4 pos;
+layout (location = 1) in vec4 inColor;
+layout (location = 0) out vec4 outColor;
+
+// The depth pre-pass and the scene pass must compute the same depth for the EQUAL test
+invariant gl_Position;
+
+void main() {
+    outColor      = inColor;
+    gl_Position   = myBufferVals[pushConstantsDrawBlock.uniformIndex].mvp * pos;
+    gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;
+}
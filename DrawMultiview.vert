@@ -0,0 +1,20 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// One transformation per view of the multiview pass, the array size is MAX_VIEW_COUNT
+layout (std140, binding = 0) uniform bufferVals { // UNIFORM_BLOCK_BINDING_INDEX
+    mat4 mvp[6];
+} myBufferVals;
+
+layout (location = 0) in vec4 pos;
+layout (location = 1) in vec4 inColor;
+layout (location = 0) out vec4 outColor;
+
+// The depth pre-pass and the scene pass must compute the same depth for the EQUAL test
+invariant gl_Position;
+
+void main() {
+    outColor      = inColor;
+    gl_Position   = myBufferVals.mvp[gl_ViewIndex] * pos;
+    gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;
+}
@@ -0,0 +1,19 @@
+#version 450
+
+// The fragment stage owns bytes [0, 8) of the push constant range
+layout (push_constant) uniform transformBlock {
+    layout (offset = 16) mat4 mvp;
+} pushConstantsTransformBlock;
+
+layout (location = 0) in vec4 pos;
+layout (location = 1) in vec4 inColor;
+layout (location = 0) out vec4 outColor;
+
+// The depth pre-pass and the scene pass must compute the same depth for the EQUAL test
+invariant gl_Position;
+
+void main() {
+    outColor      = inColor;
+    gl_Position   = pushConstantsTransformBlock.mvp * pos;
+    gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;
+}
@@ -0,0 +1,46 @@
+# Generates a C++ include file holding the SPIR-V words of each shader as constexpr arrays,
+# followed by the table the shader registry (source/ShaderRegistry.cpp) searches by name.
+#
+# Usage: cmake -DOUTPUT=<file.inl> -DSHADERS=<a.vert.spv|b.frag.spv|...> -P EmbedShaders.cmake
+# The shader list is separated with '|' so it survives the custom command line.
+
+string(REPLACE "|" ";" SHADERS "${SHADERS}")
+
+set(content "// Generated by cmake/EmbedShaders.cmake from the build time SPIR-V, do not edit.\n\n")
+set(table "")
+foreach(spirv IN LISTS SHADERS)
+    # Draw.vert.spv is registered as "Draw.vert" and stored in Draw_vert_spv
+    get_filename_component(fileName ${spirv} NAME)
+    string(REGEX REPLACE "\\.spv$" "" shaderName ${fileName})
+    string(MAKE_C_IDENTIFIER ${fileName} identifier)
+
+    file(READ ${spirv} hex HEX)
+    string(LENGTH "${hex}" hexLength)
+    math(EXPR remainder "${hexLength} % 8")
+    if(hexLength EQUAL 0 OR NOT remainder EQUAL 0)
+        message(FATAL_ERROR "${spirv} is not a SPIR-V binary")
+    endif()
+
+    # SPIR-V words are little endian, rebuild each word from its four bytes, eight words per line
+    # (CMake regular expressions have no {n} repetition, the word pattern is spelled out)
+    set(word "0x........, ")
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " words "${hex}")
+    string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})" "\\1\n        "
+           words "${words}")
+    string(REPLACE " \n" "\n" words "${words}")
+    string(STRIP "${words}" words)
+
+    string(APPEND content "constexpr uint32_t ${identifier}[] = {\n        ${words}\n};\n\n")
+    string(APPEND table "        {\"${shaderName}\", ${identifier}, sizeof(${identifier})},\n")
+endforeach()
+
+# The table ends with an empty entry so it is never zero sized
+string(APPEND content "constexpr EmbeddedShader embeddedShaders[] = {\n${table}        {nullptr, nullptr, 0},\n};\n")
+
+# Only touch the output when it changes, it is included by a source file
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} previous)
+endif()
+if(NOT "${previous}" STREQUAL "${content}")
+    file(WRITE ${OUTPUT} "${content}")
+endif()
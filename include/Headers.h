@@ -19,6 +19,7 @@
 #include <vector>
 #include <iomanip>
 #include <cassert>
+#include <algorithm>
 
 // Header files for Singleton
 #include <memory>
@@ -32,5 +33,6 @@
 /*********** VULKAN HEADER FILES ***********/
 #include <vulkan/vulkan.h>
 #ifdef AUTO_COMPILE_GLSL_TO_SPV
+#include "glslang/Public/ShaderLang.h"
 #include "SPIRV/GlslangToSpv.h"
 #endif
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Headers.h"
+
+// SPIR-V of a shader compiled at build time and embedded in the executable
+struct EmbeddedShader {
+    const char *name;       // Source file name, e.g. "Draw.vert"
+    const uint32_t *code;
+    size_t size;            // Size of the code in bytes
+};
+
+// Returns the embedded SPIR-V of the shader source file, nullptr if it was not compiled in
+const EmbeddedShader *findEmbeddedShader(const char *name);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Headers.h"
+#include <chrono>
+#include <thread>
+
+// Records how long each startup phase takes and on which thread it runs. Phases may be
+// recorded concurrently from worker threads. Once the report is printed the timer stops
+// recording, the phases run again on resize are not startup work.
+class StartupTimer {
+public:
+    StartupTimer();
+
+    ~StartupTimer();
+
+    // Restart the clock, phase times are relative to this point
+    void start();
+
+    void addPhase(const char *name, std::chrono::steady_clock::time_point begin,
+                  std::chrono::steady_clock::time_point end);
+
+    // Print the phases in start order with the thread that ran them, then stop recording
+    void report();
+
+private:
+    struct Phase {
+        std::string name;
+        double beginMs;
+        double durationMs;
+        std::thread::id thread;
+    };
+
+    std::chrono::steady_clock::time_point origin;
+    std::thread::id mainThread;
+    std::vector<Phase> phases;
+    std::mutex mutex;
+    bool recording;
+};
+
+// Times the enclosing scope as one startup phase
+class StartupPhase {
+public:
+    StartupPhase(StartupTimer &startupTimer, const char *phaseName)
+            : timer(startupTimer), name(phaseName), begin(std::chrono::steady_clock::now()) {}
+
+    ~StartupPhase() { timer.addPhase(name, begin, std::chrono::steady_clock::now()); }
+
+private:
+    StartupTimer &timer;
+    const char *name;
+    std::chrono::steady_clock::time_point begin;
+};
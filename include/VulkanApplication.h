@@ -3,10 +3,13 @@
 #include "VulkanInstance.h"
 #include "VulkanDevice.h"
 #include "VulkanRenderer.h"
+#include "StartupTimer.h"
+#include <future>
 
 class VulkanApplication {
 private:
-    // CTOR: Application constructor responsible for layer enumeration.
+    // CTOR: Application constructor responsible for layer enumeration,
+    // which runs on a worker thread while the application initializes.
     VulkanApplication();
 
 public:
@@ -21,6 +24,7 @@ private:
 private:
     bool debugFlag;
     std::vector<VkPhysicalDevice> gpus;
+    std::future<VkResult> layerQuery;
 
 public:
     // Vulkan Instance object
@@ -30,6 +34,9 @@ public:
     bool isPrepared;
     bool isResizing;
 
+    // Per phase startup timing, reported once the first frame is ready to render
+    StartupTimer startupTimer;
+
     static VulkanApplication *GetInstance();
 
     // Simple program life cycle
@@ -54,4 +61,7 @@ private:
                                  std::vector<const char *> &extensions);
 
     VkResult enumeratePhysicalDevices(std::vector<VkPhysicalDevice> &gpus);
+
+    // Wait for the instance layer enumeration started by the constructor
+    void waitForLayerQuery();
 };
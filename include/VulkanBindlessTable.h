@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Headers.h"
+
+class VulkanDevice;
+
+// Requested size of each resource array, clamped against the device limits
+#define BINDLESS_MAX_UNIFORM_BUFFERS 1024
+#define BINDLESS_MAX_STORAGE_BUFFERS 1024
+#define BINDLESS_MAX_COMBINED_IMAGE_SAMPLERS 4096
+
+// Binding points of the resource arrays inside the global descriptor set
+enum BindlessBinding {
+    BINDLESS_BINDING_UNIFORM_BUFFER = 0,
+    BINDLESS_BINDING_STORAGE_BUFFER = 1,
+    BINDLESS_BINDING_COMBINED_IMAGE_SAMPLER = 2,
+    BINDLESS_BINDING_COUNT = 3,
+};
+
+// Global descriptor table using descriptor indexing (Vulkan 1.2). All the resources live in
+// large partially bound arrays of a single set, the set is bound once and shaders index the
+// arrays with a per draw index passed through push constants.
+class VulkanBindlessTable {
+public:
+    VulkanBindlessTable();
+
+    ~VulkanBindlessTable();
+
+    // Create the set layout, the update after bind pool and the global set
+    void initialize(VulkanDevice *device);
+
+    // Write the resource into a free slot of its array and return the slot index
+    uint32_t registerUniformBuffer(const VkDescriptorBufferInfo &bufferInfo);
+
+    uint32_t registerStorageBuffer(const VkDescriptorBufferInfo &bufferInfo);
+
+    uint32_t registerCombinedImageSampler(const VkDescriptorImageInfo &imageInfo);
+
+    // Give back the slot, it will be reused by the next registration
+    void release(BindlessBinding binding, uint32_t index);
+
+    // Release all the slots, the set itself is kept
+    void clear();
+
+    // Bind the global set at set index 0 of the given pipeline layout
+    void bind(VkCommandBuffer cmd, VkPipelineLayout layout);
+
+    void destroy();
+
+    inline bool isInitialized() { return descriptorSet != VK_NULL_HANDLE; }
+
+public:
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    uint32_t capacity[BINDLESS_BINDING_COUNT];
+
+private:
+    uint32_t allocateIndex(BindlessBinding binding);
+
+    void write(BindlessBinding binding, uint32_t index, const VkDescriptorBufferInfo *bufferInfo,
+               const VkDescriptorImageInfo *imageInfo);
+
+private:
+    VulkanDevice *deviceObj;
+    uint32_t nextIndex[BINDLESS_BINDING_COUNT];
+    std::vector<uint32_t> freeIndices[BINDLESS_BINDING_COUNT];
+};
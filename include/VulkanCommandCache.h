@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Headers.h"
+
+class VulkanDevice;
+class VulkanDeletionQueue;
+
+// Everything a cached secondary command buffer depends on. The buffer is replayed as long as the
+// same inputs are requested, any difference records it again.
+struct CommandCacheInputs {
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkPipeline pipeline;
+    VkExtent2D extent;
+
+    bool operator==(const CommandCacheInputs &other) const {
+        return renderPass == other.renderPass && framebuffer == other.framebuffer && pipeline == other.pipeline &&
+               extent.width == other.extent.width && extent.height == other.extent.height;
+    }
+};
+
+// Secondary command buffers recorded once and executed by the per frame primary buffers until
+// their inputs change. There is one slot per (swap chain image, pass) of the owner, a change
+// only records the slots requested afterwards, the others keep replaying their buffer. A
+// replaced buffer may still be pending on the GPU, it is freed through the deletion queue.
+class VulkanCommandCache {
+public:
+    VulkanCommandCache();
+
+    ~VulkanCommandCache();
+
+    // In dynamic rendering mode the inputs have no render pass, the buffers inherit renderingInfo instead
+    void initialize(VulkanDevice *device, VulkanDeletionQueue *deletionQueue, uint32_t queueFamilyIndex,
+                    size_t slotCount, const VkCommandBufferInheritanceRenderingInfo *renderingInfo = nullptr);
+
+    // The GPU must be done with the buffers
+    void destroy();
+
+    // Cached buffer of the slot when it was recorded with these inputs, VK_NULL_HANDLE otherwise
+    VkCommandBuffer find(size_t slot, const CommandCacheInputs &inputs);
+
+    // Begin recording the slot again, the render pass and framebuffer of the inputs are inherited.
+    // The returned buffer is cached for the slot once endRecording() is called.
+    VkCommandBuffer beginRecording(size_t slot, const CommandCacheInputs &inputs);
+
+    void endRecording(size_t slot);
+
+    // Record every slot again on its next use, for changes the inputs do not show (geometry, constants)
+    void invalidate();
+
+    inline uint64_t getRecordCount() { return recordCount; }
+
+    inline uint64_t getReuseCount() { return reuseCount; }
+
+private:
+    struct Slot {
+        VkCommandBuffer cmdBuf;
+        CommandCacheInputs inputs;
+        bool valid;
+    };
+
+    VulkanDevice *deviceObj;
+    VulkanDeletionQueue *deletionQueue;
+    VkCommandPool cmdPool;
+    const VkCommandBufferInheritanceRenderingInfo *renderingInfo;
+    std::vector<Slot> slots;
+    uint64_t recordCount;
+    uint64_t reuseCount;
+};
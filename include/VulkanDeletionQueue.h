@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Headers.h"
+#include "VulkanTimeline.h"
+#include <deque>
+#include <functional>
+
+class VulkanDevice;
+
+// Resources released while the GPU may still use them. Each one is destroyed by collect() once
+// the timeline point given on release is reached, so replacing a resource at runtime (streaming,
+// shader hot reload) never needs a device wide stall. Releasing is thread safe.
+class VulkanDeletionQueue {
+public:
+    VulkanDeletionQueue();
+
+    ~VulkanDeletionQueue();
+
+    void initialize(VulkanDevice *device);
+
+    // Point after which a resource released now is no longer in use, the last graphics
+    // submission. Released resources must not be referenced by new submissions.
+    TimelinePoint getReleasePoint();
+
+    void destroyBuffer(VkBuffer buffer, VkDeviceMemory memory, const TimelinePoint &after);
+
+    void destroyImage(VkImage image, VkImageView view, VkDeviceMemory memory, const TimelinePoint &after);
+
+    void destroyImageView(VkImageView view, const TimelinePoint &after);
+
+    void destroyPipeline(VkPipeline pipeline, const TimelinePoint &after);
+
+    void destroyDescriptorPool(VkDescriptorPool pool, const TimelinePoint &after);
+
+    // Any other destruction, run once the point is reached
+    void enqueue(const TimelinePoint &after, std::function<void()> destroy);
+
+    // Destroy the resources whose point has been reached, called once per frame
+    void collect();
+
+    // Wait for every pending point and destroy everything, before the device goes away
+    void flush();
+
+    inline size_t getPendingCount() { return entries.size(); }
+
+private:
+    struct Entry {
+        TimelinePoint point;
+        std::function<void()> destroy;
+    };
+
+    VulkanDevice *deviceObj;
+    std::deque<Entry> entries;
+    std::mutex mutex;
+};
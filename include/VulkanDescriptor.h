@@ -6,6 +6,13 @@ class VulkanDevice;
 
 class VulkanApplication;
 
+// Selects how the descriptors of a layout are written, this is chosen per layout.
+enum DescriptorUpdateMode {
+    DESCRIPTOR_UPDATE_WRITE_SETS,       // VkWriteDescriptorSet arrays and vkUpdateDescriptorSets()
+    DESCRIPTOR_UPDATE_TEMPLATE,         // VkDescriptorUpdateTemplate applied from a packed struct
+    DESCRIPTOR_UPDATE_PUSH_DESCRIPTOR,  // VK_KHR_push_descriptor, written into the command buffer per draw
+};
+
 class VulkanDescriptor {
 public:
     VulkanDescriptor();
@@ -19,28 +26,39 @@ public:
     // Defines the descriptor sets layout binding and create descriptor layout
     virtual void createDescriptorSetLayout(bool useTexture) = 0;
 
-    // Destroy the valid descriptor layout object
+    // Release the descriptor layout objects, they are owned by the layout cache
     void destroyDescriptorLayout();
 
-    virtual void createDescriptorPool(bool useTexture) = 0;
-
-    void destroyDescriptorPool();
-
     virtual void createDescriptorResources() = 0;
 
+    // Descriptor sets are allocated from the renderer's VulkanDescriptorAllocator,
+    // they are released when its pools are reset, never one by one.
     virtual void createDescriptorSet(bool useTexture) = 0;
 
-    void destroyDescriptorSet();
-
     virtual void createPipelineLayout() = 0;
 
     void destroyPipelineLayouts();
 
+    // Choose the update mode, must be called before the descriptor set layout is created.
+    // Falls back to DESCRIPTOR_UPDATE_TEMPLATE when push descriptors are not supported.
+    void setDescriptorUpdateMode(DescriptorUpdateMode mode);
+
+    // Compile updateTemplateEntries into a descriptor update template. Set based templates
+    // need the descriptor set layout, push descriptor templates need the pipeline layout.
+    void createDescriptorUpdateTemplate();
+
+    void destroyDescriptorUpdateTemplate();
+
+    // Bind the descriptor set of the frame slot or push the descriptors from the packed data at pData
+    void bindDescriptors(VkCommandBuffer cmd, const void *pData, uint32_t frameSlot);
+
 public:
     VkPipelineLayout pipelineLayout;
     std::vector<VkDescriptorSetLayout> descLayout;
-    VkDescriptorPool descriptorPool;
     std::vector<VkDescriptorSet> descriptorSet;
+    DescriptorUpdateMode descriptorUpdateMode;
+    std::vector<VkDescriptorUpdateTemplateEntry> updateTemplateEntries;
+    VkDescriptorUpdateTemplate descriptorUpdateTemplate;
     VulkanDevice* deviceObj;
 };
 
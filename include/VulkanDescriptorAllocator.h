@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Headers.h"
+#include "VulkanFrameCommandPools.h"
+
+class VulkanDevice;
+
+// Default number of descriptor sets a single pool can hold.
+#define DESCRIPTOR_SETS_PER_POOL 256
+
+struct DescriptorAllocatorStatistics {
+    uint32_t persistentPoolCount;   // Pools currently holding persistent sets
+    uint32_t transientPoolCount;    // Pools currently holding transient sets (all frames)
+    uint32_t freePoolCount;         // Reset pools waiting to be recycled
+    uint32_t persistentSetCount;    // Persistent sets allocated since the last reset
+    uint32_t transientSetCount;     // Transient sets allocated in the current frame
+    uint32_t poolGrowCount;         // Pools created because the current one was exhausted
+    uint32_t poolRecycleCount;      // Pools taken from the free list instead of being created
+    uint32_t transientResetCount;   // vkResetDescriptorPool calls issued for transient pools
+};
+
+// Descriptor allocator built on a growing list of large pools. Sets are never freed
+// one by one, instead whole pools are reset with vkResetDescriptorPool and recycled.
+// Persistent sets live until resetPools(), transient sets live for one frame slot.
+class VulkanDescriptorAllocator {
+public:
+    VulkanDescriptorAllocator();
+
+    ~VulkanDescriptorAllocator();
+
+    // Must be called once the logical device exists, it is safe to call it again.
+    void initialize(VulkanDevice *device, uint32_t setsPerPool = DESCRIPTOR_SETS_PER_POOL);
+
+    // Allocate a descriptor set living until resetPools() or destroyPools()
+    VkResult allocatePersistent(VkDescriptorSetLayout layout, VkDescriptorSet *set);
+
+    // Allocate a descriptor set valid only for the current frame
+    VkResult allocateTransient(VkDescriptorSetLayout layout, VkDescriptorSet *set);
+
+    // Switch to the given frame slot, its transient pools are reset in O(1) per pool.
+    // The caller must guarantee the GPU is done with the sets of this slot.
+    void beginFrame(uint32_t frameIndex);
+
+    // Reset all pools (persistent and transient) and keep them for recycling
+    void resetPools();
+
+    // Destroy all the pools owned by the allocator
+    void destroyPools();
+
+    void printStatistics();
+
+public:
+    DescriptorAllocatorStatistics stats;
+
+private:
+    struct PoolList {
+        std::vector<VkDescriptorPool> usedPools; // Pools which have handed out sets
+        VkDescriptorPool currentPool;            // Pool used for the next allocation
+    };
+
+    VkDescriptorPool createPool();
+
+    VkDescriptorPool grabPool();
+
+    VkResult allocate(PoolList &list, VkDescriptorSetLayout layout, VkDescriptorSet *set);
+
+    void resetPoolList(PoolList &list);
+
+    void updatePoolCounts();
+
+private:
+    VulkanDevice *deviceObj;
+    uint32_t maxSetsPerPool;
+    // Number of descriptors of each type per set, scaled by maxSetsPerPool when creating a pool
+    std::vector<std::pair<VkDescriptorType, float>> poolSizeRatios;
+    std::vector<VkDescriptorPool> freePools;
+    PoolList persistentPools;
+    PoolList transientPools[FRAMES_IN_FLIGHT]; // Reset wholesale when the frame slot comes around again
+    uint32_t currentFrame;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Headers.h"
+#include <map>
+#include <tuple>
+
+class VulkanDevice;
+
+// Cache of descriptor set layouts keyed by their create flags and bindings. Identical
+// layouts requested by different drawables or shaders resolve to the same handle, which
+// also makes their descriptor sets and pipeline layouts compatible with each other.
+// The cache owns the layouts, they are only destroyed by destroy().
+class VulkanDescriptorLayoutCache {
+public:
+    VulkanDescriptorLayoutCache();
+
+    ~VulkanDescriptorLayoutCache();
+
+    void initialize(VulkanDevice *device);
+
+    // Returns the cached layout matching the bindings, it is created on the first request.
+    // The bindings do not need to be sorted.
+    VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+                                    VkDescriptorSetLayoutCreateFlags flags = 0);
+
+    void destroy();
+
+private:
+    struct LayoutKey {
+        VkDescriptorSetLayoutCreateFlags flags;
+        std::vector<std::tuple<uint32_t, VkDescriptorType, uint32_t, VkShaderStageFlags>> bindings;
+
+        bool operator<(const LayoutKey &other) const {
+            return std::tie(flags, bindings) < std::tie(other.flags, other.bindings);
+        }
+    };
+
+    VulkanDevice *deviceObj;
+    std::map<LayoutKey, VkDescriptorSetLayout> layouts;
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "VulkanLED.h"
+#include "VulkanTimeline.h"
 
 class VulkanDevice{
 public:
@@ -20,19 +21,85 @@ public:
     uint32_t graphicsQueueWithPresentIndex; // Number of queue family exposed by device
     uint32_t queueFamilyCount; // Device specific layer and extensions
 
+    // Transfer and compute queues. They come from dedicated families when the GPU has them
+    // (transfer only, compute without graphics), otherwise they alias the graphics queue.
+    VkQueue transferQueue;
+    VkQueue computeQueue;
+    uint32_t transferQueueIndex;
+    uint32_t computeQueueIndex;
+
+    // Timeline of each queue, created by getDeviceQueue()
+    VulkanTimeline timelines[QUEUE_TYPE_COUNT];
+
     // Layer and extensions
     VulkanLayerAndExtension layerExtension;
 
+    // Core features exposed by the GPU, the optional ones used are enabled by createDevice()
+    VkPhysicalDeviceFeatures supportedFeatures;
+    bool storageImageExtendedFormatsSupported;
+
+    // Vulkan 1.1 features, the 1.2 and 1.3 ones are chained after them
+    VkPhysicalDeviceVulkan11Features supportedFeatures11;
+    VkPhysicalDeviceVulkan11Features enabledFeatures11;
+    bool multiviewSupported;
+    uint32_t maxMultiviewViewCount;
+
+    // Vulkan 1.2 features exposed by the GPU and the subset enabled on the logical device
+    VkPhysicalDeviceVulkan12Features supportedFeatures12;
+    VkPhysicalDeviceVulkan12Features enabledFeatures12;
+
+    // Vulkan 1.3 features, chained after the 1.2 ones
+    VkPhysicalDeviceVulkan13Features supportedFeatures13;
+    VkPhysicalDeviceVulkan13Features enabledFeatures13;
+    bool descriptorIndexingSupported;
+    bool dynamicRenderingSupported;
+
+    // On a Vulkan 1.2 device synchronization2 comes from VK_KHR_synchronization2, chained
+    // after the 1.2 features instead of the 1.3 ones
+    VkPhysicalDeviceSynchronization2FeaturesKHR supportedSynchronization2;
+    VkPhysicalDeviceSynchronization2FeaturesKHR enabledSynchronization2;
+    bool synchronization2Extension;
+
+    // Synchronization2 commands, the core or the extension entry points
+    PFN_vkCmdPipelineBarrier2 fpCmdPipelineBarrier2;
+    PFN_vkCmdWriteTimestamp2 fpCmdWriteTimestamp2;
+
+    // Optional device extensions, enabled by enableOptionalExtensions() when supported
+    bool pushDescriptorSupported;
+    PFN_vkCmdPushDescriptorSetWithTemplateKHR fpCmdPushDescriptorSetWithTemplateKHR;
+
     VkResult createDevice(std::vector<const char *> & layers, std::vector<const char *> & extensions);
     void destroyDevice();
 
+    // Check if the physical device implementation exposes the extension
+    bool isDeviceExtensionSupported(const char *extensionName);
+
+    // Append the supported optional extensions to the list of extensions to enable
+    void enableOptionalExtensions(std::vector<const char *> &extensions);
+
+    // Query the Vulkan 1.1, 1.2 and 1.3 features and pick the optional ones to enable
+    void getPhysicalDeviceFeatures();
+
     // Get the available queues exposed by the physical devices
     void getPhysicalDeviceQueueAndProperties();
 
     // Query physical device to retrieve queue properties
     uint32_t getGraphicsQueueHandle();
 
+    // Find the transfer and compute families, called after getGraphicsQueueHandle()
+    void getDedicatedQueueFamilies();
+
+    inline bool hasDedicatedTransferQueue() { return transferQueueIndex != graphicsQueueIndex; }
+
+    inline bool hasDedicatedComputeQueue() { return computeQueueIndex != graphicsQueueIndex; }
+
     void getDeviceQueue();
 
+    // Timeline of the queue, aliased queues share the graphics timeline
+    VulkanTimeline *getTimeline(QueueType type);
+
+    // Wait until all the queues have completed their submitted work
+    void waitTimelinesIdle();
+
     bool memoryTypeFromProperties(uint32_t typeBits, VkFlags requirementsMask, uint32_t *typeIndex);
 };
@@ -2,10 +2,21 @@
 
 #include "Headers.h"
 #include "VulkanDescriptor.h"
+#include "VulkanShader.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanFrameCommandPools.h"
+#include "VulkanCommandCache.h"
 #include "Wrappers.h"
 
 class VulkanRenderer;
 
+// Byte offset of the vertex shader push constant block, the fragment shader block
+// (color flag and mixer value) occupies the first bytes of the push constant range.
+#define PUSH_CONSTANT_VERTEX_OFFSET 16
+
+// Size of the per view transformation array of DrawMultiview.vert
+#define MAX_VIEW_COUNT 6
+
 class VulkanDrawable : public VulkanDescriptor {
 public:
     explicit VulkanDrawable(VulkanRenderer *parent = nullptr);
@@ -18,10 +29,27 @@ public:
 
     void prepare();
 
-    void render();
+    // Record the cached draw commands again on the next frames, e.g. after the geometry changed.
+    // Pipeline, render pass, framebuffer and extent changes are detected by the cache.
+    void invalidateCommandBuffers();
+
+    // Secondary command buffer drawing the drawable inside the scene render pass for the
+    // swap chain image, replayed from the cache or recorded for this frame
+    VkCommandBuffer getDrawCommands(int currentBuffer);
+
+    // Draw with the depth only pipeline inside the depth pre-pass
+    void recordDepthCommands(VkCommandBuffer *cmdDraw);
+
+    // Draw inline inside the scene render pass, the bindless table must be bound already
+    void recordSceneCommands(VkCommandBuffer *cmdDraw);
 
+    // Compute the transformations of the frame, writeUniformBuffer() uploads them
     void update();
 
+    // Copy the transformations into the frame slot's region of the uniform buffer, the frame
+    // which last read the region must be complete
+    void writeUniformBuffer(uint32_t frameSlot);
+
     void initViewports(VkCommandBuffer *cmd);
 
     void initScissors(VkCommandBuffer *cmd);
@@ -32,9 +60,11 @@ public:
 
     VkPipeline *getPipeline() { return pipeline; }
 
-    void createUniformBuffer();
+    void setDepthPipeline(VkPipeline *vulkanPipeline) { depthPipeline = vulkanPipeline; }
 
-    void createDescriptorPool(bool useTexture);
+    inline const glm::mat4 &getMVP() { return MVP; }
+
+    void createUniformBuffer();
 
     void createDescriptorResources();
 
@@ -42,26 +72,33 @@ public:
 
     void createDescriptorSetLayout(bool useTexture);
 
+    // Bindless mode: create the uniform buffer and register it in the global table
+    void createBindlessDescriptor();
+
     void createPipelineLayout();
 
+    // Fill viIpAttr from the vertex shader inputs, the shaders and the vertex buffer must exist
+    void createVertexInputAttributes();
+
     void destroyVertexBuffer();
 
     void destroyVertexIndex();
 
-    void destroyCommandBuffer();
-
-    void destroySynchronizationObjects();
+    void destroyCommandCache();
 
     void destroyUniformBuffer();
 
 public:
 
+    // One region per frame slot, the CPU writes a frame's transformations while the GPU may still
+    // read the previous frames' ones
     struct {
         VkBuffer buffer;
         VkDeviceMemory memory;
-        VkDescriptorBufferInfo bufferInfo; // Buffer info that need to supplied into write descriptor set (VkWriteDescriptorSet)
+        VkDescriptorBufferInfo bufferInfo[FRAMES_IN_FLIGHT]; // Buffer info that need to supplied into write descriptor set (VkWriteDescriptorSet)
         VkMemoryRequirements memoryRequirements;
-        std::vector<VkMappedMemoryRange> mappedRange;
+        std::vector<VkMappedMemoryRange> mappedRange;        // Per frame slot
+        VkDeviceSize slotSize;                               // Size of a region, aligned for its offsets
         uint8_t *pData;
     } UniformData;
 
@@ -78,23 +115,49 @@ public:
         VkDescriptorBufferInfo bufferInfo;
     } VertexIndex;
 
+    // Descriptor resources packed in binding order, consumed by the descriptor update template
+    struct {
+        VkDescriptorBufferInfo uniformBuffer; // binding 0
+        VkDescriptorImageInfo textureImage;   // binding 1
+    } DescriptorData;
+
+    // Specialization of the shaders used by the drawable's pipeline
+    ShaderVariantKey shaderVariant;
+
+    // Slots of the uniform buffer regions in the bindless table, the frame's one is pushed to the vertex shader
+    uint32_t bindlessIndices[FRAMES_IN_FLIGHT];
+
+    // Index among the renderer's drawables, selects the query and the indirect draw of the drawable
+    uint32_t objectIndex;
+
+    // Filled by createVertexBuffer(), object space bounds of the positions and number of vertices
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    uint32_t vertexCount;
+
     VkVertexInputBindingDescription viIpBind;
 
-    VkVertexInputAttributeDescription viIpAttr[2];
+    std::vector<VkVertexInputAttributeDescription> viIpAttr;
 private:
-    std::vector<VkCommandBuffer> vecCmdDraw;
+    // Commands inside the render pass instance
+    void recordDrawCommands(VkCommandBuffer *cmdDraw, VkPipeline drawPipeline);
+
+    // Transformations written to the uniform buffer, one per view in multiview mode
+    const void *getUniformData();
+
+    uint32_t getUniformSize();
 
-    void recordCommandBuffer(int currentBuffer, VkCommandBuffer *cmdDraw);
+    VulkanCommandCache cmdCache; // Draw commands per swap chain image and frame slot
 
     VkViewport viewport;
     VkRect2D scissor;
-    VkSemaphore presentCompleteSemaphore;
-    VkSemaphore drawingCompleteSemaphore;
     VulkanRenderer *rendererObj;
     VkPipeline *pipeline;
+    VkPipeline *depthPipeline; // Depth pre-pass, null without pre-pass
 
     glm::mat4 Projection;
     glm::mat4 View;
     glm::mat4 Model;
     glm::mat4 MVP;
+    glm::mat4 viewMVPs[MAX_VIEW_COUNT]; // Multiview, MVP of each view
 };
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Headers.h"
+
+class VulkanDevice;
+
+// Number of frames the CPU may record ahead of the GPU
+#define FRAMES_IN_FLIGHT 2
+
+// Transient command pools of the frames in flight, one per frame slot and recording thread.
+// The command buffers of a frame come from the pools of its slot, they are recorded once and
+// never freed one by one: beginFrame() resets the whole pools of the slot and the buffers are
+// handed out again from the free list. Recording a new command stream every frame costs no
+// allocation once the lists have grown to the frame's needs.
+class VulkanFrameCommandPools {
+public:
+    VulkanFrameCommandPools();
+
+    ~VulkanFrameCommandPools();
+
+    void initialize(VulkanDevice *device, uint32_t queueFamilyIndex, uint32_t threadCount);
+
+    void destroy();
+
+    // Start recording the frame, the GPU must have completed the frame which last used its slot
+    void beginFrame(uint32_t frameIndex);
+
+    // Command buffer of the current frame, not begun. It is valid until the frame slot comes
+    // around again. Each recording thread passes its own index, below the initialized count.
+    VkCommandBuffer getCommandBuffer(uint32_t threadIndex = 0,
+                                     VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    inline uint32_t getThreadCount() { return threadCount; }
+
+private:
+    struct ThreadPool {
+        VkCommandPool pool;
+        std::vector<VkCommandBuffer> buffers[2];    // Primary and secondary free lists
+        uint32_t usedCount[2];                      // Buffers handed out since the last reset
+    };
+
+    VulkanDevice *deviceObj;
+    uint32_t threadCount;
+    uint32_t frameSlot;
+    std::vector<ThreadPool> frames[FRAMES_IN_FLIGHT];
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Headers.h"
+#include "VulkanFrameCommandPools.h"
+
+class VulkanDevice;
+class VulkanDescriptorAllocator;
+
+// Hierarchical-Z occlusion culling in compute. At the end of a frame build() reduces the depth
+// buffer into a pyramid keeping the min and max depth of each texel footprint. Before the next
+// frame draws, cull() projects the bounding box of every object and tests its nearest depth
+// against the farthest depth of the pyramid level where the box covers at most 2x2 texels. The
+// result is written to an indirect draw per object, an occluded object draws no instance: the
+// recorded draw commands never change, only the GPU written arguments do.
+class VulkanHiZCulling {
+public:
+    VulkanHiZCulling();
+
+    ~VulkanHiZCulling();
+
+    // Create the pyramid for the depth buffer extent, the pipelines and the per object buffers.
+    // The pyramid is transitioned in the setup command buffer. The culling sets are transient
+    // sets of the allocator, written each frame. Returns false if the compute shaders are not
+    // available.
+    bool initialize(VulkanDevice *device, VulkanDescriptorAllocator *allocator, VkCommandBuffer setupCmd,
+                    uint32_t width, uint32_t height, uint32_t objectCount);
+
+    // Set the depth buffer the pyramid is built from, once it is created
+    void setDepthImage(VkImage image, VkFormat format);
+
+    void destroy();
+
+    // Bounds and transformation of an object for the frame slot's culling
+    void setObject(uint32_t frameSlot, uint32_t object, const glm::mat4 &mvp, const glm::vec3 &boundsMin,
+                   const glm::vec3 &boundsMax, uint32_t vertexCount);
+
+    // Write the indirect draws of the frame slot's objects, recorded before the draws. The
+    // allocator must have begun the frame.
+    void cull(VkCommandBuffer cmd, uint32_t frameSlot);
+
+    // Reduce the depth buffer, sampled, into the pyramid, in the general layout
+    void build(VkCommandBuffer cmd);
+
+    inline VkImage getPyramidImage() { return pyramid; }
+
+    inline VkImageView getPyramidView() { return pyramidView; }
+
+    inline VkBuffer getIndirectBuffer() { return indirectBuffer.buf; }
+
+    inline bool isInitialized() { return cullPipeline != VK_NULL_HANDLE; }
+
+    void printStatistics();
+
+private:
+    struct Buffer {
+        VkBuffer buf;
+        VkDeviceMemory mem;
+        void *mapped;
+    };
+
+    void createBuffer(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+
+    void destroyBuffer(Buffer &buffer);
+
+    VkPipeline createComputePipeline(const char *shaderName, VkPipelineLayout layout);
+
+    void createPyramid(VkCommandBuffer setupCmd);
+
+    void createDescriptors();
+
+    // Count the objects the last culling of the slot found visible, before the slot is reused
+    void collect(uint32_t frameSlot);
+
+    VulkanDevice *deviceObj;
+    VulkanDescriptorAllocator *descriptorAllocator;
+    uint32_t width, height, mipCount;
+    uint32_t objectCount;
+
+    VkImage pyramid;
+    VkDeviceMemory pyramidMemory;
+    VkImageView pyramidView;                // All the levels, sampled by the culling
+    std::vector<VkImageView> levelViews;    // One level each, written by the build
+    VkImageView depthView;                  // Depth aspect of the depth buffer
+    VkSampler sampler;
+
+    Buffer objectBuffers[FRAMES_IN_FLIGHT]; // Written by the CPU, one per frame slot
+    Buffer indirectBuffer;                  // Written by the culling, read by the draws
+    bool slotCulled[FRAMES_IN_FLIGHT];
+    bool pyramidBuilt;
+
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSetLayout buildSetLayout, cullSetLayout;
+    VkPipelineLayout buildLayout, cullLayout;
+    VkPipeline buildPipeline, cullPipeline;
+    std::vector<VkDescriptorSet> buildSets;     // Per level
+
+    uint64_t testedObjects, visibleObjects;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Headers.h"
+#include "VulkanTimeline.h"
+
+class VulkanDevice;
+
+// Collects the one-shot setup commands of initialization (layout transitions, buffer copies,
+// clears) into a single command buffer. flush() submits it once and waits for its timeline
+// value, the GPU round trips at initialization do not grow with the number of resources.
+class VulkanInitBatch {
+public:
+    VulkanInitBatch();
+
+    ~VulkanInitBatch();
+
+    // Allocate the command buffer from the pool and start recording
+    void begin(VulkanDevice *device, VkCommandPool commandPool);
+
+    // Command buffer to record setup commands into, only valid between begin() and flush()
+    VkCommandBuffer getCommandBuffer();
+
+    inline bool isRecording() { return cmdBuf != VK_NULL_HANDLE; }
+
+    // Make the batch wait on work submitted to another queue, such as the uploads
+    void addWait(const TimelinePoint &point, VkPipelineStageFlags waitStageMask);
+
+    // Submit the recorded commands, wait for them to complete and free the command buffer
+    void flush();
+
+private:
+    VulkanDevice *deviceObj;
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdBuf;
+    std::vector<TimelineWait> waits;
+};
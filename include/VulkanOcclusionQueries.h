@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Headers.h"
+#include "VulkanFrameCommandPools.h"
+
+class VulkanDevice;
+
+// Occlusion queries of the depth pre-pass, one per object and frame slot. The results are read
+// without blocking as soon as the GPU has written them, usually one frame later. An object with
+// no sample passing the depth test is culled from the scene pass until a query sees it again,
+// objects without any result yet are drawn.
+class VulkanOcclusionQueries {
+public:
+    VulkanOcclusionQueries();
+
+    ~VulkanOcclusionQueries();
+
+    // A query inside a multiview pass takes one index per view, the counts may land on any of them
+    void initialize(VulkanDevice *device, uint32_t objectCount, uint32_t viewCount = 1);
+
+    void destroy();
+
+    // Collect the available results and reset the queries of the frame slot, must be recorded
+    // outside of any render pass instance. The frame which last used the slot must be complete.
+    void beginFrame(VkCommandBuffer cmd, uint32_t frameIndex);
+
+    void beginQuery(VkCommandBuffer cmd, uint32_t object);
+
+    void endQuery(VkCommandBuffer cmd, uint32_t object);
+
+    // Visibility according to the latest result, counted in the statistics
+    bool isVisible(uint32_t object);
+
+    inline bool isInitialized() { return queryPool != VK_NULL_HANDLE; }
+
+    void printStatistics();
+
+private:
+    // Read the results the queries of a slot made available
+    void collect(uint32_t slot);
+
+    VulkanDevice *deviceObj;
+    VkQueryPool queryPool;
+    uint32_t objectCount;
+    uint32_t viewCount;     // Consecutive queries used by each object
+    uint32_t frameSlot;
+    uint32_t slotFrames[FRAMES_IN_FLIGHT];  // Frame which issued the queries of each slot, 0 if none
+    std::vector<uint32_t> resultFrames;     // Frame of the latest result of each object
+    std::vector<bool> visible;
+    uint64_t testedDraws, culledDraws;
+};
@@ -1,15 +1,29 @@
 #pragma once
 
 #include "Headers.h"
-class VulkanShader;
+#include "VulkanShader.h"
+#include <map>
+
 class VulkanDrawable;
 class VulkanDevice;
+class VulkanDeletionQueue;
 class VulkanApplication;
 
-// While creating the pipeline the number of viewports and number of scissors.
+// While creating the pipeline the number of viewports and number of scissors. The views of a
+// multiview pass share them, the view index selects the transformation instead.
 #define NUMBER_OF_VIEWPORTS 1
 #define NUMBER_OF_SCISSORS NUMBER_OF_VIEWPORTS
 
+// File the pipeline cache is persisted to between runs, relative to the working directory
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+
+// Pass a pipeline is drawn in, selects its stages, depth and color state
+enum PipelinePass {
+    PIPELINE_PASS_SCENE,        // Depth tested and written, color written
+    PIPELINE_PASS_DEPTH_ONLY,   // Depth pre-pass, vertex stage only and no color attachment
+    PIPELINE_PASS_DEPTH_EQUAL,  // Scene after the pre-pass, shades the front most samples only
+};
+
 class VulkanPipeline {
 public:
     VulkanPipeline();
@@ -18,11 +32,38 @@ public:
     // Creates the pipeline cache object and stores pipeline object
     void createPipelineCache();
 
+    // Read the cache saved by a previous run, only touches the file and pipelineCacheData so it
+    // can run on a worker thread during startup. Returns false if there is no usable cache.
+    bool loadPipelineCacheData(const char *fileName = PIPELINE_CACHE_FILE);
+
+    // Write the cache content kept by destroyPipelineCache()
+    void savePipelineCacheData(const char *fileName = PIPELINE_CACHE_FILE);
+
     // Returns the created pipeline object, it takes the drawable object which contains the vertex input rate and data interpretation information,
     // shader files, boolean flag checking enabled depth, and flag to check if the vertex input are available.
     bool
     createPipeline(VulkanDrawable *drawableObj, VkPipeline *pipeline, VulkanShader *shaderObj, VkBool32 includeDepth,
-                   VkBool32 includeVi = true);
+                   VkBool32 includeVi = true, const ShaderVariantKey *variantKey = nullptr,
+                   PipelinePass pass = PIPELINE_PASS_SCENE);
+
+    // Returns the pipeline built with the shader variant for the key, it is created through the
+    // pipeline cache on first request and shared by all the drawables using the same layout.
+    VkPipeline *getPipelineVariant(VulkanDrawable *drawableObj, VulkanShader *shaderObj,
+                                   const ShaderVariantKey &variantKey, VkBool32 includeDepth,
+                                   PipelinePass pass = PIPELINE_PASS_SCENE);
+
+    // Destroy all the pipelines created by getPipelineVariant()
+    void destroyPipelineVariants();
+
+    // Shader hot reload: build every variant pipeline again with the stages of shaderObj, may run on
+    // a background thread. The new pipelines are kept aside until swapReloadedVariants() is called.
+    bool createReloadedVariants(VulkanShader *shaderObj);
+
+    // Replace the variant pipelines by the reloaded ones, the old ones are released to the
+    // deletion queue and destroyed once the frames still using them are complete
+    void swapReloadedVariants(VulkanDeletionQueue *deletionQueue);
+
+    void discardReloadedVariants();
 
     // Destruct the pipeline cache object
     void destroyPipelineCache();
@@ -31,6 +72,34 @@ public:
     // Pipeline preparation member variables
     // Pipeline cache object
     VkPipelineCache pipelineCache;
+    // Initial data of the pipeline cache, read from disk or kept from the destroyed cache
+    std::vector<uint8_t> pipelineCacheData;
     VulkanApplication* appObj;
     VulkanDevice* deviceObj;
+
+private:
+    struct PipelineVariantKey {
+        VkPipelineLayout layout;
+        ShaderVariantKey shader;
+        PipelinePass pass;
+
+        bool operator<(const PipelineVariantKey &other) const {
+            if (layout != other.layout) {
+                return layout < other.layout;
+            }
+            if (pass != other.pass) {
+                return pass < other.pass;
+            }
+            return shader < other.shader;
+        }
+    };
+
+    struct PipelineVariant {
+        VkPipeline *pipeline;
+        VulkanDrawable *drawable;   // Drawable which requested the variant first, provides the vertex input
+        VkBool32 includeDepth;
+        VkPipeline reloaded;        // Built by createReloadedVariants(), waiting to be swapped in
+    };
+
+    std::map<PipelineVariantKey, PipelineVariant> variantPipelines;
 };
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Headers.h"
+#include "VulkanFrameCommandPools.h"
+#include "VulkanTimeline.h"
+
+class VulkanDevice;
+
+// Post-processing of the presented frames on the compute queue. The last pass of frame N copies
+// the swap chain image into the frame slot's input image. Once the graphics timeline reaches the
+// frame's value the compute queue tone maps the copy, filters its edges FXAA style and
+// downsamples the result into a host visible readback buffer, while the graphics queue already
+// renders frame N+1. Each slot's chain is recorded once and resubmitted, the CPU reads the
+// readback when the slot comes around again.
+class VulkanPostProcess {
+public:
+    VulkanPostProcess();
+
+    ~VulkanPostProcess();
+
+    // Create the images, pipelines and command buffers for frames of the given format and extent.
+    // Returns false if the compute shaders are not available.
+    bool initialize(VulkanDevice *device, VkFormat format, uint32_t width, uint32_t height);
+
+    void destroy();
+
+    // Wait for the chain which last used the slot, its input image can be written again. Its
+    // readback is read for the statistics.
+    void beginFrame(uint32_t frameSlot);
+
+    // Copy the frame, in the transfer source layout, into the slot's input image and hand the
+    // image over to the compute queue. Recorded last in the frame's command buffer.
+    void recordCopy(VkCommandBuffer cmd, uint32_t frameSlot, VkImage frameImage);
+
+    // Submit the slot's chain on the compute queue, it waits for the graphics point of the copy
+    void submit(uint32_t frameSlot, const TimelinePoint &frameComplete);
+
+    inline bool isInitialized() { return tonemapPipeline != VK_NULL_HANDLE; }
+
+    void printStatistics();
+
+private:
+    struct Buffer {
+        VkBuffer buf;
+        VkDeviceMemory mem;
+        void *mapped;
+    };
+
+    struct Image {
+        VkImage image;
+        VkDeviceMemory mem;
+        VkImageView view;
+    };
+
+    void createBuffer(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+
+    void destroyBuffer(Buffer &buffer);
+
+    void createImage(Image &image, VkFormat imageFormat, VkImageUsageFlags usage);
+
+    void destroyImage(Image &image);
+
+    VkPipeline createComputePipeline(const char *shaderName, VkPipelineLayout layout);
+
+    void createDescriptors();
+
+    // Record the slot's chain, from the acquire of its input image to the readback
+    void recordChain(uint32_t frameSlot);
+
+    VulkanDevice *deviceObj;
+    VulkanTimeline *timeline;               // Compute, or the queue it aliases
+    uint32_t graphicsFamily, computeFamily; // The input images change owner when they differ
+    VkFormat format;
+    uint32_t width, height;
+    uint32_t readbackWidth, readbackHeight;
+
+    Image inputImages[FRAMES_IN_FLIGHT];    // Copies of the frames, one per frame slot
+    Image tonemapped, filtered;             // Shared, the compute queue runs the chains in order
+    Buffer readbackBuffers[FRAMES_IN_FLIGHT];
+    VkSampler sampler;
+
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSetLayout imageSetLayout, readbackSetLayout;
+    VkPipelineLayout imageLayout, readbackLayout;
+    VkPipeline tonemapPipeline, fxaaPipeline, downsamplePipeline;
+    VkDescriptorSet tonemapSets[FRAMES_IN_FLIGHT];
+    VkDescriptorSet fxaaSet;
+    VkDescriptorSet downsampleSets[FRAMES_IN_FLIGHT];
+
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdChains[FRAMES_IN_FLIGHT];
+    uint64_t slotValues[FRAMES_IN_FLIGHT];  // Compute timeline value completing each slot's chain
+
+    uint64_t processedFrames, stalledFrames;
+    float lastLuminance;                    // Average over the last readback
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "Headers.h"
+#include <functional>
+
+class VulkanDevice;
+
+// How a pass uses an image, each usage implies its pipeline stages, accesses and layout
+enum ResourceUsage {
+    RESOURCE_USAGE_COLOR_ATTACHMENT,    // Color attachment, written
+    RESOURCE_USAGE_RESOLVE_ATTACHMENT,  // Resolve target of a multisampled color attachment
+    RESOURCE_USAGE_DEPTH_ATTACHMENT,    // Depth attachment, tested and written
+    RESOURCE_USAGE_DEPTH_READ,          // Depth attachment, tested only
+    RESOURCE_USAGE_SAMPLED,             // Sampled by fragment or compute shaders
+    RESOURCE_USAGE_STORAGE_READ,        // Storage image read by compute shaders
+    RESOURCE_USAGE_STORAGE_WRITE,       // Storage image written by compute shaders
+    RESOURCE_USAGE_TRANSFER_SRC,
+    RESOURCE_USAGE_TRANSFER_DST,
+    RESOURCE_USAGE_PRESENT,             // Handed to the presentation engine, final usage only
+};
+
+// Index of an image declared in the graph
+typedef uint32_t RenderGraphResource;
+
+// Load and store operations of an attachment, inferred from the uses of the image around the pass
+struct AttachmentOps {
+    VkAttachmentLoadOp loadOp;
+    VkAttachmentStoreOp storeOp;
+    VkAttachmentLoadOp stencilLoadOp;
+    VkAttachmentStoreOp stencilStoreOp;
+};
+
+// Frame graph of the renderer. Passes declare the images they read and write, compile() orders
+// the accesses and derives for each pass the layout transitions and the memory dependencies it
+// needs, scoped to the exact stages of the previous and next uses (synchronization2). The
+// barriers of a pass are issued in one vkCmdPipelineBarrier2 before it is recorded.
+// Transient images are created by the graph, the ones whose lifetimes do not overlap are bound
+// to the same memory. An attachment living in a single pass is never loaded nor stored, it is
+// created as a transient attachment in lazily allocated memory when the device has such memory.
+// Imported images (swap chain) are provided by the owner every frame.
+class VulkanRenderGraph {
+public:
+    VulkanRenderGraph();
+
+    ~VulkanRenderGraph();
+
+    void initialize(VulkanDevice *device);
+
+    // Image created and owned by the graph, its content does not survive the frame. An image of
+    // several layers, e.g. the views of a multiview pass, gets a 2D array view.
+    RenderGraphResource createImage(const std::string &name, VkFormat format, uint32_t width, uint32_t height,
+                                    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, uint32_t layers = 1);
+
+    // Image owned outside the graph. It enters each frame in initialLayout, after the work of
+    // initialStages, and leaves it transitioned for finalUsage.
+    RenderGraphResource importImage(const std::string &name, VkFormat format, uint32_t width, uint32_t height,
+                                    VkImageLayout initialLayout, VkPipelineStageFlags2 initialStages,
+                                    ResourceUsage finalUsage);
+
+    // Set the handles of an imported image for the next execute(), e.g. the acquired swap chain image
+    void setImportedImage(RenderGraphResource resource, VkImage image, VkImageView view);
+
+    // Passes run in the order they are added
+    uint32_t addPass(const std::string &name, std::function<void(VkCommandBuffer)> record);
+
+    // Declare the use of an image by a pass, a pass uses an image once
+    void use(uint32_t pass, RenderGraphResource resource, ResourceUsage usage);
+
+    // Create the transient images and plan the barriers, the graph must not change afterwards
+    void compile();
+
+    // Record the passes and their barriers
+    void execute(VkCommandBuffer cmd);
+
+    inline VkImage getImage(RenderGraphResource resource) { return resources[resource].image; }
+
+    inline VkImageView getImageView(RenderGraphResource resource) { return resources[resource].view; }
+
+    inline VkImageAspectFlags getImageAspect(RenderGraphResource resource) { return resources[resource].aspectMask; }
+
+    // True if a pass after the given one, or the final usage, needs the image content
+    bool isUsedAfter(RenderGraphResource resource, uint32_t pass);
+
+    // Attachment policy: the content is loaded only if an earlier use defined it, otherwise it is
+    // cleared (or left undefined), and stored only if a later use reads it. A resolve target is
+    // overwritten, it is never loaded.
+    AttachmentOps getAttachmentOps(uint32_t pass, RenderGraphResource resource, bool clear = true);
+
+    // Destroy the transient images and forget the passes, the GPU must be done with them
+    void destroy();
+
+    void printStatistics();
+
+private:
+    // Synchronization scope of the last accesses to an image
+    struct ResourceState {
+        VkImageLayout layout;
+        VkPipelineStageFlags2 writeStages;      // Last write
+        VkAccessFlags2 writeAccess;
+        VkPipelineStageFlags2 readStages;       // Reads since the last write or transition
+        VkPipelineStageFlags2 visibleStages;    // Scope the last write was made visible to
+        VkAccessFlags2 visibleAccess;
+    };
+
+    struct Resource {
+        std::string name;
+        bool imported;
+        VkFormat format;
+        uint32_t width, height;
+        uint32_t layers;
+        VkSampleCountFlagBits samples;
+        VkImageAspectFlags aspectMask;
+        VkImageUsageFlags usage;        // Accumulated from the passes using it
+        bool lazilyAllocated;           // Transient attachment, memory committed on demand
+        ResourceState initialState;     // Imported images, state when entering the frame
+        ResourceUsage finalUsage;
+        VkImage image;
+        VkImageView view;
+        uint32_t firstPass, lastPass;
+        uint32_t memoryBlock;
+    };
+
+    struct PassUse {
+        RenderGraphResource resource;
+        ResourceUsage usage;
+    };
+
+    struct Barrier {
+        RenderGraphResource resource;
+        VkImageLayout oldLayout, newLayout;
+        VkPipelineStageFlags2 srcStages, dstStages;
+        VkAccessFlags2 srcAccess, dstAccess;
+    };
+
+    struct Pass {
+        std::string name;
+        std::function<void(VkCommandBuffer)> record;
+        std::vector<PassUse> uses;
+        std::vector<Barrier> barriers;
+    };
+
+    // Memory shared by the transient images with disjoint lifetimes
+    struct MemoryBlock {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        uint32_t memoryTypeBits;
+        uint32_t lastPass;
+        bool lazilyAllocated;
+    };
+
+    void createTransientImages();
+
+    void planBarriers();
+
+    void recordBarriers(VkCommandBuffer cmd, const std::vector<Barrier> &barriers);
+
+    // Estimated bytes moved between the attachments and memory by the load and store operations
+    void estimateAttachmentTraffic();
+
+    VulkanDevice *deviceObj;
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<Barrier> finalBarriers;
+    std::vector<MemoryBlock> memoryBlocks;
+    VkDeviceSize unaliasedSize;     // Memory the transient images would take without aliasing
+    bool compiled;
+
+    // Attachment traffic of one frame of the compiled graph, and accumulated over the executed
+    // frames. Worst is the traffic if every attachment was loaded and stored.
+    VkDeviceSize frameLoadBytes, frameStoreBytes, frameWorstBytes;
+    uint64_t loadedBytes, storedBytes, worstBytes;
+    uint64_t executedFrames;
+};
@@ -5,9 +5,30 @@
 #include "VulkanDrawable.h"
 #include "VulkanShader.h"
 #include "VulkanPipeline.h"
-
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanDescriptorLayoutCache.h"
+#include "VulkanBindlessTable.h"
+#include "VulkanShaderWatcher.h"
+#include "VulkanInitBatch.h"
+#include "VulkanUploadManager.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanFrameCommandPools.h"
+#include "VulkanRenderGraph.h"
+#include "VulkanOcclusionQueries.h"
+#include "VulkanHiZCulling.h"
+#include "VulkanPostProcess.h"
+#include "VulkanResolutionScaler.h"
+#include <future>
+
+// Default sample count of the scene, setSampleCount() selects another one at runtime
 #define NUM_SAMPLES VK_SAMPLE_COUNT_1_BIT
 
+// Selects how the per drawable transformation reaches the vertex shader
+enum TransformMode {
+    TRANSFORM_UNIFORM_BUFFER,   // MVP in a per drawable uniform buffer read through a descriptor
+    TRANSFORM_PUSH_CONSTANT,    // MVP pushed per draw, no uniform buffer nor descriptor set
+};
+
 class VulkanRenderer {
 public:
     VulkanRenderer(VulkanApplication *app, VulkanDevice *deviceObject);
@@ -24,12 +45,25 @@ public:
 
     void update();
 
+    // Called at the start of each frame before it is rendered
+    void beginFrame();
+
+    // Acquire a swap chain image, record the frame graph into it, submit and present
+    void renderFrame();
+
+    // Called once the frame has been submitted
+    void endFrame();
+
+    // Wait for the shader reload running in the background and swap it in, called
+    // before the renderer objects the reload depends on are destroyed.
+    void finishShaderReload();
+
+    // Stop watching the shader files
+    void stopShaderWatcher();
+
     // Create an empty window
     void createPresentationWindow(const int &windowWidth = 500, const int &windowHeight = 500);
 
-    void setImageLayout(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldImageLayout,
-                        VkImageLayout newImageLayout, VkAccessFlagBits srcAccessMask, const VkCommandBuffer &cmdBuf);
-
     //! Windows procedure method for handling events
     static LRESULT CALLBACK WndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
@@ -51,12 +85,117 @@ public:
 
     inline VulkanPipeline *getPipelineObject() { return &pipelineObj; }
 
+    inline VulkanDescriptorAllocator *getDescriptorAllocator() { return &descriptorAllocator; }
+
+    inline VulkanBindlessTable *getBindlessTable() { return &bindlessTable; }
+
+    inline VulkanDescriptorLayoutCache *getDescriptorLayoutCache() { return &descriptorLayoutCache; }
+
+    inline VulkanUploadManager *getUploadManager() { return &uploadManager; }
+
+    inline VulkanDeletionQueue *getDeletionQueue() { return &deletionQueue; }
+
+    inline VulkanFrameCommandPools *getFrameCommandPools() { return &frameCommandPools; }
+
+    // Slot of the frame being recorded, beginFrame() waited for the frame which last used it
+    inline uint32_t getFrameSlot() { return frameIndex % FRAMES_IN_FLIGHT; }
+
+    inline VulkanRenderGraph *getRenderGraph() { return &renderGraph; }
+
+    inline VulkanOcclusionQueries *getOcclusionQueries() { return &occlusionQueries; }
+
+    inline VulkanHiZCulling *getHiZCulling() { return &hiZCulling; }
+
+    inline VulkanPostProcess *getPostProcess() { return &postProcess; }
+
+    inline VulkanResolutionScaler *getResolutionScaler() { return &resolutionScaler; }
+
+    // Use the global bindless table instead of per drawable descriptor sets,
+    // must be selected before initialize(). Ignored without descriptor indexing.
+    void enableBindless(bool enable);
+
+    inline bool isBindless() { return useBindless && transformMode == TRANSFORM_UNIFORM_BUFFER; }
+
+    // Render with vkCmdBeginRendering instead of render pass and framebuffer objects,
+    // must be selected before initialize(). Ignored without dynamic rendering support.
+    void enableDynamicRendering(bool enable);
+
+    inline bool isDynamicRendering() { return useDynamicRendering; }
+
+    // Inherited by the secondary buffers recorded for the scene pass, null with a render pass
+    inline const VkCommandBufferInheritanceRenderingInfo *getSceneInheritanceRenderingInfo() {
+        return useDynamicRendering ? &sceneInheritanceInfo : nullptr;
+    }
+
+    // Lay down the depth in a depth only pass before the scene pass, which then shades the visible
+    // samples only (depth EQUAL). The pre-pass draws are occlusion queried, the objects they found
+    // hidden are culled from the following scene passes. Must be selected before initialize().
+    void enableDepthPrePass(bool enable);
+
+    inline bool isDepthPrePass() { return useDepthPrePass; }
+
+    // Cull the drawables in compute against a depth pyramid built from the previous frame, the
+    // drawables draw indirectly with the arguments the culling wrote. Must be selected before
+    // initialize(). Ignored without two channel storage images or with a multisampled depth.
+    void enableHiZCulling(bool enable);
+
+    inline bool isHiZCulling() { return useHiZCulling; }
+
+    // Copy each presented frame out and post-process it on the compute queue, overlapping the
+    // rendering of the next frame. Must be selected before initialize(). Ignored when the swap
+    // chain images cannot be a transfer source.
+    void enableAsyncPostProcess(bool enable);
+
+    inline bool isAsyncPostProcess() { return useAsyncPostProcess; }
+
+    // Render the scene at a resolution scaled between minScale and maxScale of the swap chain
+    // extent, chosen each frame so that the GPU time of the scene passes holds budgetMs. The
+    // scene is upscaled into the swap chain image. Must be called once the swap chain is
+    // initialized and before initialize(), ignored without timestamps on the graphics queue or
+    // without blit support for the swap chain format.
+    void setResolutionScaling(float minScale, float maxScale, float budgetMs);
+
+    inline bool isResolutionScaling() { return useResolutionScaling; }
+
+    // Extent the scene passes render at this frame, the swap chain extent without dynamic resolution
+    VkExtent2D getRenderExtent();
+
+    // Multisample the scene color and depth, resolved into the swap chain image at the end of the
+    // pass. Must be called before initialize(), falls back to the highest supported count below.
+    void setSampleCount(VkSampleCountFlagBits samples);
+
+    inline VkSampleCountFlagBits getSampleCount() { return sampleCount; }
+
+    // Render the scene from several views in one multiview pass, the geometry is submitted once
+    // and the vertex shader picks the view's transformation with gl_ViewIndex. The views are
+    // layers of one image, placed side by side in the swap chain image. The transforms go through
+    // uniform buffers. Must be called once the swap chain is initialized and before initialize(),
+    // falls back to a single view without multiview support.
+    void setViewCount(uint32_t views);
+
+    inline uint32_t getViewCount() { return viewCount; }
+
+    // View mask of the scene passes, 0 when a single view is rendered without multiview
+    inline uint32_t getViewMask() { return viewCount > 1 ? (1u << viewCount) - 1 : 0; }
+
+    // Camera of a view relative to the scene camera, the views are spread around the scene
+    glm::mat4 getViewTransform(uint32_t view);
+
+    // Select the transform mode, must be called before initialize(). Falls back
+    // to uniform buffers when the push constant range exceeds the device limit.
+    void setTransformMode(TransformMode mode);
+
+    inline TransformMode getTransformMode() { return transformMode; }
+
     void createCommandPool();
 
     void buildSwapChainAndDepthImage();
 
     void createDepthImage();
 
+    // Declare the passes of the frame and their images, compile the graph
+    void createRenderGraph();
+
     void createVertexBuffer();
 
     void createShaders();
@@ -69,13 +208,9 @@ public:
 
     void createDescriptors();
 
-    void createPushConstants();
-
-    void destroyCommandBuffer();
-
     void destroyCommandPool();
 
-    void destroyDepthBuffer();
+    void destroyRenderGraph();
 
     void destroyDrawableVertexBuffer();
 
@@ -85,12 +220,47 @@ public:
 
     void destroyPipeline();
 
-    void destroyDrawableCommandBuffer();
+    void destroyDrawableCommandCache();
 
-    void destroyDrawableSynchronizationObjects();
+    void destroySynchronizationObjects();
 
     void destroyDrawableUniformBuffer();
 
+private:
+    // The shader can be loaded, compiled at runtime or embedded at build time. A mode whose
+    // shader is missing is disabled before initialize().
+    bool isShaderAvailable(const char *shaderName);
+
+    // Start rebuilding the changed shader stages and their pipelines in the background
+    void updateShaderReload();
+
+    // Background part of the reload, returns false if the new shaders cannot be used
+    bool rebuildShaders();
+
+    // Frame boundary part of the reload, the replaced objects go through the deletion queue
+    void applyShaderReload();
+
+    // Scene pass of the render graph, the drawables inside the render pass instance
+    void recordScenePass(VkCommandBuffer cmd);
+
+    // Depth pre-pass of the render graph, the drawables are recorded inline between their queries
+    void recordDepthPrePass(VkCommandBuffer cmd);
+
+    // Blit each view of the scene into its part of the swap chain image, upscaled from the
+    // render extent with dynamic resolution
+    void recordComposeViews(VkCommandBuffer cmd);
+
+    // Scene pass in dynamic rendering mode, the attachments are given to vkCmdBeginRendering
+    void recordSceneRendering(VkCommandBuffer cmd, const VkClearValue *clearValues,
+                              const std::vector<VkCommandBuffer> &cmdSecondaries);
+
+    // Contents of the scene render pass instance: the drawables' secondary buffers, or the
+    // bindless draws recorded inline after a single bind of the table
+    void recordSceneDraws(VkCommandBuffer cmd, const std::vector<VkCommandBuffer> &cmdSecondaries);
+
+    // Bind the bindless table once for all the draws of the pass
+    void bindBindlessTable(VkCommandBuffer cmd);
+
 public:
 #ifdef _WIN32
 #define APP_NAME_STR_LEN 80
@@ -103,22 +273,33 @@ public:
     xcb_window_t *window;
     xcb_intern_atom_reply_t *reply;
 #endif
+    // Transient image of the render graph
     struct {
         VkFormat format;
         VkImage image;
-        VkDeviceMemory mem;
         VkImageView view;
+        RenderGraphResource resource;
     } Depth;
 
     VkCommandPool cmdPool;
-    VkCommandBuffer cmdDepthImage;
-    VkCommandBuffer cmdVertexBuffer;
-    VkCommandBuffer cmdPushConstant;
+    VulkanInitBatch initBatch; // Setup commands recorded during initialize(), submitted once
+    VulkanFrameCommandPools frameCommandPools; // Per frame command buffers, recorded every frame
 
     VkRenderPass renderPass;
     std::vector<VkFramebuffer> frameBuffers; // Number of frame Buffers corresponding to each swap chain
+    VkRenderPass prePassRenderPass; // Depth pre-pass, depth attachment only
+    VkFramebuffer prePassFrameBuffer;
     std::vector<VkPipeline *> pipelineList; // List of pipelines
     int width, height;
+    uint32_t frameIndex; // Monotonic frame counter
+    uint64_t frameValues[FRAMES_IN_FLIGHT]; // Graphics timeline value completing each frame slot
+    VkSemaphore presentCompleteSemaphores[FRAMES_IN_FLIGHT]; // Swap chain acquire, per frame slot
+    std::vector<VkSemaphore> drawingCompleteSemaphores; // Waited by the present, per swap chain image
+
+    // Dynamic rendering, attachment formats of the scene pass the pipelines are created against
+    VkFormat sceneColorFormat;
+    VkPipelineRenderingCreateInfo sceneRenderingInfo;
+    VkCommandBufferInheritanceRenderingInfo sceneInheritanceInfo;
 private:
     VulkanApplication *application;
     VulkanDevice *deviceObj;
@@ -126,5 +307,37 @@ private:
     std::vector<VulkanDrawable *> drawableList;
     VulkanShader shaderObj;
     VulkanPipeline pipelineObj;
+    VulkanDescriptorAllocator descriptorAllocator;
+    VulkanDescriptorLayoutCache descriptorLayoutCache;
+    VulkanBindlessTable bindlessTable;
+    VulkanUploadManager uploadManager;
+    VulkanDeletionQueue deletionQueue;
+    VulkanRenderGraph renderGraph;
+    RenderGraphResource backBuffer; // Swap chain image acquired for the frame
+    RenderGraphResource sceneColor; // Multisampled color, the scene output when not multisampled
+    RenderGraphResource sceneOutput; // Single sampled scene color, the back buffer with a single full size view
+    RenderGraphResource hiZPyramid; // Kept across frames, the culling reads the previous frame's
+    uint32_t scenePass;
+    uint32_t depthPrePass;
+    VulkanOcclusionQueries occlusionQueries;
+    VulkanHiZCulling hiZCulling;
+    VulkanPostProcess postProcess;
+    VulkanResolutionScaler resolutionScaler;
+    bool useBindless;
+    bool useDynamicRendering;
+    VkSampleCountFlagBits sampleCount;
+    uint32_t viewCount;
+    bool useDepthPrePass;
+    bool useHiZCulling;
+    bool useAsyncPostProcess;
+    bool useResolutionScaling;
+    TransformMode transformMode;
+
+    // Shader hot reload, the files of the vertex and fragment stages are watched
+    VulkanShaderWatcher shaderWatcher;
+    std::string shaderFiles[2];
+    bool reloadStages[2];
+    VulkanShader reloadShaderObj;
+    std::future<bool> shaderReload;
     const bool includeDepth = true;
 };
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Headers.h"
+#include "VulkanFrameCommandPools.h"
+
+class VulkanDevice;
+
+// Dynamic resolution. The scene is rendered into the top left part of a target sized for the
+// swap chain, then upscaled into the swap chain image. The GPU time of the scene passes is
+// measured with a pair of timestamps per frame slot; once the slot's frame has completed the
+// controller moves the scale so that this time holds the budget. The scale drops at once when a
+// frame exceeds the budget and climbs back slowly, a load spike costs resolution, not a frame.
+class VulkanResolutionScaler {
+public:
+    VulkanResolutionScaler();
+
+    ~VulkanResolutionScaler();
+
+    // Bounds of the scale relative to the swap chain extent, within (0, 1], and the GPU time
+    // budget of the scene passes in milliseconds. The scale starts at the upper bound.
+    void setBudget(float minScale, float maxScale, float budgetMs);
+
+    void initialize(VulkanDevice *device);
+
+    void destroy();
+
+    // Read the timings of the frame which last used the slot, update the scale, reset the slot's
+    // queries and write the start timestamp. Recorded first in the frame's command buffer, the
+    // frame which last used the slot must be complete.
+    void beginFrame(VkCommandBuffer cmd, uint32_t frameIndex);
+
+    // Write the end timestamp, recorded once the scene passes are
+    void endScene(VkCommandBuffer cmd);
+
+    // Part of the full extent the frame renders into
+    VkExtent2D getRenderExtent(uint32_t width, uint32_t height);
+
+    inline float getScale() { return scale; }
+
+    inline bool isInitialized() { return queryPool != VK_NULL_HANDLE; }
+
+    void printStatistics();
+
+private:
+    // Feed the controller with the slot's scene time once it is available
+    void collect(uint32_t slot);
+
+    void updateScale(double sceneMs);
+
+    VulkanDevice *deviceObj;
+    VkQueryPool queryPool;
+    double timestampPeriod;                 // Nanoseconds per timestamp tick
+    uint64_t timestampMask;                 // Valid bits of the graphics queue's timestamps
+    uint32_t frameSlot;
+    bool slotPending[FRAMES_IN_FLIGHT];     // The slot's timestamps were written and not read yet
+
+    float minScale, maxScale;
+    float budgetMs;
+    float desiredScale;                     // Continuous output of the controller
+    float scale;                            // Quantized, what the frames render at
+    double averageMs;
+
+    uint64_t measuredFrames, overBudgetFrames, scaleChanges;
+    float lowestScale;
+};
@@ -1,5 +1,36 @@
 #pragma once
 #include "Headers.h"
+#include "VulkanShaderReflection.h"
+#include <map>
+
+// Specialization constant IDs, they must match the constant_id declared in the shaders
+enum ShaderSpecializationId {
+    SPEC_ID_COLOR_MODE = 0, // Draw.frag
+};
+
+// Values of Draw.frag's color mode, COLOR_MODE_DYNAMIC keeps reading it from push constants
+enum ShaderColorMode {
+    COLOR_MODE_DYNAMIC = 0,
+    COLOR_MODE_RED = 1,
+    COLOR_MODE_GREEN = 2,
+    COLOR_MODE_BLUE = 3,
+    COLOR_MODE_MIXED = 4,
+};
+
+// Specialization constant values identifying one shader variant
+struct ShaderVariantKey {
+    int32_t colorMode;
+
+    bool operator<(const ShaderVariantKey &other) const { return colorMode < other.colorMode; }
+};
+
+// Shader stages of a variant together with the specialization data they point to
+struct ShaderVariant {
+    ShaderVariantKey key;
+    VkSpecializationMapEntry fragMapEntries[1];
+    VkSpecializationInfo fragSpecialization;
+    VkPipelineShaderStageCreateInfo stages[2];
+};
 
 class VulkanShader
 {
@@ -7,20 +38,51 @@ public:
     VulkanShader(){}
     ~VulkanShader(){}
 
-    void buildShaderModuleWithSPV(uint32_t *vertShaderText, size_t vertexSPVSize, uint32_t *fragShaderText,
-                               size_t fragmentSPVSize);
+    void buildShaderModuleWithSPV(const uint32_t *vertShaderText, size_t vertexSPVSize,
+                                  const uint32_t *fragShaderText, size_t fragmentSPVSize);
 
     void destroyShaders();
 
+    // Returns the shader stages specialized for the key, generated on first use. The
+    // stages stay valid until the shader modules are destroyed.
+    const VkPipelineShaderStageCreateInfo *getVariantStages(const ShaderVariantKey &key);
+
+    // Hot reload: take the stages of the current shader and build new modules only for the
+    // stages flagged in changed, from the SPIR-V in code. Fails if the new code does not parse
+    // or changes the interface (descriptors, push constants, vertex inputs) of the shader.
+    bool buildReloadedStages(const VulkanShader &current, const std::vector<uint32_t> code[2], const bool changed[2]);
+
+    // Move the stages built by buildReloadedStages() into this shader, the modules they replace are destroyed
+    void replaceStages(VulkanShader &reloaded, const bool changed[2]);
+
+    // Destroy the modules created by buildReloadedStages() when the reload is abandoned
+    void destroyReloadedStages(const bool changed[2]);
+
 #ifdef AUTO_COMPILE_GLSL_TO_SPV
-    bool GLSLtoSPV(const VkShaderStageFlagBits shaderType, const char *pshader, std::vector<unsigned int> &spirv)
+    bool GLSLtoSPV(const VkShaderStageFlagBits shaderType, const char *pshader, std::vector<unsigned int> &spirv);
+
+    void buildShader(const char *vertShaderText, const char *fragShaderText);
+
+    EShLanguage getLanguage(const VkShaderStageFlagBits shaderType);
 
-    void buildShader(const char *vertShaderText, const char *fragShaderText)
+    void initializeResources(TBuiltInResource &Resource);
 
-    EShLanguage getLanguage(const VkShaderStageFlagBits shaderType)
+    // Identifies the glslang build and options, part of the SPIR-V cache key
+    static std::string getCompilerVersion();
 
-    void initializeResources(TBuildInResource &Resource);
+    // Preamble of "#define" lines prepended to both stages, part of the SPIR-V cache key
+    std::string compileDefines;
 #endif
 
     VkPipelineShaderStageCreateInfo shaderStages[2];
+
+    // SPIR-V words of each stage, kept to reflect the shader again when a single stage is reloaded
+    std::vector<uint32_t> stageCode[2];
+
+    // Interface of both stages reflected from their SPIR-V, drives the descriptor set
+    // layouts, the push constant ranges and the vertex input attributes
+    VulkanShaderReflection reflection;
+
+    // Generated variants, std::map keeps the specialization data at a stable address
+    std::map<ShaderVariantKey, ShaderVariant> variants;
 };
\ No newline at end of file
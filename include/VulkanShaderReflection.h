@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Headers.h"
+
+// A descriptor declared by one or more shader stages
+struct ReflectedDescriptorBinding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType descriptorType;
+    uint32_t descriptorCount;       // 0 for runtime sized arrays
+    VkShaderStageFlags stageFlags;  // All the stages using the descriptor
+};
+
+// A vertex shader input variable fed by the vertex buffers
+struct ReflectedVertexInput {
+    uint32_t location;
+    VkFormat format;
+    uint32_t size;
+};
+
+// Minimal SPIR-V reflection. It walks the module binary once and extracts the interface the
+// host side has to match: descriptor bindings, push constant ranges and vertex inputs. Several
+// stages can be reflected into the same object, their bindings and ranges are merged.
+class VulkanShaderReflection {
+public:
+    VulkanShaderReflection();
+
+    ~VulkanShaderReflection();
+
+    // Parse the module and merge its interface, returns false if the binary is not valid SPIR-V
+    bool reflect(const uint32_t *code, size_t codeSize, VkShaderStageFlagBits stage);
+
+    void clear();
+
+    // True when both reflections describe the same descriptors, push constant ranges and vertex inputs
+    bool isCompatible(const VulkanShaderReflection &other) const;
+
+    // Layout bindings of the set ordered by binding number, runtime arrays get runtimeArraySize descriptors
+    std::vector<VkDescriptorSetLayoutBinding> getSetLayoutBindings(uint32_t set, uint32_t runtimeArraySize = 0) const;
+
+    // Number of descriptor sets addressed by the stages (highest set index + 1)
+    uint32_t getSetCount() const;
+
+    // Attributes of the vertex inputs tightly packed in location order for the given vertex
+    // buffer binding. Returns the packed size of one vertex.
+    uint32_t getVertexInputAttributes(uint32_t binding, std::vector<VkVertexInputAttributeDescription> &attributes) const;
+
+public:
+    std::vector<ReflectedDescriptorBinding> descriptorBindings;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+    std::vector<ReflectedVertexInput> vertexInputs;
+
+private:
+    // Result id information collected from the type and decoration instructions
+    struct SpirvId {
+        uint32_t opcode;
+        uint32_t typeId;        // Pointee, element, component or column type
+        uint32_t storageClass;
+        uint32_t width;         // Scalar bit width, vector/matrix/array element count, image dimension
+        uint32_t sampled;       // OpTypeImage sampled operand, OpTypeInt signedness
+        uint32_t constant;      // Value of 32 bit integer constants
+        uint32_t set;
+        uint32_t binding;
+        uint32_t location;
+        uint32_t arrayStride;
+        bool hasSet;
+        bool hasBinding;
+        bool hasLocation;
+        bool isBuiltIn;
+        bool isBufferBlock;
+        std::vector<uint32_t> members;
+        std::vector<uint32_t> memberOffsets;
+    };
+
+    uint32_t getTypeSize(const std::vector<SpirvId> &ids, uint32_t typeId) const;
+
+    VkFormat getVertexFormat(const std::vector<SpirvId> &ids, uint32_t typeId) const;
+
+    void addDescriptorBinding(const std::vector<SpirvId> &ids, const SpirvId &variable, VkShaderStageFlagBits stage);
+
+    void addPushConstantRange(const std::vector<SpirvId> &ids, const SpirvId &variable, VkShaderStageFlagBits stage);
+};
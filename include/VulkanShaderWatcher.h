@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Headers.h"
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <thread>
+
+// Watches shader files from a background thread and reports the ones written since the last
+// query. On Linux the directories of the files are watched with inotify, other platforms poll
+// the last write time of the files.
+class VulkanShaderWatcher {
+public:
+    VulkanShaderWatcher();
+
+    ~VulkanShaderWatcher();
+
+    // Add a file to the watch list, must be called before start()
+    void watch(const std::string &path);
+
+    void start();
+
+    void stop();
+
+    // Returns the watched files changed since the previous call, in the form given to watch()
+    std::vector<std::string> takeChangedFiles();
+
+private:
+    void run();
+
+    // Watched file path, normalized so it can be compared with the event paths
+    static std::string normalize(const std::filesystem::path &path);
+
+private:
+    std::thread thread;
+    std::atomic<bool> running;
+    std::mutex mutex;
+    std::map<std::string, std::string> watchedFiles;    // Normalized path to the path given to watch()
+    std::set<std::string> changedFiles;
+#ifdef __linux__
+    int inotifyFd;
+    std::map<int, std::filesystem::path> watchedDirectories;
+#else
+    std::map<std::string, std::filesystem::file_time_type> lastWriteTimes;
+#endif
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Headers.h"
+
+// Directory of the cached SPIR-V, relative to the working directory
+#define SPIRV_CACHE_DIRECTORY "shader_cache"
+
+// On disk cache of the SPIR-V produced by the runtime GLSL compiler (AUTO_COMPILE_GLSL_TO_SPV).
+// Entries are keyed by a hash of everything that affects the output: the source text, the
+// stage, the preprocessor defines and the compiler version. A changed input gives a new key,
+// stale entries are simply never hit again.
+class VulkanSpirvCache {
+public:
+    explicit VulkanSpirvCache(const std::string &cacheDirectory = SPIRV_CACHE_DIRECTORY);
+
+    ~VulkanSpirvCache();
+
+    // 64 bit FNV-1a hash of the compilation inputs
+    static uint64_t computeKey(const char *source, VkShaderStageFlagBits stage, const std::string &defines,
+                               const std::string &compilerVersion);
+
+    // Returns false on a miss or if the cached file is not valid SPIR-V
+    bool load(uint64_t key, std::vector<unsigned int> &spirv);
+
+    // Write the entry, a failure only costs a recompilation on the next run
+    void store(uint64_t key, const std::vector<unsigned int> &spirv);
+
+public:
+    uint32_t hitCount;
+    uint32_t missCount;
+
+private:
+    std::string getEntryPath(uint64_t key);
+
+private:
+    std::string directory;
+    std::mutex mutex;
+};
@@ -35,6 +35,7 @@ struct SwapChainPublicVariables {
     VkSemaphore presentCompleteSemaphore;
     uint32_t currentColorBuffer;
     VkFormat format;
+    VkImageUsageFlags imageUsage;
 };
 
 class VulkanSwapChain {
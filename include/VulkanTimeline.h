@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Headers.h"
+#include <atomic>
+
+class VulkanDevice;
+
+// Queues owning a timeline, the transfer and compute timelines alias the graphics one when
+// the device has no dedicated family for them.
+enum QueueType {
+    QUEUE_GRAPHICS,
+    QUEUE_TRANSFER,
+    QUEUE_COMPUTE,
+    QUEUE_TYPE_COUNT,
+};
+
+// A point in the history of a queue, reached once the queue's semaphore counter gets to value.
+// A null semaphore is a point which is always reached.
+struct TimelinePoint {
+    VkSemaphore semaphore;
+    uint64_t value;
+};
+
+// Semaphore waited by a submission. Binary semaphores (swap chain acquire) ignore the value.
+struct TimelineWait {
+    VkSemaphore semaphore;
+    uint64_t value;
+    VkPipelineStageFlags stageMask;
+};
+
+// Progress of one queue as a timeline semaphore. Every submission signals the next value of the
+// counter, CPU waits, cross queue dependencies and resource reuse checks are all expressed as
+// (semaphore, value) pairs instead of fences and idle waits. Submissions are serialized by the
+// timeline, the queue must not be used directly from another thread.
+class VulkanTimeline {
+public:
+    VulkanTimeline();
+
+    ~VulkanTimeline();
+
+    void initialize(VulkanDevice *device, VkQueue submitQueue);
+
+    void destroy();
+
+    // Submit the command buffers, signal the next value of the timeline and the optional binary
+    // semaphore (swap chain present). Returns the value signaled once they complete.
+    uint64_t submit(const VkCommandBuffer *cmdBufs, uint32_t cmdBufCount, const std::vector<TimelineWait> &waits = {},
+                    VkSemaphore binarySignal = VK_NULL_HANDLE);
+
+    inline TimelinePoint getPoint(uint64_t value) const { return TimelinePoint{semaphore, value}; }
+
+    // Point reached when all the work submitted so far has completed
+    inline TimelinePoint getLastSubmitted() const { return getPoint(lastSubmittedValue); }
+
+    uint64_t getCompletedValue();
+
+    inline bool isComplete(uint64_t value) { return value <= getCompletedValue(); }
+
+    // Block the calling thread until the timeline reaches value
+    void wait(uint64_t value);
+
+    inline void waitIdle() { wait(lastSubmittedValue); }
+
+    // Wait for a point of any timeline
+    static void wait(VulkanDevice *device, const TimelinePoint &point);
+
+public:
+    VkQueue queue;
+    VkSemaphore semaphore;
+
+private:
+    VulkanDevice *deviceObj;
+    std::atomic<uint64_t> lastSubmittedValue;
+    std::mutex submitMutex;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Headers.h"
+#include "VulkanTimeline.h"
+
+class VulkanDevice;
+
+// Copies data into device local buffers through staging buffers on the transfer queue, so the
+// uploads overlap with the graphics work. When the transfer queue belongs to another family the
+// buffers are released by the transfer queue and acquired by the graphics queue.
+//
+// A batch of uploads is recorded by one thread at a time: uploadBuffer()... then submit(). The
+// graphics submission consuming the buffers records recordAcquireBarriers() and waits on the
+// timeline point it returns, finish() then releases the staging memory.
+class VulkanUploadManager {
+public:
+    VulkanUploadManager();
+
+    ~VulkanUploadManager();
+
+    void initialize(VulkanDevice *device);
+
+    // Record the copy of data into dstBuffer, the first graphics access to the buffer is
+    // described by dstStageMask and dstAccessMask.
+    void uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkPipelineStageFlags dstStageMask,
+                      VkAccessFlags dstAccessMask);
+
+    // Submit the recorded copies on the transfer queue, does nothing if no upload was recorded
+    void submit();
+
+    // Record the ownership acquire of the uploaded buffers on a graphics command buffer. The
+    // submission of that command buffer must wait for the returned point at waitStageMask.
+    // The point has a null semaphore when nothing was submitted.
+    TimelinePoint recordAcquireBarriers(VkCommandBuffer cmdBuf, VkPipelineStageFlags *waitStageMask);
+
+    // Wait for the submitted copies and free the staging buffers
+    void finish();
+
+    void destroy();
+
+private:
+    struct StagingBuffer {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+    };
+
+    void beginCommandBuffer();
+
+private:
+    VulkanDevice *deviceObj;
+    VkCommandPool cmdPool;         // Transfer family pool
+    VkCommandBuffer cmdBuf;        // Copies of the current batch
+    TimelinePoint uploadPoint;     // Reached when the submitted copies are complete
+    bool submitted;
+    std::vector<StagingBuffer> stagingBuffers;
+    std::vector<VkBufferMemoryBarrier> acquireBarriers;
+    VkPipelineStageFlags acquireStageMask;
+};
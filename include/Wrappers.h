@@ -10,6 +10,12 @@ public:
 
     static void beginCommandBuffer(VkCommandBuffer cmdBuf, VkCommandBufferBeginInfo *inCmdBufferInfo = nullptr);
 
+    // Begin a secondary command buffer continuing the subpass 0 of the render pass, or the
+    // dynamic rendering instance described by renderingInfo when there is no render pass
+    static void beginSecondaryCommandBuffer(VkCommandBuffer cmdBuf, VkRenderPass renderPass, VkFramebuffer framebuffer,
+                                            VkCommandBufferUsageFlags flags,
+                                            const VkCommandBufferInheritanceRenderingInfo *renderingInfo = nullptr);
+
     static void endCommandBuffer(VkCommandBuffer cmdBuf);
 
     static void submitCommandBuffer(const VkQueue &queue, const VkCommandBuffer *cmdBufList,
@@ -0,0 +1,15 @@
+#include "ShaderRegistry.h"
+#include <cstring>
+
+// The constexpr SPIR-V arrays and the embeddedShaders table, generated in the
+// build directory by cmake/EmbedShaders.cmake from every .vert/.frag/.comp file.
+#include "EmbeddedShaders.inl"
+
+const EmbeddedShader *findEmbeddedShader(const char *name) {
+    for (const EmbeddedShader *shader = embeddedShaders; shader->name; shader++) {
+        if (strcmp(shader->name, name) == 0) {
+            return shader;
+        }
+    }
+    return nullptr;
+}
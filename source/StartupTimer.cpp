@@ -0,0 +1,68 @@
+#include "StartupTimer.h"
+
+StartupTimer::StartupTimer() {
+    start();
+}
+
+StartupTimer::~StartupTimer() = default;
+
+void StartupTimer::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    origin = std::chrono::steady_clock::now();
+    mainThread = std::this_thread::get_id();
+    phases.clear();
+    recording = true;
+}
+
+void StartupTimer::addPhase(const char *name, std::chrono::steady_clock::time_point begin,
+                            std::chrono::steady_clock::time_point end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!recording) {
+        return;
+    }
+    Phase phase;
+    phase.name = name;
+    phase.beginMs = std::chrono::duration<double, std::milli>(begin - origin).count();
+    phase.durationMs = std::chrono::duration<double, std::milli>(end - begin).count();
+    phase.thread = std::this_thread::get_id();
+    phases.push_back(phase);
+}
+
+void StartupTimer::report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!recording) {
+        return;
+    }
+    recording = false;
+
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin).count();
+    double sumMs = 0.0;
+    std::sort(phases.begin(), phases.end(), [](const Phase &a, const Phase &b) { return a.beginMs < b.beginMs; });
+
+    // Number the worker threads in the order they show up
+    std::vector<std::thread::id> workers;
+    std::ios::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "\nStartup timing" << std::endl;
+    std::cout << "=====================" << std::endl;
+    for (auto &phase : phases) {
+        std::stringstream thread;
+        if (phase.thread == mainThread) {
+            thread << "main";
+        } else {
+            auto worker = std::find(workers.begin(), workers.end(), phase.thread);
+            if (worker == workers.end()) {
+                worker = workers.insert(workers.end(), phase.thread);
+            }
+            thread << "worker " << (worker - workers.begin());
+        }
+        sumMs += phase.durationMs;
+
+        std::cout << "\t|---[" << std::left << std::setw(24) << phase.name << "]--> " << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(9) << phase.beginMs << " ms +" << std::setw(9)
+                  << phase.durationMs << " ms  (" << thread.str() << ")\n";
+    }
+    std::cout << "\t|---[Total]--> " << totalMs << " ms wall clock, " << sumMs << " ms of phases\n";
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
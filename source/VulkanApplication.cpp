@@ -9,8 +9,13 @@ extern std::vector<const char *> layerNames;
 extern std::vector<const char *> deviceExtensionNames;
 
 VulkanApplication::VulkanApplication() {
-    // At application start up, enumerate instance layers
-    instanceObj.layerExtension.getInstanceLayerProperties();
+    // At application start up, enumerate instance layers. The queries go through every layer
+    // library and are slow, they run in the background until the layer list is needed.
+    startupTimer.start();
+    layerQuery = std::async(std::launch::async, [this]() {
+        StartupPhase phase(startupTimer, "Enumerate layers");
+        return instanceObj.layerExtension.getInstanceLayerProperties();
+    });
 
     deviceObj = nullptr;
     debugFlag = true;
@@ -65,16 +70,31 @@ VkResult VulkanApplication::handShakeWithDevice(VkPhysicalDevice *gpu, std::vect
     // Get the memory properties from the physical device or GPU.
     vkGetPhysicalDeviceMemoryProperties(*gpu, &deviceObj->memoryProps);
 
+    // Get the optional features the GPU supports.
+    deviceObj->getPhysicalDeviceFeatures();
+
     // Query the available queues on the physical device and their properties.
     deviceObj->getPhysicalDeviceQueueAndProperties();
 
     // Retrieve the Queue which support graphics pipeline.
     deviceObj->getGraphicsQueueHandle();
 
+    // Look for transfer and compute queues running alongside the graphics queue.
+    deviceObj->getDedicatedQueueFamilies();
+
+    // Enable the optional device extensions this GPU supports.
+    deviceObj->enableOptionalExtensions(extensions);
+
     // Create Logical Device, ensure that this device is connected to graphics queue.
     return deviceObj->createDevice(layers, extensions);
 }
 
+void VulkanApplication::waitForLayerQuery() {
+    if (layerQuery.valid()) {
+        layerQuery.get();
+    }
+}
+
 VkResult VulkanApplication::enumeratePhysicalDevices(std::vector<VkPhysicalDevice> &gpus) {
     uint32_t gpuDeviceCount;
 
@@ -95,11 +115,15 @@ void VulkanApplication::initialize() {
 
     // Check if the supplied layer are support or not
     if (debugFlag) {
+        waitForLayerQuery();
         instanceObj.layerExtension.areLayersSupported(layerNames);
     }
 
     // Create the Vulkan instance with specified layer and extension names.
-    createVulkanInstance(layerNames, instanceExtensionNames, title);
+    {
+        StartupPhase phase(startupTimer, "Create instance");
+        createVulkanInstance(layerNames, instanceExtensionNames, title);
+    }
 
     // Create the debugging report if debugging is enabled
     if (debugFlag) {
@@ -110,11 +134,15 @@ void VulkanApplication::initialize() {
     enumeratePhysicalDevices(gpus);
 
     // This example use only one device which is available first.
+    // The device extensions are queried for each instance layer.
+    waitForLayerQuery();
     if (!gpus.empty()) {
+        StartupPhase phase(startupTimer, "Create device");
         handShakeWithDevice(&gpus[0], layerNames, deviceExtensionNames);
     }
 
     if (!rendererObj) {
+        StartupPhase phase(startupTimer, "Create window");
         rendererObj = new VulkanRenderer(this, deviceObj);
 
         // Create an empty window 500x500
@@ -122,6 +150,61 @@ void VulkanApplication::initialize() {
 
         // Initialize swapChain
         rendererObj->getSwapChain()->initializeSwapChain();
+
+        // Stereo, split screen or a set of cube map faces rendered in one pass
+        if (const char *views = getenv("VULKAN_VIEW_COUNT")) {
+            rendererObj->setViewCount((uint32_t) atoi(views));
+        }
+
+        // The sample count is a deployment choice, quality against fill rate
+        if (const char *samples = getenv("VULKAN_SAMPLE_COUNT")) {
+            rendererObj->setSampleCount((VkSampleCountFlagBits) atoi(samples));
+        }
+
+        // Push the MVP with each draw instead of reading it from a uniform buffer
+        if (const char *pushTransform = getenv("VULKAN_PUSH_CONSTANT_TRANSFORM")) {
+            rendererObj->setTransformMode(atoi(pushTransform) != 0 ? TRANSFORM_PUSH_CONSTANT : TRANSFORM_UNIFORM_BUFFER);
+        }
+
+        // Begin the scene with vkCmdBeginRendering, no render pass nor framebuffer objects
+        if (const char *dynamicRendering = getenv("VULKAN_DYNAMIC_RENDERING")) {
+            rendererObj->enableDynamicRendering(atoi(dynamicRendering) != 0);
+        }
+
+        // Lay down the depth first, the scene shades the visible samples only and the objects
+        // the pre-pass found hidden are culled
+        if (const char *depthPrePass = getenv("VULKAN_DEPTH_PREPASS")) {
+            rendererObj->enableDepthPrePass(atoi(depthPrePass) != 0);
+        }
+
+        // How the drawables write their descriptors: 0 write sets, 1 update templates, 2 push descriptors
+        if (const char *updateMode = getenv("VULKAN_DESCRIPTOR_UPDATE_MODE")) {
+            auto mode = (DescriptorUpdateMode) std::min<uint32_t>((uint32_t) atoi(updateMode),
+                                                                  DESCRIPTOR_UPDATE_PUSH_DESCRIPTOR);
+            for (VulkanDrawable *drawableObj : *rendererObj->getDrawingItems()) {
+                drawableObj->setDescriptorUpdateMode(mode);
+            }
+        }
+
+        // Cull the drawables in compute against the depth pyramid of the previous frame
+        if (const char *hiZCulling = getenv("VULKAN_HIZ_CULLING")) {
+            rendererObj->enableHiZCulling(atoi(hiZCulling) != 0);
+        }
+
+        // One global descriptor table indexed per draw instead of a descriptor set per drawable
+        if (const char *bindless = getenv("VULKAN_BINDLESS")) {
+            rendererObj->enableBindless(atoi(bindless) != 0);
+        }
+
+        // Tone map, filter and read back the presented frames on the compute queue
+        if (const char *postProcess = getenv("VULKAN_ASYNC_POST_PROCESS")) {
+            rendererObj->enableAsyncPostProcess(atoi(postProcess) != 0);
+        }
+
+        // GPU budget of the scene in milliseconds, its resolution drops down to half under load
+        if (const char *budget = getenv("VULKAN_SCENE_BUDGET_MS")) {
+            rendererObj->setResolutionScaling(0.5f, 1.0f, (float) atof(budget));
+        }
     }
     rendererObj->initialize();
 }
@@ -134,7 +217,10 @@ void VulkanApplication::resize() {
 
     isResizing = true;
 
+    // The swap chain and everything sized after it are recreated, the stall cannot be avoided here
     vkDeviceWaitIdle(deviceObj->device);
+    rendererObj->finishShaderReload();
+    rendererObj->getDeletionQueue()->flush();
     rendererObj->destroyFramebuffers();
     rendererObj->destroyCommandPool();
     rendererObj->destroyPipeline();
@@ -142,11 +228,13 @@ void VulkanApplication::resize() {
     for (VulkanDrawable *drawableObj : *rendererObj->getDrawingItems()) {
         drawableObj->destroyDescriptor();
     }
+    rendererObj->getDescriptorAllocator()->resetPools();
+    rendererObj->getBindlessTable()->clear();
     rendererObj->destroyRenderpass();
     rendererObj->getSwapChain()->destroySwapChain();
     rendererObj->destroyDrawableVertexBuffer();
     rendererObj->destroyDrawableUniformBuffer();
-    rendererObj->destroyDepthBuffer();
+    rendererObj->destroyRenderGraph();
     rendererObj->initialize();
     prepare();
 
@@ -154,21 +242,44 @@ void VulkanApplication::resize() {
 }
 
 void VulkanApplication::deInitialize() {
+    // Frames are no longer waited on one by one, let the queues drain
+    vkDeviceWaitIdle(deviceObj->device);
+    rendererObj->stopShaderWatcher();
+    rendererObj->finishShaderReload();
     rendererObj->destroyPipeline();
     rendererObj->getPipelineObject()->destroyPipelineCache();
+    rendererObj->getPipelineObject()->savePipelineCacheData();
     for (VulkanDrawable *drawableObj : *rendererObj->getDrawingItems()) {
         drawableObj->destroyDescriptor();
     }
+    rendererObj->getDescriptorAllocator()->printStatistics();
+    rendererObj->getRenderGraph()->printStatistics();
+    if (rendererObj->getOcclusionQueries()->isInitialized()) {
+        rendererObj->getOcclusionQueries()->printStatistics();
+    }
+    if (rendererObj->getHiZCulling()->isInitialized()) {
+        rendererObj->getHiZCulling()->printStatistics();
+    }
+    if (rendererObj->getPostProcess()->isInitialized()) {
+        rendererObj->getPostProcess()->printStatistics();
+    }
+    if (rendererObj->getResolutionScaler()->isInitialized()) {
+        rendererObj->getResolutionScaler()->printStatistics();
+    }
+    rendererObj->getDescriptorAllocator()->destroyPools();
+    rendererObj->getBindlessTable()->destroy();
+    rendererObj->getDescriptorLayoutCache()->destroy();
+    rendererObj->getUploadManager()->destroy();
+    rendererObj->getDeletionQueue()->flush();
+    rendererObj->destroyDrawableCommandCache();
     rendererObj->getShader()->destroyShaders();
     rendererObj->destroyFramebuffers();
     rendererObj->destroyRenderpass();
     rendererObj->destroyDrawableVertexBuffer();
     rendererObj->destroyDrawableUniformBuffer();
-    rendererObj->destroyDrawableCommandBuffer();
-    rendererObj->destroyDepthBuffer();
+    rendererObj->destroyRenderGraph();
     rendererObj->getSwapChain()->destroySwapChain();
-    rendererObj->destroyCommandBuffer();
-    rendererObj->destroyDrawableSynchronizationObjects();
+    rendererObj->destroySynchronizationObjects();
     rendererObj->destroyCommandPool();
     rendererObj->destroyPresentationWindow();
 
@@ -181,8 +292,14 @@ void VulkanApplication::deInitialize() {
 
 void VulkanApplication::prepare() {
     isPrepared = false;
-    rendererObj->prepare();
+    {
+        StartupPhase phase(startupTimer, "Prepare drawables");
+        rendererObj->prepare();
+    }
     isPrepared = true;
+
+    // The first prepare ends the startup, the timer ignores the later ones
+    startupTimer.report();
 }
 
 void VulkanApplication::update() {
@@ -0,0 +1,211 @@
+#include "VulkanBindlessTable.h"
+#include "VulkanDevice.h"
+
+static const VkDescriptorType bindlessDescriptorTypes[BINDLESS_BINDING_COUNT] = {
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+};
+
+VulkanBindlessTable::VulkanBindlessTable() {
+    deviceObj = nullptr;
+    setLayout = VK_NULL_HANDLE;
+    descriptorPool = VK_NULL_HANDLE;
+    descriptorSet = VK_NULL_HANDLE;
+    memset(capacity, 0, sizeof(capacity));
+    memset(nextIndex, 0, sizeof(nextIndex));
+}
+
+VulkanBindlessTable::~VulkanBindlessTable() = default;
+
+void VulkanBindlessTable::initialize(VulkanDevice *device) {
+    if (isInitialized()) {
+        return;
+    }
+    deviceObj = device;
+    assert(deviceObj->descriptorIndexingSupported);
+
+    VkResult result;
+
+    // Clamp the array sizes against the update after bind limits of the device
+    VkPhysicalDeviceVulkan12Properties props12 = {};
+    props12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 props2 = {};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &props12;
+    vkGetPhysicalDeviceProperties2(*deviceObj->gpu, &props2);
+
+    // Uniform buffers can only use the large update after bind limits when the device supports
+    // it, otherwise they are bound as regular array elements. Each array is bounded by the per
+    // stage and the whole set limits, a combined image sampler counts as an image and a sampler.
+    bool uniformUpdateAfterBind = deviceObj->enabledFeatures12.descriptorBindingUniformBufferUpdateAfterBind;
+    const VkPhysicalDeviceLimits &limits = deviceObj->gpuProps.limits;
+    capacity[BINDLESS_BINDING_UNIFORM_BUFFER] = uniformUpdateAfterBind ?
+            std::min({(uint32_t) BINDLESS_MAX_UNIFORM_BUFFERS,
+                      props12.maxPerStageDescriptorUpdateAfterBindUniformBuffers,
+                      props12.maxDescriptorSetUpdateAfterBindUniformBuffers}) :
+            std::min({(uint32_t) BINDLESS_MAX_UNIFORM_BUFFERS, limits.maxPerStageDescriptorUniformBuffers,
+                      limits.maxDescriptorSetUniformBuffers});
+    capacity[BINDLESS_BINDING_STORAGE_BUFFER] = std::min({(uint32_t) BINDLESS_MAX_STORAGE_BUFFERS,
+                                                          props12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                                                          props12.maxDescriptorSetUpdateAfterBindStorageBuffers});
+    capacity[BINDLESS_BINDING_COMBINED_IMAGE_SAMPLER] = std::min({(uint32_t) BINDLESS_MAX_COMBINED_IMAGE_SAMPLERS,
+                                                                  props12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                                                  props12.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                                                  props12.maxDescriptorSetUpdateAfterBindSampledImages,
+                                                                  props12.maxDescriptorSetUpdateAfterBindSamplers});
+
+    // The set is visible to every stage, all the arrays together count against the resources
+    // one stage may access. Scale them down by the same factor when they do not fit.
+    uint64_t totalCapacity = 0;
+    for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; i++) {
+        totalCapacity += capacity[i];
+    }
+    uint64_t maxResources = props12.maxPerStageUpdateAfterBindResources;
+    if (totalCapacity > maxResources) {
+        for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; i++) {
+            capacity[i] = (uint32_t) (capacity[i] * maxResources / totalCapacity);
+        }
+    }
+
+    // Define one large array per resource type, visible to all the graphics stages
+    VkDescriptorSetLayoutBinding layoutBindings[BINDLESS_BINDING_COUNT];
+    VkDescriptorBindingFlags bindingFlags[BINDLESS_BINDING_COUNT];
+    for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; i++) {
+        layoutBindings[i].binding = i;
+        layoutBindings[i].descriptorType = bindlessDescriptorTypes[i];
+        layoutBindings[i].descriptorCount = capacity[i];
+        layoutBindings[i].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+        layoutBindings[i].pImmutableSamplers = nullptr;
+
+        // Unused slots may hold stale descriptors, and slots can be written while the set is bound
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+    }
+    if (!uniformUpdateAfterBind) {
+        bindingFlags[BINDLESS_BINDING_UNIFORM_BUFFER] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.pNext = nullptr;
+    bindingFlagsInfo.bindingCount = BINDLESS_BINDING_COUNT;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
+    descriptorLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorLayout.pNext = &bindingFlagsInfo;
+    descriptorLayout.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    descriptorLayout.bindingCount = BINDLESS_BINDING_COUNT;
+    descriptorLayout.pBindings = layoutBindings;
+
+    result = vkCreateDescriptorSetLayout(deviceObj->device, &descriptorLayout, nullptr, &setLayout);
+    assert(result == VK_SUCCESS);
+
+    // The pool holds exactly one set, the global table
+    VkDescriptorPoolSize poolSizes[BINDLESS_BINDING_COUNT];
+    for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; i++) {
+        poolSizes[i].type = bindlessDescriptorTypes[i];
+        poolSizes[i].descriptorCount = capacity[i];
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.pNext = nullptr;
+    descriptorPoolCreateInfo.maxSets = 1;
+    descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    descriptorPoolCreateInfo.poolSizeCount = BINDLESS_BINDING_COUNT;
+    descriptorPoolCreateInfo.pPoolSizes = poolSizes;
+
+    result = vkCreateDescriptorPool(deviceObj->device, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
+    assert(result == VK_SUCCESS);
+
+    VkDescriptorSetAllocateInfo dsAllocInfo = {};
+    dsAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    dsAllocInfo.pNext = nullptr;
+    dsAllocInfo.descriptorPool = descriptorPool;
+    dsAllocInfo.descriptorSetCount = 1;
+    dsAllocInfo.pSetLayouts = &setLayout;
+
+    result = vkAllocateDescriptorSets(deviceObj->device, &dsAllocInfo, &descriptorSet);
+    assert(result == VK_SUCCESS);
+
+    clear();
+}
+
+uint32_t VulkanBindlessTable::allocateIndex(BindlessBinding binding) {
+    if (!freeIndices[binding].empty()) {
+        uint32_t index = freeIndices[binding].back();
+        freeIndices[binding].pop_back();
+        return index;
+    }
+
+    if (nextIndex[binding] >= capacity[binding]) {
+        std::cout << "Bindless table is full for binding " << binding << ", capacity " << capacity[binding] << "\n";
+        assert(0);
+        return UINT32_MAX;
+    }
+    return nextIndex[binding]++;
+}
+
+void VulkanBindlessTable::write(BindlessBinding binding, uint32_t index, const VkDescriptorBufferInfo *bufferInfo,
+                                const VkDescriptorImageInfo *imageInfo) {
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.pNext = nullptr;
+    write.dstSet = descriptorSet;
+    write.dstBinding = binding;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = bindlessDescriptorTypes[binding];
+    write.pBufferInfo = bufferInfo;
+    write.pImageInfo = imageInfo;
+
+    vkUpdateDescriptorSets(deviceObj->device, 1, &write, 0, nullptr);
+}
+
+uint32_t VulkanBindlessTable::registerUniformBuffer(const VkDescriptorBufferInfo &bufferInfo) {
+    uint32_t index = allocateIndex(BINDLESS_BINDING_UNIFORM_BUFFER);
+    write(BINDLESS_BINDING_UNIFORM_BUFFER, index, &bufferInfo, nullptr);
+    return index;
+}
+
+uint32_t VulkanBindlessTable::registerStorageBuffer(const VkDescriptorBufferInfo &bufferInfo) {
+    uint32_t index = allocateIndex(BINDLESS_BINDING_STORAGE_BUFFER);
+    write(BINDLESS_BINDING_STORAGE_BUFFER, index, &bufferInfo, nullptr);
+    return index;
+}
+
+uint32_t VulkanBindlessTable::registerCombinedImageSampler(const VkDescriptorImageInfo &imageInfo) {
+    uint32_t index = allocateIndex(BINDLESS_BINDING_COMBINED_IMAGE_SAMPLER);
+    write(BINDLESS_BINDING_COMBINED_IMAGE_SAMPLER, index, nullptr, &imageInfo);
+    return index;
+}
+
+void VulkanBindlessTable::release(BindlessBinding binding, uint32_t index) {
+    assert(index < nextIndex[binding]);
+    freeIndices[binding].push_back(index);
+}
+
+void VulkanBindlessTable::clear() {
+    for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; i++) {
+        nextIndex[i] = 0;
+        freeIndices[i].clear();
+    }
+}
+
+void VulkanBindlessTable::bind(VkCommandBuffer cmd, VkPipelineLayout layout) {
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &descriptorSet, 0, nullptr);
+}
+
+void VulkanBindlessTable::destroy() {
+    if (!isInitialized()) {
+        return;
+    }
+    // Destroying the pool frees the global set
+    vkDestroyDescriptorPool(deviceObj->device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(deviceObj->device, setLayout, nullptr);
+    descriptorPool = VK_NULL_HANDLE;
+    descriptorSet = VK_NULL_HANDLE;
+    setLayout = VK_NULL_HANDLE;
+    clear();
+}
@@ -0,0 +1,99 @@
+#include "VulkanCommandCache.h"
+#include "VulkanDevice.h"
+#include "VulkanDeletionQueue.h"
+#include "Wrappers.h"
+
+VulkanCommandCache::VulkanCommandCache() {
+    deviceObj = nullptr;
+    deletionQueue = nullptr;
+    cmdPool = VK_NULL_HANDLE;
+    renderingInfo = nullptr;
+    recordCount = 0;
+    reuseCount = 0;
+}
+
+VulkanCommandCache::~VulkanCommandCache() = default;
+
+void VulkanCommandCache::initialize(VulkanDevice *device, VulkanDeletionQueue *queue, uint32_t queueFamilyIndex,
+                                    size_t slotCount, const VkCommandBufferInheritanceRenderingInfo *inheritedRendering) {
+    deviceObj = device;
+    deletionQueue = queue;
+    renderingInfo = inheritedRendering;
+
+    // Buffers are recorded once and freed when replaced, never reset
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.pNext = nullptr;
+    cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+    cmdPoolInfo.flags = 0;
+
+    VkResult result = vkCreateCommandPool(deviceObj->device, &cmdPoolInfo, nullptr, &cmdPool);
+    assert(result == VK_SUCCESS);
+
+    slots.assign(slotCount, Slot{VK_NULL_HANDLE, {}, false});
+}
+
+void VulkanCommandCache::destroy() {
+    if (deviceObj == nullptr) {
+        return;
+    }
+    // Destroying the pool frees the cached buffers
+    vkDestroyCommandPool(deviceObj->device, cmdPool, nullptr);
+    cmdPool = VK_NULL_HANDLE;
+    slots.clear();
+    deviceObj = nullptr;
+}
+
+VkCommandBuffer VulkanCommandCache::find(size_t slot, const CommandCacheInputs &inputs) {
+    assert(slot < slots.size());
+    if (!slots[slot].valid || !(slots[slot].inputs == inputs)) {
+        return VK_NULL_HANDLE;
+    }
+    reuseCount++;
+    return slots[slot].cmdBuf;
+}
+
+VkCommandBuffer VulkanCommandCache::beginRecording(size_t slot, const CommandCacheInputs &inputs) {
+    assert(slot < slots.size());
+    Slot &cached = slots[slot];
+
+    // The previous buffer may be pending in the frames in flight, free it once they are done.
+    // Freeing goes through the pool, the deletion queue is collected on the recording thread.
+    if (cached.cmdBuf != VK_NULL_HANDLE) {
+        VkDevice device = deviceObj->device;
+        VkCommandPool pool = cmdPool;
+        VkCommandBuffer cmdBuf = cached.cmdBuf;
+        deletionQueue->enqueue(deletionQueue->getReleasePoint(), [device, pool, cmdBuf]() {
+            vkFreeCommandBuffers(device, pool, 1, &cmdBuf);
+        });
+    }
+
+    VkCommandBufferAllocateInfo cmdInfo = {};
+    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdInfo.pNext = nullptr;
+    cmdInfo.commandPool = cmdPool;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    cmdInfo.commandBufferCount = 1;
+    CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &cached.cmdBuf, &cmdInfo);
+    cached.inputs = inputs;
+    cached.valid = false;
+
+    // Replayed by several frames, possibly while a previous submission is still pending
+    CommandBufferMgr::beginSecondaryCommandBuffer(cached.cmdBuf, inputs.renderPass, inputs.framebuffer,
+                                                  VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, renderingInfo);
+
+    recordCount++;
+    return cached.cmdBuf;
+}
+
+void VulkanCommandCache::endRecording(size_t slot) {
+    assert(slot < slots.size());
+    CommandBufferMgr::endCommandBuffer(slots[slot].cmdBuf);
+    slots[slot].valid = true;
+}
+
+void VulkanCommandCache::invalidate() {
+    for (auto &slot : slots) {
+        slot.valid = false;
+    }
+}
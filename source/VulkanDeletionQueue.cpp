@@ -0,0 +1,106 @@
+#include "VulkanDeletionQueue.h"
+#include "VulkanDevice.h"
+#include <map>
+
+VulkanDeletionQueue::VulkanDeletionQueue() {
+    deviceObj = nullptr;
+}
+
+VulkanDeletionQueue::~VulkanDeletionQueue() = default;
+
+void VulkanDeletionQueue::initialize(VulkanDevice *device) {
+    deviceObj = device;
+}
+
+TimelinePoint VulkanDeletionQueue::getReleasePoint() {
+    // The entries hold a single point, the graphics timeline covers the other queues when they
+    // are aliased. With dedicated queues the graphics work waits on their submissions before
+    // consuming their results, the latest graphics submission is the last user.
+    return deviceObj->getTimeline(QUEUE_GRAPHICS)->getLastSubmitted();
+}
+
+void VulkanDeletionQueue::destroyBuffer(VkBuffer buffer, VkDeviceMemory memory, const TimelinePoint &after) {
+    VkDevice device = deviceObj->device;
+    enqueue(after, [device, buffer, memory]() {
+        vkDestroyBuffer(device, buffer, nullptr);
+        vkFreeMemory(device, memory, nullptr);
+    });
+}
+
+void VulkanDeletionQueue::destroyImage(VkImage image, VkImageView view, VkDeviceMemory memory,
+                                       const TimelinePoint &after) {
+    VkDevice device = deviceObj->device;
+    enqueue(after, [device, image, view, memory]() {
+        vkDestroyImageView(device, view, nullptr);
+        vkDestroyImage(device, image, nullptr);
+        vkFreeMemory(device, memory, nullptr);
+    });
+}
+
+void VulkanDeletionQueue::destroyImageView(VkImageView view, const TimelinePoint &after) {
+    VkDevice device = deviceObj->device;
+    enqueue(after, [device, view]() { vkDestroyImageView(device, view, nullptr); });
+}
+
+void VulkanDeletionQueue::destroyPipeline(VkPipeline pipeline, const TimelinePoint &after) {
+    VkDevice device = deviceObj->device;
+    enqueue(after, [device, pipeline]() { vkDestroyPipeline(device, pipeline, nullptr); });
+}
+
+void VulkanDeletionQueue::destroyDescriptorPool(VkDescriptorPool pool, const TimelinePoint &after) {
+    VkDevice device = deviceObj->device;
+    enqueue(after, [device, pool]() { vkDestroyDescriptorPool(device, pool, nullptr); });
+}
+
+void VulkanDeletionQueue::enqueue(const TimelinePoint &after, std::function<void()> destroy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.push_back(Entry{after, std::move(destroy)});
+}
+
+void VulkanDeletionQueue::collect() {
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Query each timeline once, entries of the same timeline are released in order but
+        // entries of different timelines interleave, scan the whole queue.
+        std::map<VkSemaphore, uint64_t> completedValues;
+        for (auto entry = entries.begin(); entry != entries.end();) {
+            bool reached = entry->point.semaphore == VK_NULL_HANDLE;
+            if (!reached) {
+                auto completed = completedValues.find(entry->point.semaphore);
+                if (completed == completedValues.end()) {
+                    uint64_t value = 0;
+                    VkResult result = vkGetSemaphoreCounterValue(deviceObj->device, entry->point.semaphore, &value);
+                    assert(result == VK_SUCCESS);
+                    completed = completedValues.emplace(entry->point.semaphore, value).first;
+                }
+                reached = entry->point.value <= completed->second;
+            }
+
+            if (reached) {
+                ready.push_back(std::move(entry->destroy));
+                entry = entries.erase(entry);
+            } else {
+                ++entry;
+            }
+        }
+    }
+
+    // Destroy outside the lock, a worker may be releasing resources meanwhile
+    for (auto &destroy : ready) {
+        destroy();
+    }
+}
+
+void VulkanDeletionQueue::flush() {
+    std::deque<Entry> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(entries);
+    }
+    for (auto &entry : pending) {
+        VulkanTimeline::wait(deviceObj, entry.point);
+        entry.destroy();
+    }
+}
@@ -3,6 +3,8 @@
 
 VulkanDescriptor::VulkanDescriptor() {
     deviceObj = VulkanApplication::GetInstance()->deviceObj;
+    descriptorUpdateMode = DESCRIPTOR_UPDATE_TEMPLATE;
+    descriptorUpdateTemplate = VK_NULL_HANDLE;
 }
 
 VulkanDescriptor::~VulkanDescriptor() {
@@ -12,25 +14,21 @@ void VulkanDescriptor::createDescriptor(bool useTexture) {
     // Create the uniform buffer resource
     createDescriptorResources();
 
-    // Create the descriptor pool and
-    // use it for descriptor set allocation
-    createDescriptorPool(useTexture);
-
     // Create descriptor set with uniform buffer data in it
     createDescriptorSet(useTexture);
 }
 
 void VulkanDescriptor::destroyDescriptor() {
+    destroyDescriptorUpdateTemplate();
     destroyDescriptorLayout();
     destroyPipelineLayouts();
-    destroyDescriptorSet();
-    destroyDescriptorPool();
+
+    // The sets go back to the allocator with its next pool reset
+    descriptorSet.clear();
 }
 
 void VulkanDescriptor::destroyDescriptorLayout() {
-    for (auto &i : descLayout) {
-        vkDestroyDescriptorSetLayout(deviceObj->device, i, nullptr);
-    }
+    // The layouts belong to the renderer's VulkanDescriptorLayoutCache, only drop the references
     descLayout.clear();
 }
 
@@ -38,10 +36,57 @@ void VulkanDescriptor::destroyPipelineLayouts() {
     vkDestroyPipelineLayout(deviceObj->device, pipelineLayout, nullptr);
 }
 
-void VulkanDescriptor::destroyDescriptorPool() {
-    vkDestroyDescriptorPool(deviceObj->device, descriptorPool, nullptr);
+void VulkanDescriptor::setDescriptorUpdateMode(DescriptorUpdateMode mode) {
+    if (mode == DESCRIPTOR_UPDATE_PUSH_DESCRIPTOR && !deviceObj->pushDescriptorSupported) {
+        std::cout << "VK_KHR_push_descriptor is not supported, using descriptor update templates\n";
+        mode = DESCRIPTOR_UPDATE_TEMPLATE;
+    }
+    descriptorUpdateMode = mode;
+}
+
+void VulkanDescriptor::createDescriptorUpdateTemplate() {
+    if (descriptorUpdateMode == DESCRIPTOR_UPDATE_WRITE_SETS) {
+        return;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.pNext = nullptr;
+    templateInfo.flags = 0;
+    templateInfo.descriptorUpdateEntryCount = (uint32_t) updateTemplateEntries.size();
+    templateInfo.pDescriptorUpdateEntries = updateTemplateEntries.data();
+
+    if (descriptorUpdateMode == DESCRIPTOR_UPDATE_PUSH_DESCRIPTOR) {
+        // Push descriptor templates write straight into the command buffer
+        // and are bound to set 0 of the pipeline layout.
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+        templateInfo.descriptorSetLayout = VK_NULL_HANDLE;
+        templateInfo.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        templateInfo.pipelineLayout = pipelineLayout;
+        templateInfo.set = 0;
+    } else {
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = descLayout[0];
+    }
+
+    VkResult result;
+    result = vkCreateDescriptorUpdateTemplate(deviceObj->device, &templateInfo, nullptr, &descriptorUpdateTemplate);
+    assert(result == VK_SUCCESS);
+}
+
+void VulkanDescriptor::destroyDescriptorUpdateTemplate() {
+    if (descriptorUpdateTemplate == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyDescriptorUpdateTemplate(deviceObj->device, descriptorUpdateTemplate, nullptr);
+    descriptorUpdateTemplate = VK_NULL_HANDLE;
 }
 
-void VulkanDescriptor::destroyDescriptorSet() {
-    vkFreeDescriptorSets(deviceObj->device, descriptorPool, (uint32_t) descriptorSet.size(), &descriptorSet[0]);
-}
\ No newline at end of file
+void VulkanDescriptor::bindDescriptors(VkCommandBuffer cmd, const void *pData, uint32_t frameSlot) {
+    if (descriptorUpdateMode == DESCRIPTOR_UPDATE_PUSH_DESCRIPTOR) {
+        deviceObj->fpCmdPushDescriptorSetWithTemplateKHR(cmd, descriptorUpdateTemplate, pipelineLayout, 0, pData);
+        return;
+    }
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                            0, 1, &descriptorSet[frameSlot], 0, nullptr);
+}
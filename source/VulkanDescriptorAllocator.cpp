@@ -0,0 +1,174 @@
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanDevice.h"
+
+VulkanDescriptorAllocator::VulkanDescriptorAllocator() {
+    memset(&stats, 0, sizeof(stats));
+    deviceObj = nullptr;
+    maxSetsPerPool = DESCRIPTOR_SETS_PER_POOL;
+    persistentPools.currentPool = VK_NULL_HANDLE;
+    for (auto &list : transientPools) {
+        list.currentPool = VK_NULL_HANDLE;
+    }
+    currentFrame = 0;
+}
+
+VulkanDescriptorAllocator::~VulkanDescriptorAllocator() = default;
+
+void VulkanDescriptorAllocator::initialize(VulkanDevice *device, uint32_t setsPerPool) {
+    deviceObj = device;
+    maxSetsPerPool = setsPerPool;
+
+    // Descriptor count per set for each descriptor type, a pool created
+    // for N sets will contain N * ratio descriptors of this type.
+    poolSizeRatios = {
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         2.0f},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1.0f},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          0.5f},
+    };
+}
+
+VkDescriptorPool VulkanDescriptorAllocator::createPool() {
+    VkResult result;
+    std::vector<VkDescriptorPoolSize> descriptorTypePool;
+    for (auto &ratio : poolSizeRatios) {
+        descriptorTypePool.push_back(VkDescriptorPoolSize{ratio.first, (uint32_t) (ratio.second * maxSetsPerPool)});
+    }
+
+    // No FREE_DESCRIPTOR_SET_BIT, sets are only released by resetting the whole pool
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.pNext = nullptr;
+    descriptorPoolCreateInfo.maxSets = maxSetsPerPool;
+    descriptorPoolCreateInfo.flags = 0;
+    descriptorPoolCreateInfo.poolSizeCount = (uint32_t) descriptorTypePool.size();
+    descriptorPoolCreateInfo.pPoolSizes = descriptorTypePool.data();
+
+    VkDescriptorPool pool;
+    result = vkCreateDescriptorPool(deviceObj->device, &descriptorPoolCreateInfo, nullptr, &pool);
+    assert(result == VK_SUCCESS);
+    return pool;
+}
+
+// Returns a reset pool from the free list, or create a new one if the list is empty
+VkDescriptorPool VulkanDescriptorAllocator::grabPool() {
+    if (!freePools.empty()) {
+        VkDescriptorPool pool = freePools.back();
+        freePools.pop_back();
+        stats.poolRecycleCount++;
+        return pool;
+    }
+    return createPool();
+}
+
+VkResult VulkanDescriptorAllocator::allocate(PoolList &list, VkDescriptorSetLayout layout, VkDescriptorSet *set) {
+    assert(deviceObj != nullptr);
+
+    if (list.currentPool == VK_NULL_HANDLE) {
+        list.currentPool = grabPool();
+        list.usedPools.push_back(list.currentPool);
+    }
+
+    VkDescriptorSetAllocateInfo dsAllocInfo = {};
+    dsAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    dsAllocInfo.pNext = nullptr;
+    dsAllocInfo.descriptorPool = list.currentPool;
+    dsAllocInfo.descriptorSetCount = 1;
+    dsAllocInfo.pSetLayouts = &layout;
+
+    VkResult result = vkAllocateDescriptorSets(deviceObj->device, &dsAllocInfo, set);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        // The current pool is exhausted, grow the list with a new pool and retry once.
+        list.currentPool = grabPool();
+        list.usedPools.push_back(list.currentPool);
+        stats.poolGrowCount++;
+
+        dsAllocInfo.descriptorPool = list.currentPool;
+        result = vkAllocateDescriptorSets(deviceObj->device, &dsAllocInfo, set);
+    }
+    updatePoolCounts();
+    return result;
+}
+
+VkResult VulkanDescriptorAllocator::allocatePersistent(VkDescriptorSetLayout layout, VkDescriptorSet *set) {
+    VkResult result = allocate(persistentPools, layout, set);
+    if (result == VK_SUCCESS) {
+        stats.persistentSetCount++;
+    }
+    return result;
+}
+
+VkResult VulkanDescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout, VkDescriptorSet *set) {
+    VkResult result = allocate(transientPools[currentFrame], layout, set);
+    if (result == VK_SUCCESS) {
+        stats.transientSetCount++;
+    }
+    return result;
+}
+
+void VulkanDescriptorAllocator::resetPoolList(PoolList &list) {
+    for (VkDescriptorPool pool : list.usedPools) {
+        vkResetDescriptorPool(deviceObj->device, pool, 0);
+        freePools.push_back(pool);
+    }
+    list.usedPools.clear();
+    list.currentPool = VK_NULL_HANDLE;
+}
+
+void VulkanDescriptorAllocator::beginFrame(uint32_t frameIndex) {
+    currentFrame = frameIndex % FRAMES_IN_FLIGHT;
+
+    // Everything allocated in this slot FRAMES_IN_FLIGHT frames ago is released at once
+    stats.transientResetCount += (uint32_t) transientPools[currentFrame].usedPools.size();
+    resetPoolList(transientPools[currentFrame]);
+    stats.transientSetCount = 0;
+    updatePoolCounts();
+}
+
+void VulkanDescriptorAllocator::resetPools() {
+    if (!deviceObj) {
+        return;
+    }
+    resetPoolList(persistentPools);
+    for (auto &list : transientPools) {
+        resetPoolList(list);
+    }
+    stats.persistentSetCount = 0;
+    stats.transientSetCount = 0;
+    updatePoolCounts();
+}
+
+void VulkanDescriptorAllocator::destroyPools() {
+    if (!deviceObj) {
+        return;
+    }
+    resetPools();
+    for (VkDescriptorPool pool : freePools) {
+        vkDestroyDescriptorPool(deviceObj->device, pool, nullptr);
+    }
+    freePools.clear();
+    updatePoolCounts();
+}
+
+void VulkanDescriptorAllocator::updatePoolCounts() {
+    stats.persistentPoolCount = (uint32_t) persistentPools.usedPools.size();
+    stats.transientPoolCount = 0;
+    for (auto &list : transientPools) {
+        stats.transientPoolCount += (uint32_t) list.usedPools.size();
+    }
+    stats.freePoolCount = (uint32_t) freePools.size();
+}
+
+void VulkanDescriptorAllocator::printStatistics() {
+    std::cout << "\nDescriptor allocator" << std::endl;
+    std::cout << "=====================" << std::endl;
+    std::cout << "\t|---[Persistent pools]--> " << stats.persistentPoolCount << "\n";
+    std::cout << "\t|---[Transient pools]--> " << stats.transientPoolCount << "\n";
+    std::cout << "\t|---[Free pools]--> " << stats.freePoolCount << "\n";
+    std::cout << "\t|---[Persistent sets]--> " << stats.persistentSetCount << "\n";
+    std::cout << "\t|---[Transient sets this frame]--> " << stats.transientSetCount << "\n";
+    std::cout << "\t|---[Pool grows]--> " << stats.poolGrowCount << "\n";
+    std::cout << "\t|---[Pool recycles]--> " << stats.poolRecycleCount << "\n";
+    std::cout << "\t|---[Transient pool resets]--> " << stats.transientResetCount << std::endl;
+}
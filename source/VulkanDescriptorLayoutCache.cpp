@@ -0,0 +1,54 @@
+#include "VulkanDescriptorLayoutCache.h"
+#include "VulkanDevice.h"
+
+VulkanDescriptorLayoutCache::VulkanDescriptorLayoutCache() {
+    deviceObj = nullptr;
+}
+
+VulkanDescriptorLayoutCache::~VulkanDescriptorLayoutCache() = default;
+
+void VulkanDescriptorLayoutCache::initialize(VulkanDevice *device) {
+    deviceObj = device;
+}
+
+VkDescriptorSetLayout VulkanDescriptorLayoutCache::getLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+                                                             VkDescriptorSetLayoutCreateFlags flags) {
+    assert(deviceObj != nullptr);
+
+    // Immutable samplers are not part of the key, layouts using them must not go through the cache
+    LayoutKey key = {};
+    key.flags = flags;
+    for (auto &binding : bindings) {
+        assert(binding.pImmutableSamplers == nullptr);
+        key.bindings.emplace_back(binding.binding, binding.descriptorType, binding.descriptorCount,
+                                  binding.stageFlags);
+    }
+    std::sort(key.bindings.begin(), key.bindings.end());
+
+    auto found = layouts.find(key);
+    if (found != layouts.end()) {
+        return found->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
+    descriptorLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorLayout.pNext = nullptr;
+    descriptorLayout.flags = flags;
+    descriptorLayout.bindingCount = (uint32_t) bindings.size();
+    descriptorLayout.pBindings = bindings.data();
+
+    VkResult result;
+    VkDescriptorSetLayout layout;
+    result = vkCreateDescriptorSetLayout(deviceObj->device, &descriptorLayout, nullptr, &layout);
+    assert(result == VK_SUCCESS);
+
+    layouts[key] = layout;
+    return layout;
+}
+
+void VulkanDescriptorLayoutCache::destroy() {
+    for (auto &layout : layouts) {
+        vkDestroyDescriptorSetLayout(deviceObj->device, layout.second, nullptr);
+    }
+    layouts.clear();
+}
@@ -2,6 +2,37 @@
 
 VulkanDevice::VulkanDevice(VkPhysicalDevice *physicalDevice) {
     gpu = physicalDevice;
+    memset(&supportedFeatures, 0, sizeof(supportedFeatures));
+    memset(&supportedFeatures11, 0, sizeof(supportedFeatures11));
+    memset(&enabledFeatures11, 0, sizeof(enabledFeatures11));
+    supportedFeatures11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    enabledFeatures11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    memset(&supportedFeatures12, 0, sizeof(supportedFeatures12));
+    memset(&enabledFeatures12, 0, sizeof(enabledFeatures12));
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    enabledFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    memset(&supportedFeatures13, 0, sizeof(supportedFeatures13));
+    memset(&enabledFeatures13, 0, sizeof(enabledFeatures13));
+    supportedFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    enabledFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    memset(&supportedSynchronization2, 0, sizeof(supportedSynchronization2));
+    memset(&enabledSynchronization2, 0, sizeof(enabledSynchronization2));
+    supportedSynchronization2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    enabledSynchronization2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    synchronization2Extension = false;
+    fpCmdPipelineBarrier2 = nullptr;
+    fpCmdWriteTimestamp2 = nullptr;
+    descriptorIndexingSupported = false;
+    dynamicRenderingSupported = false;
+    multiviewSupported = false;
+    maxMultiviewViewCount = 1;
+    storageImageExtendedFormatsSupported = false;
+    pushDescriptorSupported = false;
+    fpCmdPushDescriptorSetWithTemplateKHR = nullptr;
+    transferQueue = VK_NULL_HANDLE;
+    computeQueue = VK_NULL_HANDLE;
+    transferQueueIndex = 0;
+    computeQueueIndex = 0;
 }
 
 VulkanDevice::~VulkanDevice() = default;
@@ -11,23 +42,50 @@ VkResult VulkanDevice::createDevice(std::vector<const char *> &layers, std::vect
     layerExtension.appRequestedLayerNames = layers;
     layerExtension.appRequestedExtensionNames = extensions;
 
-    // Create Device with available queue information.
+    // Create Device with available queue information. Rendering gets the highest priority,
+    // uploads and async compute fill the gaps it leaves.
     VkResult result;
-    float queuePriorities[1] = {0.0};
-    VkDeviceQueueCreateInfo qcInfo = {};
+    float graphicsPriorities[1] = {1.0f};
+    float transferPriorities[1] = {0.5f};
+    float computePriorities[1] = {0.5f};
+    VkDeviceQueueCreateInfo qcInfos[3] = {};
+    uint32_t queueCreateInfoCount = 0;
+
+    VkDeviceQueueCreateInfo &qcInfo = qcInfos[queueCreateInfoCount++];
     qcInfo.queueFamilyIndex = graphicsQueueIndex; // update by getGraphicsQueueHandle()
     qcInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     qcInfo.pNext = nullptr;
     qcInfo.queueCount = 1;
-    qcInfo.pQueuePriorities = queuePriorities;
+    qcInfo.pQueuePriorities = graphicsPriorities;
+
+    // update by getDedicatedQueueFamilies()
+    if (hasDedicatedTransferQueue()) {
+        VkDeviceQueueCreateInfo &transferInfo = qcInfos[queueCreateInfoCount++];
+        transferInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        transferInfo.pNext = nullptr;
+        transferInfo.queueFamilyIndex = transferQueueIndex;
+        transferInfo.queueCount = 1;
+        transferInfo.pQueuePriorities = transferPriorities;
+    }
+    if (hasDedicatedComputeQueue() && computeQueueIndex != transferQueueIndex) {
+        VkDeviceQueueCreateInfo &computeInfo = qcInfos[queueCreateInfoCount++];
+        computeInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        computeInfo.pNext = nullptr;
+        computeInfo.queueFamilyIndex = computeQueueIndex;
+        computeInfo.queueCount = 1;
+        computeInfo.pQueuePriorities = computePriorities;
+    }
 
     VkPhysicalDeviceFeatures df = {};
     df.depthClamp = true;
+    df.shaderStorageImageExtendedFormats = storageImageExtendedFormatsSupported;
+    df.shaderUniformBufferArrayDynamicIndexing = descriptorIndexingSupported;
     VkDeviceCreateInfo dcInfo = {};
     dcInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    dcInfo.pNext = nullptr;
-    dcInfo.queueCreateInfoCount = 1;
-    dcInfo.pQueueCreateInfos = &qcInfo;
+    // Chain the Vulkan 1.1, 1.2 and 1.3 features selected by getPhysicalDeviceFeatures()
+    dcInfo.pNext = &enabledFeatures11;
+    dcInfo.queueCreateInfoCount = queueCreateInfoCount;
+    dcInfo.pQueueCreateInfos = qcInfos;
     dcInfo.enabledLayerCount = 0;
     dcInfo.ppEnabledLayerNames = nullptr;
     dcInfo.enabledExtensionCount = (uint32_t) extensions.size();
@@ -36,9 +94,61 @@ VkResult VulkanDevice::createDevice(std::vector<const char *> &layers, std::vect
 
     result = vkCreateDevice(*gpu, &dcInfo, nullptr, &device);
     assert(result == VK_SUCCESS);
+
+    // The graphics queue is retrieved by getDeviceQueue() once the present family is known
+    vkGetDeviceQueue(device, transferQueueIndex, 0, &transferQueue);
+    vkGetDeviceQueue(device, computeQueueIndex, 0, &computeQueue);
+
+    // Synchronization2 is core in Vulkan 1.3, the extension entry points are used on a 1.2 device
+    fpCmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2) vkGetDeviceProcAddr(
+            device, synchronization2Extension ? "vkCmdPipelineBarrier2KHR" : "vkCmdPipelineBarrier2");
+    fpCmdWriteTimestamp2 = (PFN_vkCmdWriteTimestamp2) vkGetDeviceProcAddr(
+            device, synchronization2Extension ? "vkCmdWriteTimestamp2KHR" : "vkCmdWriteTimestamp2");
+    assert(fpCmdPipelineBarrier2 != nullptr && fpCmdWriteTimestamp2 != nullptr);
+
+    // Get the entry points of the enabled optional extensions
+    if (pushDescriptorSupported) {
+        fpCmdPushDescriptorSetWithTemplateKHR = (PFN_vkCmdPushDescriptorSetWithTemplateKHR)
+                vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetWithTemplateKHR");
+        pushDescriptorSupported = fpCmdPushDescriptorSetWithTemplateKHR != nullptr;
+    }
     return result;
 }
 
+bool VulkanDevice::isDeviceExtensionSupported(const char *extensionName) {
+    uint32_t extensionCount = 0;
+    VkResult result = vkEnumerateDeviceExtensionProperties(*gpu, nullptr, &extensionCount, nullptr);
+    if (result || extensionCount == 0) {
+        return false;
+    }
+
+    std::vector<VkExtensionProperties> extensionProps(extensionCount);
+    result = vkEnumerateDeviceExtensionProperties(*gpu, nullptr, &extensionCount, extensionProps.data());
+    if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+        return false;
+    }
+
+    for (auto &extension : extensionProps) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void VulkanDevice::enableOptionalExtensions(std::vector<const char *> &extensions) {
+    // Required on a Vulkan 1.2 device, getPhysicalDeviceFeatures() checked it is there
+    if (synchronization2Extension) {
+        extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    }
+
+    // Push descriptors let per draw bindings be written into the command buffer
+    if (isDeviceExtensionSupported(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)) {
+        extensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+        pushDescriptorSupported = true;
+    }
+}
+
 bool VulkanDevice::memoryTypeFromProperties(uint32_t typeBits, VkFlags requirementsMask, uint32_t *typeIndex) {
     // Search memtypes to find first index with those properties
     for (uint32_t i = 0; i < 32; i++) {
@@ -55,6 +165,104 @@ bool VulkanDevice::memoryTypeFromProperties(uint32_t typeBits, VkFlags requireme
     return false;
 }
 
+void VulkanDevice::getPhysicalDeviceFeatures() {
+    // The queue synchronization builds on timeline semaphores, the Vulkan 1.2 feature
+    // structures they are enabled with can only be used on a 1.2 capable device
+    if (gpuProps.apiVersion < VK_API_VERSION_1_2) {
+        std::cout << "Vulkan 1.2 is required for timeline semaphores, the device supports Vulkan "
+                  << VK_VERSION_MAJOR(gpuProps.apiVersion) << "." << VK_VERSION_MINOR(gpuProps.apiVersion) << "\n";
+        exit(-1);
+    }
+
+    // The 1.3 features are only valid in the chain of a 1.3 device, a 1.2 device may
+    // expose synchronization2 through its extension instead
+    bool vulkan13 = gpuProps.apiVersion >= VK_API_VERSION_1_3;
+    synchronization2Extension = !vulkan13 && isDeviceExtensionSupported(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &supportedFeatures11;
+    supportedFeatures11.pNext = &supportedFeatures12;
+    if (vulkan13) {
+        supportedFeatures12.pNext = &supportedFeatures13;
+    } else if (synchronization2Extension) {
+        supportedFeatures12.pNext = &supportedSynchronization2;
+    } else {
+        supportedFeatures12.pNext = nullptr;
+    }
+    vkGetPhysicalDeviceFeatures2(*gpu, &features2);
+    supportedFeatures = features2.features;
+
+    // Two channel storage images, written by the Hi-Z pyramid build
+    storageImageExtendedFormatsSupported = supportedFeatures.shaderStorageImageExtendedFormats;
+
+    // The render graph issues its barriers with synchronization2, core in Vulkan 1.3
+    bool synchronization2 = vulkan13 ? supportedFeatures13.synchronization2 : supportedSynchronization2.synchronization2;
+    if (!synchronization2) {
+        std::cout << "Synchronization2 is required, the device has neither Vulkan 1.3 nor "
+                  << VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME << "\n";
+        exit(-1);
+    }
+
+    if (vulkan13) {
+        enabledFeatures13.synchronization2 = VK_TRUE;
+
+        // Rendering without render pass and framebuffer objects, optional
+        dynamicRenderingSupported = supportedFeatures13.dynamicRendering;
+        enabledFeatures13.dynamicRendering = supportedFeatures13.dynamicRendering;
+        enabledFeatures12.pNext = &enabledFeatures13;
+    } else {
+        enabledSynchronization2.synchronization2 = VK_TRUE;
+        enabledFeatures12.pNext = &enabledSynchronization2;
+    }
+    enabledFeatures11.pNext = &enabledFeatures12;
+
+    // Several views rendered by one render pass instance, optional. The view count is limited.
+    multiviewSupported = supportedFeatures11.multiview;
+    enabledFeatures11.multiview = supportedFeatures11.multiview;
+    if (multiviewSupported) {
+        VkPhysicalDeviceMultiviewProperties multiviewProps = {};
+        multiviewProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES;
+        multiviewProps.pNext = nullptr;
+        VkPhysicalDeviceProperties2 props2 = {};
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props2.pNext = &multiviewProps;
+        vkGetPhysicalDeviceProperties2(*gpu, &props2);
+        maxMultiviewViewCount = multiviewProps.maxMultiviewViewCount;
+    }
+
+    // Timeline semaphores are required by Vulkan 1.2, all the queue synchronization builds on them
+    if (!supportedFeatures12.timelineSemaphore) {
+        std::cout << "Timeline semaphores are required, the device does not support them\n";
+        exit(-1);
+    }
+    enabledFeatures12.timelineSemaphore = VK_TRUE;
+
+    // Descriptor indexing, required by the bindless resource table. The update after bind
+    // of uniform buffers is optional, the table falls back to regular uniform bindings.
+    // DrawBindless.vert indexes the uniform buffer array with a push constant, a dynamically
+    // uniform index which is a core feature.
+    descriptorIndexingSupported = supportedFeatures.shaderUniformBufferArrayDynamicIndexing &&
+                                  supportedFeatures12.descriptorIndexing &&
+                                  supportedFeatures12.runtimeDescriptorArray &&
+                                  supportedFeatures12.descriptorBindingPartiallyBound &&
+                                  supportedFeatures12.descriptorBindingStorageBufferUpdateAfterBind &&
+                                  supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind &&
+                                  supportedFeatures12.shaderSampledImageArrayNonUniformIndexing;
+    if (descriptorIndexingSupported) {
+        enabledFeatures12.descriptorIndexing = VK_TRUE;
+        enabledFeatures12.runtimeDescriptorArray = VK_TRUE;
+        enabledFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+        enabledFeatures12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        enabledFeatures12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabledFeatures12.descriptorBindingUniformBufferUpdateAfterBind =
+                supportedFeatures12.descriptorBindingUniformBufferUpdateAfterBind;
+        enabledFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        enabledFeatures12.shaderStorageBufferArrayNonUniformIndexing =
+                supportedFeatures12.shaderStorageBufferArrayNonUniformIndexing;
+    }
+}
+
 void VulkanDevice::getPhysicalDeviceQueueAndProperties() {
     // Queue families count with pass NULL as second parameter
     vkGetPhysicalDeviceQueueFamilyProperties2(*gpu, &queueFamilyCount, nullptr);
@@ -92,10 +300,76 @@ uint32_t VulkanDevice::getGraphicsQueueHandle() {
     return graphicsQueueIndex;
 }
 
+void VulkanDevice::getDedicatedQueueFamilies() {
+    // Prefer a transfer only family (DMA engine), then any non graphics family with transfer.
+    // Compute and graphics families support transfers implicitly.
+    transferQueueIndex = graphicsQueueIndex;
+    computeQueueIndex = graphicsQueueIndex;
+    int transferScore = 0;
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        VkQueueFlags flags = queueFamilyProps[i].queueFlags;
+        if (flags & VK_QUEUE_GRAPHICS_BIT) {
+            continue;
+        }
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && computeQueueIndex == graphicsQueueIndex) {
+            computeQueueIndex = i;
+        }
+
+        int score = 0;
+        if (flags & VK_QUEUE_COMPUTE_BIT) {
+            score = 1;
+        } else if (flags & VK_QUEUE_TRANSFER_BIT) {
+            score = 2;
+        }
+        if (score > transferScore) {
+            transferQueueIndex = i;
+            transferScore = score;
+        }
+    }
+
+    std::cout << "\t|---[Graphics queue family]--> " << graphicsQueueIndex << "\n";
+    std::cout << "\t|---[Transfer queue family]--> " << transferQueueIndex
+              << (hasDedicatedTransferQueue() ? " (dedicated)" : " (shared with graphics)") << "\n";
+    std::cout << "\t|---[Compute queue family]--> " << computeQueueIndex
+              << (hasDedicatedComputeQueue() ? " (dedicated)" : " (shared with graphics)") << "\n";
+}
+
 void VulkanDevice::getDeviceQueue() {
     vkGetDeviceQueue(device, graphicsQueueWithPresentIndex, 0, &queue);
+
+    // The timelines survive a resize, only the queue handle is refreshed
+    timelines[QUEUE_GRAPHICS].initialize(this, queue);
+    if (hasDedicatedTransferQueue()) {
+        timelines[QUEUE_TRANSFER].initialize(this, transferQueue);
+    }
+    if (hasDedicatedComputeQueue() && computeQueueIndex != transferQueueIndex) {
+        timelines[QUEUE_COMPUTE].initialize(this, computeQueue);
+    }
+}
+
+VulkanTimeline *VulkanDevice::getTimeline(QueueType type) {
+    // Two timelines must not submit to the same queue, the submissions would not be serialized
+    if ((type == QUEUE_TRANSFER && !hasDedicatedTransferQueue()) ||
+        (type == QUEUE_COMPUTE && !hasDedicatedComputeQueue())) {
+        type = QUEUE_GRAPHICS;
+    }
+    if (type == QUEUE_COMPUTE && computeQueueIndex == transferQueueIndex) {
+        type = QUEUE_TRANSFER;
+    }
+    return &timelines[type];
+}
+
+void VulkanDevice::waitTimelinesIdle() {
+    for (auto &timeline : timelines) {
+        if (timeline.semaphore != VK_NULL_HANDLE) {
+            timeline.waitIdle();
+        }
+    }
 }
 
 void VulkanDevice::destroyDevice() {
+    for (auto &timeline : timelines) {
+        timeline.destroy();
+    }
     vkDestroyDevice(device, nullptr);
 }
\ No newline at end of file
@@ -9,36 +9,24 @@ VulkanDrawable::VulkanDrawable(VulkanRenderer *parent) {
     // Note: It's very important to initialize the member with 0 or respective value otherwise it will break the system
     memset(&UniformData, 0, sizeof(UniformData));
     memset(&VertexBuffer, 0, sizeof(VertexBuffer));
+    memset(&DescriptorData, 0, sizeof(DescriptorData));
 
     rendererObj = parent;
-
-    VkSemaphoreCreateInfo presentCompleteSemaphoreCreateInfo = {};
-    presentCompleteSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    presentCompleteSemaphoreCreateInfo.pNext = nullptr;
-    presentCompleteSemaphoreCreateInfo.flags = 0;
-
-    VkSemaphoreCreateInfo drawingCompleteSemaphoreCreateInfo = {};
-    drawingCompleteSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    drawingCompleteSemaphoreCreateInfo.pNext = nullptr;
-    drawingCompleteSemaphoreCreateInfo.flags = 0;
-
-    VulkanDevice *deviceObj = VulkanApplication::GetInstance()->deviceObj;
-    vkCreateSemaphore(deviceObj->device, &presentCompleteSemaphoreCreateInfo, nullptr, &presentCompleteSemaphore);
-    vkCreateSemaphore(deviceObj->device, &drawingCompleteSemaphoreCreateInfo, nullptr, &drawingCompleteSemaphore);
-
+    memset(bindlessIndices, 0, sizeof(bindlessIndices));
+    objectIndex = 0;
+    boundsMin = boundsMax = glm::vec3(0.0f);
+    vertexCount = 0;
+    pipeline = nullptr;
+    depthPipeline = nullptr;
+
+    // Bake the color mode pushed by initPushConstant() into the fragment shader
+    shaderVariant.colorMode = COLOR_MODE_MIXED;
 }
 
 VulkanDrawable::~VulkanDrawable() = default;
 
-void VulkanDrawable::destroyCommandBuffer() {
-    for (auto &i : vecCmdDraw) {
-        vkFreeCommandBuffers(deviceObj->device, rendererObj->cmdPool, 1, &i);
-    }
-}
-
-void VulkanDrawable::destroySynchronizationObjects() {
-    vkDestroySemaphore(deviceObj->device, presentCompleteSemaphore, nullptr);
-    vkDestroySemaphore(deviceObj->device, drawingCompleteSemaphore, nullptr);
+void VulkanDrawable::destroyCommandCache() {
+    cmdCache.destroy();
 }
 
 void VulkanDrawable::createUniformBuffer() {
@@ -48,13 +36,22 @@ void VulkanDrawable::createUniformBuffer() {
     View = glm::lookAt(glm::vec3(10, 3, 10), glm::vec3(0, 0, 0), glm::vec3(0, -1, 0));
     Model = glm::mat4(1.0f);
     MVP = Projection * View * Model;
+    for (uint32_t view = 0; view < MAX_VIEW_COUNT; view++) {
+        viewMVPs[view] = MVP;
+    }
+
+    // Each frame slot has its own region. Its offset must suit a descriptor, and the flushed
+    // ranges of non-coherent memory must be whole atoms (both limits are powers of two).
+    const VkPhysicalDeviceLimits &limits = deviceObj->gpuProps.limits;
+    VkDeviceSize alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.nonCoherentAtomSize);
+    UniformData.slotSize = (getUniformSize() + alignment - 1) & ~(alignment - 1);
 
     // Create buffer resource states using VkBufferCreateInfo
     VkBufferCreateInfo bufInfo = {};
     bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufInfo.pNext = nullptr;
     bufInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    bufInfo.size = sizeof(MVP);
+    bufInfo.size = UniformData.slotSize * FRAMES_IN_FLIGHT;
     bufInfo.queueFamilyIndexCount = 0;
     bufInfo.pQueueFamilyIndices = nullptr;
     bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -85,32 +82,36 @@ void VulkanDrawable::createUniformBuffer() {
     result = vkMapMemory(deviceObj->device, UniformData.memory, 0, memRqrmnt.size, 0, (void **) &UniformData.pData);
     assert(result == VK_SUCCESS);
 
-    // Copy computed data in the mapped buffer
-    memcpy(UniformData.pData, &MVP, sizeof(MVP));
+    // One Uniform buffer region to update per frame slot
+    UniformData.mappedRange.resize(FRAMES_IN_FLIGHT);
 
-    // We have only one Uniform buffer object to update
-    UniformData.mappedRange.resize(1);
+    for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+        // Copy computed data in the mapped buffer
+        memcpy(UniformData.pData + slot * UniformData.slotSize, getUniformData(), getUniformSize());
 
-    // Populate the VkMappedMemoryRange data structure
-    UniformData.mappedRange[0].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    UniformData.mappedRange[0].memory = UniformData.memory;
-    UniformData.mappedRange[0].offset = 0;
-    UniformData.mappedRange[0].size = sizeof(MVP);
+        // Populate the VkMappedMemoryRange data structure
+        UniformData.mappedRange[slot].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        UniformData.mappedRange[slot].pNext = nullptr;
+        UniformData.mappedRange[slot].memory = UniformData.memory;
+        UniformData.mappedRange[slot].offset = slot * UniformData.slotSize;
+        UniformData.mappedRange[slot].size = UniformData.slotSize;
 
-    // Invalidate the range of mapped buffer in order to make it visible to the host.
+        // Update the local data structure with uniform buffer for housekeeping
+        UniformData.bufferInfo[slot].buffer = UniformData.buffer;
+        UniformData.bufferInfo[slot].offset = slot * UniformData.slotSize;
+        UniformData.bufferInfo[slot].range = getUniformSize();
+    }
+
+    // Flush the initial data in order to make it visible to the device.
     // If the memory property is set with VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
     // then the driver may take care of this, otherwise for non-coherent
-    // mapped memory vkInvalidateMappedMemoryRanges() needs to be called explicitly.
-    vkInvalidateMappedMemoryRanges(deviceObj->device, 1, &UniformData.mappedRange[0]);
+    // mapped memory vkFlushMappedMemoryRanges() needs to be called explicitly.
+    vkFlushMappedMemoryRanges(deviceObj->device, FRAMES_IN_FLIGHT, UniformData.mappedRange.data());
 
     // Bind the buffer device memory
     result = vkBindBufferMemory(deviceObj->device, UniformData.buffer, UniformData.memory, 0);
     assert(result == VK_SUCCESS);
 
-    // Update the local data structure with uniform buffer for housekeeping
-    UniformData.bufferInfo.buffer = UniformData.buffer;
-    UniformData.bufferInfo.offset = 0;
-    UniformData.bufferInfo.range = sizeof(MVP);
     UniformData.memoryRequirements = memRqrmnt;
 }
 
@@ -127,7 +128,7 @@ void VulkanDrawable::createVertexBuffer(const void *vertexData, uint32_t dataSiz
             .pNext = nullptr,
             .flags =0,
             .size = dataSize,
-            .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
             .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
             .queueFamilyIndexCount = 0,
             .pQueueFamilyIndices = nullptr,
@@ -142,8 +143,7 @@ void VulkanDrawable::createVertexBuffer(const void *vertexData, uint32_t dataSiz
     allocInfo.pNext = nullptr;
     allocInfo.memoryTypeIndex = 0;
     allocInfo.allocationSize = memRqrmnt.size;
-    pass = deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    pass = deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                                                &allocInfo.memoryTypeIndex);
     assert(pass);
 
@@ -152,133 +152,129 @@ void VulkanDrawable::createVertexBuffer(const void *vertexData, uint32_t dataSiz
     VertexBuffer.bufferInfo.range = memRqrmnt.size;
     VertexBuffer.bufferInfo.offset = 0;
 
-    // Map the physical device memory region to the host
-    uint8_t *pData;
-    result = vkMapMemory(deviceObj->device, VertexBuffer.mem, 0, memRqrmnt.size, 0, (void **) &pData);
-    assert(result == VK_SUCCESS);
-
-    // Copy the data in the mapped memory
-    memcpy(pData, vertexData, dataSize);
-
-    // Unmap the device memory
-    vkUnmapMemory(deviceObj->device, VertexBuffer.mem);
-
     // Bind the allocated buffer resource to the device memory
     result = vkBindBufferMemory(deviceObj->device, VertexBuffer.buf, VertexBuffer.mem, 0);
     assert(result == VK_SUCCESS);
 
+    // The device local memory is filled by a copy on the transfer queue
+    rendererObj->getUploadManager()->uploadBuffer(VertexBuffer.buf, vertexData, dataSize,
+                                                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                                  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+    // Each vertex starts with its position, the Hi-Z culling tests the box around them
+    vertexCount = dataSize / dataStride;
+    boundsMin = glm::vec3(FLT_MAX);
+    boundsMax = glm::vec3(-FLT_MAX);
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        const float *position = (const float *) ((const uint8_t *) vertexData + i * dataStride);
+        glm::vec3 point(position[0], position[1], position[2]);
+        boundsMin = glm::min(boundsMin, point);
+        boundsMax = glm::max(boundsMax, point);
+    }
+
+    // The attributes are reflected from the vertex shader, see createVertexInputAttributes()
     viIpBind.binding = 0;
     viIpBind.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
     viIpBind.stride = dataStride;
-
-    viIpAttr[0].binding = 0;
-    viIpAttr[0].location = 0;
-    viIpAttr[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    viIpAttr[0].offset = 0;
-    viIpAttr[1].binding = 0;
-    viIpAttr[1].location = 1;
-    viIpAttr[1].format = useTexture ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
-    viIpAttr[1].offset = 16;
-
 }
 
-
-// Creates the descriptor pool, this function depends on -
-// createDescriptorSetLayout()
-void VulkanDrawable::createDescriptorPool(bool useTexture) {
-    VkResult result;
-    // Define the size of descriptor pool based on the
-    // type of descriptor set being used.
-    std::vector<VkDescriptorPoolSize> descriptorTypePool;
-
-    // The first descriptor pool object is of type Uniform buffer
-    descriptorTypePool.push_back(VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1});
-
-    // If texture is supported then define second object with
-    // descriptor type to be Image sampler
-    if (useTexture) {
-        descriptorTypePool.push_back(VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1});
+void VulkanDrawable::createVertexInputAttributes() {
+    // The vertex shader inputs are packed in location order in the interleaved vertex buffer,
+    // position then color (or texture coordinates when the shader declares a vec2).
+    const VulkanShaderReflection &reflection = rendererObj->getShader()->reflection;
+    uint32_t vertexSize = reflection.getVertexInputAttributes(viIpBind.binding, viIpAttr);
+    if (vertexSize > viIpBind.stride) {
+        assert(0);
+        printf("Vertex shader inputs need %d bytes, the vertex buffer stride is %d", vertexSize, viIpBind.stride);
     }
-
-    // Populate the descriptor pool state information
-    // in the createInfo structure.
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
-    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptorPoolCreateInfo.pNext = nullptr;
-    descriptorPoolCreateInfo.maxSets = 1;
-    descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    descriptorPoolCreateInfo.poolSizeCount = (uint32_t) descriptorTypePool.size();
-    descriptorPoolCreateInfo.pPoolSizes = descriptorTypePool.data();
-
-    // Create the descriptor pool using the descriptor
-    // pool create info structure
-    result = vkCreateDescriptorPool(deviceObj->device, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
-    assert(result == VK_SUCCESS);
 }
 
+
 // Create the Uniform resource inside. Create Descriptor set associated resources
 // before creating the descriptor set
 void VulkanDrawable::createDescriptorResources() {
     createUniformBuffer();
 }
 
-// Creates the descriptor sets using descriptor pool.
-// This function depend on the createDescriptorPool() and createUniformBuffer().
-void VulkanDrawable::createDescriptorSet(bool useTexture) {
-    VkResult result;
-
-    // Create the descriptor allocation structure and specify the descriptor
-    // pool and descriptor layout
-    VkDescriptorSetAllocateInfo dsAllocInfo[1];
-    dsAllocInfo[0].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    dsAllocInfo[0].pNext = nullptr;
-    dsAllocInfo[0].descriptorPool = descriptorPool;
-    dsAllocInfo[0].descriptorSetCount = 1;
-    dsAllocInfo[0].pSetLayouts = descLayout.data();
+void VulkanDrawable::createBindlessDescriptor() {
+    createDescriptorResources();
 
-    // Allocate the number of descriptor sets needs to be produced
-    descriptorSet.resize(1);
+    // Each region of the uniform buffer becomes one element of the table's uniform array
+    for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+        bindlessIndices[slot] = rendererObj->getBindlessTable()->registerUniformBuffer(UniformData.bufferInfo[slot]);
+    }
+}
 
-    // Allocate descriptor sets
-    result = vkAllocateDescriptorSets(deviceObj->device, dsAllocInfo, descriptorSet.data());
-    assert(result == VK_SUCCESS);
+// Creates the descriptor sets using the renderer's descriptor allocator.
+// This function depend on the createDescriptorSetLayout() and createUniformBuffer().
+void VulkanDrawable::createDescriptorSet(bool useTexture) {
+    VkResult result;
 
-    // Allocate two write descriptors for - 1. MVP and 2. Texture
-    VkWriteDescriptorSet writes[2];
-    memset(&writes, 0, sizeof(writes));
-
-    // Specify the uniform buffer related
-    // information into first write descriptor
-    writes[0] = {};
-    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writes[0].pNext = nullptr;
-    writes[0].dstSet = descriptorSet[0];
-    writes[0].descriptorCount = 1;
-    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    writes[0].pBufferInfo = &UniformData.bufferInfo;
-    writes[0].dstArrayElement = 0;
-    writes[0].dstBinding = 0; // DESCRIPTOR_SET_BINDING_INDEX
-
-    // If texture is used then update the second write descriptor structure
-    if (useTexture) {
-        // In this sample textures are not used
-        writes[1] = {};
-        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writes[1].dstSet = descriptorSet[0];
-        writes[1].dstBinding = 1; // DESCRIPTOR_SET_BINDING_INDEX
-        writes[1].descriptorCount = 1;
-        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writes[1].pImageInfo = nullptr;
-        writes[1].dstArrayElement = 0;
+    // Push descriptors have no set, they are written into the command buffer at draw time
+    // from the packed data of the frame slot, see recordDrawCommands()
+    if (descriptorUpdateMode == DESCRIPTOR_UPDATE_PUSH_DESCRIPTOR) {
+        DescriptorData.uniformBuffer = UniformData.bufferInfo[0];
+        descriptorSet.clear();
+        return;
     }
 
-    // Update the uniform buffer into the allocated descriptor set
-    vkUpdateDescriptorSets(deviceObj->device, useTexture ? 2 : 1, writes, 0, nullptr);
+    // Allocate the number of descriptor sets needs to be produced, one per frame slot
+    descriptorSet.resize(FRAMES_IN_FLIGHT);
+
+    for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+        // Allocate descriptor sets, the set lives as long as the drawable's
+        // resources and is released when the allocator pools are reset.
+        result = rendererObj->getDescriptorAllocator()->allocatePersistent(descLayout[0], &descriptorSet[slot]);
+        assert(result == VK_SUCCESS);
+
+        // The template was compiled once with the set layout, apply it to the packed data
+        if (descriptorUpdateMode == DESCRIPTOR_UPDATE_TEMPLATE) {
+            // Pack the resources in the layout expected by the update template
+            DescriptorData.uniformBuffer = UniformData.bufferInfo[slot];
+            vkUpdateDescriptorSetWithTemplate(deviceObj->device, descriptorSet[slot], descriptorUpdateTemplate,
+                                              &DescriptorData);
+            continue;
+        }
+
+        // Allocate two write descriptors for - 1. MVP and 2. Texture
+        VkWriteDescriptorSet writes[2];
+        memset(&writes, 0, sizeof(writes));
+
+        // Specify the uniform buffer related
+        // information into first write descriptor
+        writes[0] = {};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].pNext = nullptr;
+        writes[0].dstSet = descriptorSet[slot];
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[0].pBufferInfo = &UniformData.bufferInfo[slot];
+        writes[0].dstArrayElement = 0;
+        writes[0].dstBinding = 0; // DESCRIPTOR_SET_BINDING_INDEX
+
+        // If texture is used then update the second write descriptor structure
+        if (useTexture) {
+            // In this sample textures are not used
+            writes[1] = {};
+            writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[1].dstSet = descriptorSet[slot];
+            writes[1].dstBinding = 1; // DESCRIPTOR_SET_BINDING_INDEX
+            writes[1].descriptorCount = 1;
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[1].pImageInfo = nullptr;
+            writes[1].dstArrayElement = 0;
+        }
+
+        // Update the uniform buffer into the allocated descriptor set
+        vkUpdateDescriptorSets(deviceObj->device, useTexture ? 2 : 1, writes, 0, nullptr);
+    }
 }
 
 void VulkanDrawable::initViewports(VkCommandBuffer *cmd) {
-    viewport.height = (float) rendererObj->height;
-    viewport.width = (float) rendererObj->width;
+    // With dynamic resolution the scene covers the top left part of its target
+    VkExtent2D extent = rendererObj->getRenderExtent();
+    viewport.height = (float) extent.height;
+    viewport.width = (float) extent.width;
     viewport.minDepth = (float) 0.0f;
     viewport.maxDepth = (float) 1.0f;
     viewport.x = 0;
@@ -287,8 +283,7 @@ void VulkanDrawable::initViewports(VkCommandBuffer *cmd) {
 }
 
 void VulkanDrawable::initScissors(VkCommandBuffer *cmd) {
-    scissor.extent.height = rendererObj->height;
-    scissor.extent.width = rendererObj->width;
+    scissor.extent = rendererObj->getRenderExtent();
     scissor.offset.x = 0;
     scissor.offset.y = 0;
     vkCmdSetScissor(*cmd, 0, NUMBER_OF_SCISSORS, &scissor);
@@ -320,6 +315,19 @@ void VulkanDrawable::initPushConstant(VkCommandBuffer *cmd){
 
     vkCmdPushConstants(*cmd, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
                        sizeof(pushConstants), pushConstants);
+
+    // Index of the frame slot's uniform buffer region inside the bindless table, see DrawBindless.vert
+    if (rendererObj->isBindless()) {
+        uint32_t bindlessIndex = bindlessIndices[rendererObj->getFrameSlot()];
+        vkCmdPushConstants(*cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, PUSH_CONSTANT_VERTEX_OFFSET,
+                           sizeof(bindlessIndex), &bindlessIndex);
+    }
+
+    // This frame's transformation, see DrawPushConstant.vert
+    if (rendererObj->getTransformMode() == TRANSFORM_PUSH_CONSTANT) {
+        vkCmdPushConstants(*cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, PUSH_CONSTANT_VERTEX_OFFSET,
+                           sizeof(MVP), &MVP);
+    }
 }
 
 void VulkanDrawable::destroyVertexBuffer() {
@@ -328,43 +336,71 @@ void VulkanDrawable::destroyVertexBuffer() {
 }
 
 void VulkanDrawable::destroyUniformBuffer() {
+    // Not created when the transforms travel in push constants
+    if (UniformData.buffer == VK_NULL_HANDLE) {
+        return;
+    }
     vkUnmapMemory(deviceObj->device, UniformData.memory);
     vkDestroyBuffer(rendererObj->getDevice()->device, UniformData.buffer, nullptr);
     vkFreeMemory(rendererObj->getDevice()->device, UniformData.memory, nullptr);
+    UniformData.buffer = VK_NULL_HANDLE;
 }
 
-void VulkanDrawable::recordCommandBuffer(int currentBuffer, VkCommandBuffer *cmdDraw) {
-    VulkanDevice *deviceObj = rendererObj->getDevice();
-    VkClearValue clearValues[2];
-    clearValues[0].color = {0.0f, 0.0f, 0.0f, 0.0f};
+VkCommandBuffer VulkanDrawable::getDrawCommands(int currentBuffer) {
+    // Dynamic rendering has neither render pass nor framebuffer, the attachment formats are inherited
+    const VkCommandBufferInheritanceRenderingInfo *renderingInfo = rendererObj->getSceneInheritanceRenderingInfo();
+    VkRenderPass renderPass = rendererObj->renderPass;
+    VkFramebuffer framebuffer = renderingInfo ? VK_NULL_HANDLE : rendererObj->frameBuffers[currentBuffer];
+
+    // Push constant transforms change every frame, their draw is recorded in a buffer of the frame
+    if (rendererObj->getTransformMode() == TRANSFORM_PUSH_CONSTANT) {
+        VkCommandBuffer cmdSecondary = rendererObj->getFrameCommandPools()->getCommandBuffer(
+                0, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        CommandBufferMgr::beginSecondaryCommandBuffer(cmdSecondary, renderPass, framebuffer,
+                                                      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, renderingInfo);
+        recordDrawCommands(&cmdSecondary, *pipeline);
+        CommandBufferMgr::endCommandBuffer(cmdSecondary);
+        return cmdSecondary;
+    }
 
-    // Specify the depth/stencil clear value
-    clearValues[1].depthStencil.depth = 1.0f;
-    clearValues[1].depthStencil.stencil = 0;
+    // Otherwise the draw only depends on these inputs, a static scene replays the secondary
+    // buffer recorded for the image and costs no recording time. The buffer reads the uniform
+    // buffer region of the frame slot, each (image, frame slot) pair has its own.
+    CommandCacheInputs inputs = {};
+    inputs.renderPass = renderPass;
+    inputs.framebuffer = framebuffer;
+    inputs.pipeline = *pipeline;
+    inputs.extent = rendererObj->getRenderExtent();
+
+    size_t cacheSlot = (size_t) currentBuffer * FRAMES_IN_FLIGHT + rendererObj->getFrameSlot();
+    VkCommandBuffer cmdSecondary = cmdCache.find(cacheSlot, inputs);
+    if (cmdSecondary == VK_NULL_HANDLE) {
+        cmdSecondary = cmdCache.beginRecording(cacheSlot, inputs);
+        recordDrawCommands(&cmdSecondary, *pipeline);
+        cmdCache.endRecording(cacheSlot);
+    }
+    return cmdSecondary;
+}
 
-    vkCmdBeginRenderPass(*cmdDraw, new VkRenderPassBeginInfo{
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .pNext = nullptr,
-            .renderPass = rendererObj->renderPass,
-            .framebuffer = rendererObj->frameBuffers[currentBuffer],
-            .renderArea = VkRect2D{.offset = VkOffset2D{
-                    .x = 0,
-                    .y =0,
-            },
-                    .extent = VkExtent2D{
-                            .width = static_cast<uint32_t>(rendererObj->width),
-                            .height = static_cast<uint32_t>(rendererObj->height)
-                    },
-            },
-            .clearValueCount = 2,
-            .pClearValues = clearValues,
-
-    }, VK_SUBPASS_CONTENTS_INLINE);
+void VulkanDrawable::recordDepthCommands(VkCommandBuffer *cmdDraw) {
+    assert(depthPipeline != nullptr);
+    recordDrawCommands(cmdDraw, *depthPipeline);
+}
+
+void VulkanDrawable::recordSceneCommands(VkCommandBuffer *cmdDraw) {
+    assert(rendererObj->isBindless());
+    recordDrawCommands(cmdDraw, *pipeline);
+}
 
+void VulkanDrawable::recordDrawCommands(VkCommandBuffer *cmdDraw, VkPipeline drawPipeline) {
     // Bound the pi with the graphics pipeline
-    vkCmdBindPipeline(*cmdDraw, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline);
-    vkCmdBindDescriptorSets(*cmdDraw, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
-                            0, 1, descriptorSet.data(), 0, nullptr);
+    vkCmdBindPipeline(*cmdDraw, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+    // The bindless table was bound by the pass for all the draws, they only push their index
+    if (!rendererObj->isBindless() && rendererObj->getTransformMode() == TRANSFORM_UNIFORM_BUFFER) {
+        uint32_t frameSlot = rendererObj->getFrameSlot();
+        DescriptorData.uniformBuffer = UniformData.bufferInfo[frameSlot];
+        bindDescriptors(*cmdDraw, &DescriptorData, frameSlot);
+    }
     // Bind the vertex buffer
     const VkDeviceSize offsets[1] = {0};
     vkCmdBindVertexBuffers(*cmdDraw, 0, 1, &VertexBuffer.buf, offsets);
@@ -373,31 +409,30 @@ void VulkanDrawable::recordCommandBuffer(int currentBuffer, VkCommandBuffer *cmd
     initScissors(cmdDraw);
     initPushConstant(cmdDraw);
 
-    vkCmdDraw(*cmdDraw, 3 * 2 * 6, 1, 0, 0);
-    // End of render pass instance recording
-    vkCmdEndRenderPass(*cmdDraw);
+    // With Hi-Z culling the instance count comes from the culling pass, zero when occluded
+    if (rendererObj->isHiZCulling()) {
+        vkCmdDrawIndirect(*cmdDraw, rendererObj->getHiZCulling()->getIndirectBuffer(),
+                          objectIndex * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+        return;
+    }
+    vkCmdDraw(*cmdDraw, vertexCount, 1, 0, 0);
 }
 
 void VulkanDrawable::prepare() {
     VulkanDevice *deviceObj = rendererObj->getDevice();
-    vecCmdDraw.resize(rendererObj->getSwapChain()->scPublicVars.colorBuffer.size());
-    // For each swapBuffer color surface image buffer
-    // allocate the corresponding command buffer
-    for (int i = 0; i < rendererObj->getSwapChain()->scPublicVars.colorBuffer.size(); i++) {
-        // Allocate, create and start command buffer recording
-        CommandBufferMgr::allocCommandBuffer(&deviceObj->device, *rendererObj->getCommandPool(), &vecCmdDraw[i]);
-        CommandBufferMgr::beginCommandBuffer(vecCmdDraw[i]);
-
-        // Create the render pass instance
-        recordCommandBuffer(i, &vecCmdDraw[i]);
-
-        // Finish the command buffer recording
-        CommandBufferMgr::endCommandBuffer(vecCmdDraw[i]);
-    }
+    size_t imageCount = rendererObj->getSwapChain()->scPublicVars.colorBuffer.size();
+
+    // The framebuffers and the extent may have changed, start from an empty cache
+    cmdCache.destroy();
+    cmdCache.initialize(deviceObj, rendererObj->getDeletionQueue(), deviceObj->graphicsQueueWithPresentIndex,
+                        imageCount * FRAMES_IN_FLIGHT, rendererObj->getSceneInheritanceRenderingInfo());
+}
+
+void VulkanDrawable::invalidateCommandBuffers() {
+    cmdCache.invalidate();
 }
 
 void VulkanDrawable::update() {
-    VulkanDevice *deviceObj = rendererObj->getDevice();
     Projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
     View = glm::lookAt(
             glm::vec3(0, 0, 5),        // Camera is in World Space
@@ -411,65 +446,43 @@ void VulkanDrawable::update() {
             * glm::rotate(Model, rot, glm::vec3(1.0, 1.0, 1.0));
 
     MVP = Projection * View * Model;
+    for (uint32_t view = 0; view < rendererObj->getViewCount(); view++) {
+        viewMVPs[view] = Projection * rendererObj->getViewTransform(view) * View * Model;
+    }
+}
+
+void VulkanDrawable::writeUniformBuffer(uint32_t frameSlot) {
+    // Pushed with the draw, there is no uniform buffer to update
+    if (rendererObj->getTransformMode() == TRANSFORM_PUSH_CONSTANT) {
+        return;
+    }
 
     // Invalidate the range of mapped buffer in order to make it visible to the host.
     // If the memory property is set with VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
     // then the driver may take care of this, otherwise for non-coherent
     // mapped memory vkInvalidateMappedMemoryRanges() needs to be called explicitly.
-    VkResult res = vkInvalidateMappedMemoryRanges(deviceObj->device, 1, &UniformData.mappedRange[0]);
+    VkResult res = vkInvalidateMappedMemoryRanges(deviceObj->device, 1, &UniformData.mappedRange[frameSlot]);
     assert(res == VK_SUCCESS);
 
-    // Copy updated data into the mapped memory
-    memcpy(UniformData.pData, &MVP, sizeof(MVP));
+    // Copy updated data into the slot's region of the mapped memory
+    memcpy(UniformData.pData + UniformData.mappedRange[frameSlot].offset, getUniformData(), getUniformSize());
 
     // Flush the range of mapped buffer in order to make it visible to the device
     // If the memory is coherent (memory property must be beVK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
     // then the driver may take care of this, otherwise for non-coherent
     // mapped memory vkFlushMappedMemoryRanges() needs to be called explicitly to flush out
     // the pending writes on the host side.
-    res = vkFlushMappedMemoryRanges(deviceObj->device, 1, &UniformData.mappedRange[0]);
+    res = vkFlushMappedMemoryRanges(deviceObj->device, 1, &UniformData.mappedRange[frameSlot]);
     assert(res == VK_SUCCESS);
-
 }
 
-void VulkanDrawable::render() {
-    VulkanDevice *deviceObj = rendererObj->getDevice();
-    VulkanSwapChain *swapChainObj = rendererObj->getSwapChain();
-
-    uint32_t &currentColorImage = swapChainObj->scPublicVars.currentColorBuffer;
-    VkSwapchainKHR &swapChain = swapChainObj->scPublicVars.swapChain;
-
-    VkFence nullFence = VK_NULL_HANDLE;
-
-    VkResult result = swapChainObj->fpAcquireNextImageKHR(deviceObj->device, swapChain, UINT64_MAX,
-                                                          presentCompleteSemaphore, VK_NULL_HANDLE, &currentColorImage);
-
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = nullptr;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &presentCompleteSemaphore;
-    VkPipelineStageFlags submitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    submitInfo.pWaitDstStageMask = &submitPipelineStages;
-    submitInfo.commandBufferCount = (uint32_t) sizeof(&vecCmdDraw[currentColorImage]) / sizeof(VkCommandBuffer);
-    submitInfo.pCommandBuffers = &vecCmdDraw[currentColorImage];
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &drawingCompleteSemaphore;
-
+const void *VulkanDrawable::getUniformData() {
+    return rendererObj->getViewCount() > 1 ? (const void *) viewMVPs : (const void *) &MVP;
+}
 
-    // Queue the command buffer for execution
-    CommandBufferMgr::submitCommandBuffer(deviceObj->queue, &vecCmdDraw[currentColorImage], &submitInfo);
-    swapChainObj->fpQueuePresentKHR(deviceObj->queue, new VkPresentInfoKHR{
-            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-            .pNext = nullptr,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &drawingCompleteSemaphore,
-            .swapchainCount = 1,
-            .pSwapchains = &swapChain,
-            .pImageIndices = &currentColorImage,
-            .pResults = nullptr,
-    });
-    assert(result == VK_SUCCESS);
+uint32_t VulkanDrawable::getUniformSize() {
+    // The whole array declared by the multiview shader is bound, whatever the view count
+    return rendererObj->getViewCount() > 1 ? sizeof(viewMVPs) : sizeof(MVP);
 }
 
 void VulkanDrawable::createVertexIndex(const void *indexData, uint32_t dataSize, uint32_t dataStride) {
@@ -542,39 +555,38 @@ void VulkanDrawable::destroyVertexIndex() {
 
 void VulkanDrawable::createDescriptorSetLayout(bool useTexture)
 {
-    // Define the layout binding information for the descriptor set(before creating it)
-    // Specify binding point, shader type(like vertex shader below), count etc.
-    VkDescriptorSetLayoutBinding layoutBindings[2];
-    layoutBindings[0].binding				= 0; // DESCRIPTOR_SET_BINDING_INDEX
-    layoutBindings[0].descriptorType		= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    layoutBindings[0].descriptorCount		= 1;
-    layoutBindings[0].stageFlags			= VK_SHADER_STAGE_VERTEX_BIT;
-    layoutBindings[0].pImmutableSamplers	= nullptr;
-
-    // If texture is being used then there existing second binding in the fragment shader
-    if (useTexture)
-    {
-        layoutBindings[1].binding				= 1; // DESCRIPTOR_SET_BINDING_INDEX
-        layoutBindings[1].descriptorType		= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        layoutBindings[1].descriptorCount		= 1;
-        layoutBindings[1].stageFlags			= VK_SHADER_STAGE_FRAGMENT_BIT;
-        layoutBindings[1].pImmutableSamplers	= nullptr;
+    const VulkanShaderReflection &reflection = rendererObj->getShader()->reflection;
+
+    // The layout binding information comes from the shaders themselves: binding point,
+    // descriptor type, count and the stages using it. The texture binding only exists
+    // when the fragment shader samples one, useTexture must agree with the shader.
+    assert(reflection.getSetCount() <= 1);
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings = reflection.getSetLayoutBindings(0);
+
+    // One template entry per binding, pointing into the packed DescriptorData struct
+    updateTemplateEntries.clear();
+    for (auto &binding : layoutBindings) {
+        assert(binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+               binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        size_t offset = binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ?
+                        offsetof(decltype(DescriptorData), uniformBuffer) :
+                        offsetof(decltype(DescriptorData), textureImage);
+        updateTemplateEntries.push_back(VkDescriptorUpdateTemplateEntry{
+                binding.binding, 0, binding.descriptorCount, binding.descriptorType, offset, 0});
     }
+    assert(useTexture == (layoutBindings.size() > 1));
 
-    // Specify the layout bind into the VkDescriptorSetLayoutCreateInfo
-    // and use it to create a descriptor set layout
-    VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
-    descriptorLayout.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorLayout.pNext			= nullptr;
-    descriptorLayout.bindingCount	= useTexture ? 2 : 1;
-    descriptorLayout.pBindings		= layoutBindings;
-
-    VkResult  result;
-    // Allocate required number of descriptor layout objects and
-    // create them using vkCreateDescriptorSetLayout()
+    // Identical layouts are shared between the drawables, the cache owns them
+    VkDescriptorSetLayoutCreateFlags flags = descriptorUpdateMode == DESCRIPTOR_UPDATE_PUSH_DESCRIPTOR ?
+                                             VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
     descLayout.resize(1);
-    result = vkCreateDescriptorSetLayout(deviceObj->device, &descriptorLayout, nullptr, descLayout.data());
-    assert(result == VK_SUCCESS);
+    descLayout[0] = rendererObj->getDescriptorLayoutCache()->getLayout(layoutBindings, flags);
+
+    // Set templates only need the set layout, push descriptor
+    // templates are created along with the pipeline layout.
+    if (descriptorUpdateMode == DESCRIPTOR_UPDATE_TEMPLATE) {
+        createDescriptorUpdateTemplate();
+    }
 }
 
 // createPipelineLayout is a virtual function from
@@ -584,24 +596,44 @@ void VulkanDrawable::createDescriptorSetLayout(bool useTexture)
 // Creates the pipeline layout to inject into the pipeline
 void VulkanDrawable::createPipelineLayout()
 {
-    // Set up the push constant range
-    const unsigned pushConstantRangeCount = 1;
-    VkPushConstantRange pushConstantRanges[pushConstantRangeCount] = {};
-    pushConstantRanges[0].stageFlags 	= VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRanges[0].offset 		= 0;
-    pushConstantRanges[0].size 			= 8;
+    bool useBindless = rendererObj->isBindless();
+    bool usePushTransform = rendererObj->getTransformMode() == TRANSFORM_PUSH_CONSTANT;
+
+    // The push constant ranges are the blocks declared by the shaders, the vertex shader block
+    // (bindless uniform buffer index or the whole MVP) comes after the fragment block.
+    const std::vector<VkPushConstantRange> &pushConstantRanges = rendererObj->getShader()->reflection.pushConstantRanges;
+    const auto pushConstantRangeCount = (uint32_t) pushConstantRanges.size();
+    assert(pushConstantRangeCount == (useBindless || usePushTransform ? 2 : 1));
+
+    // Check that none of the ranges exceed the allowed size
+    uint32_t maxPushConstantSize = deviceObj->gpuProps.limits.maxPushConstantsSize;
+    for (unsigned i = 0; i < pushConstantRangeCount; i++) {
+        if (pushConstantRanges[i].offset + pushConstantRanges[i].size > maxPushConstantSize) {
+            assert(0);
+            printf("Push constant range is greater than expected, max allow size is %d", maxPushConstantSize);
+        }
+    }
+
+    // Bindless drawables share the global table layout, it is owned by the table
+    VkDescriptorSetLayout bindlessLayout = rendererObj->getBindlessTable()->setLayout;
 
     // Create the pipeline layout with the help of descriptor layout.
     VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = {};
     pPipelineLayoutCreateInfo.sType						= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pPipelineLayoutCreateInfo.pNext						= nullptr;
     pPipelineLayoutCreateInfo.pushConstantRangeCount	= pushConstantRangeCount;
-    pPipelineLayoutCreateInfo.pPushConstantRanges		= pushConstantRanges;
-    pPipelineLayoutCreateInfo.setLayoutCount			= (uint32_t)descLayout.size();
-    pPipelineLayoutCreateInfo.pSetLayouts				= descLayout.data();
+    pPipelineLayoutCreateInfo.pPushConstantRanges		= pushConstantRanges.data();
+    // Push constant transforms use no descriptor set at all, descLayout is empty
+    pPipelineLayoutCreateInfo.setLayoutCount			= useBindless ? 1 : (uint32_t)descLayout.size();
+    pPipelineLayoutCreateInfo.pSetLayouts				= useBindless ? &bindlessLayout : descLayout.data();
 
     VkResult  result;
     result = vkCreatePipelineLayout(deviceObj->device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout);
     assert(result == VK_SUCCESS);
+
+    // Push constant transforms have no set 0 to push, createDescriptors() made no layout for it
+    if (!useBindless && !usePushTransform && descriptorUpdateMode == DESCRIPTOR_UPDATE_PUSH_DESCRIPTOR) {
+        createDescriptorUpdateTemplate();
+    }
 }
 
@@ -0,0 +1,83 @@
+#include "VulkanFrameCommandPools.h"
+#include "VulkanDevice.h"
+#include "Wrappers.h"
+
+VulkanFrameCommandPools::VulkanFrameCommandPools() {
+    deviceObj = nullptr;
+    threadCount = 0;
+    frameSlot = 0;
+}
+
+VulkanFrameCommandPools::~VulkanFrameCommandPools() = default;
+
+void VulkanFrameCommandPools::initialize(VulkanDevice *device, uint32_t queueFamilyIndex, uint32_t threads) {
+    deviceObj = device;
+    threadCount = threads;
+    frameSlot = 0;
+
+    // The buffers only live for one frame and are only reset through their pool
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.pNext = nullptr;
+    cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    for (auto &frame : frames) {
+        frame.resize(threadCount);
+        for (auto &thread : frame) {
+            VkResult result = vkCreateCommandPool(deviceObj->device, &cmdPoolInfo, nullptr, &thread.pool);
+            assert(result == VK_SUCCESS);
+            thread.usedCount[0] = thread.usedCount[1] = 0;
+        }
+    }
+}
+
+void VulkanFrameCommandPools::destroy() {
+    if (deviceObj == nullptr) {
+        return;
+    }
+    // Destroying a pool frees its command buffers
+    for (auto &frame : frames) {
+        for (auto &thread : frame) {
+            vkDestroyCommandPool(deviceObj->device, thread.pool, nullptr);
+        }
+        frame.clear();
+    }
+    deviceObj = nullptr;
+}
+
+void VulkanFrameCommandPools::beginFrame(uint32_t frameIndex) {
+    frameSlot = frameIndex % FRAMES_IN_FLIGHT;
+
+    // One reset per pool instead of one per command buffer, the memory stays with the pool
+    for (auto &thread : frames[frameSlot]) {
+        if (thread.usedCount[0] == 0 && thread.usedCount[1] == 0) {
+            continue;
+        }
+        VkResult result = vkResetCommandPool(deviceObj->device, thread.pool, 0);
+        assert(result == VK_SUCCESS);
+        thread.usedCount[0] = thread.usedCount[1] = 0;
+    }
+}
+
+VkCommandBuffer VulkanFrameCommandPools::getCommandBuffer(uint32_t threadIndex, VkCommandBufferLevel level) {
+    assert(threadIndex < threadCount);
+    ThreadPool &thread = frames[frameSlot][threadIndex];
+    std::vector<VkCommandBuffer> &buffers = thread.buffers[level];
+    uint32_t &usedCount = thread.usedCount[level];
+
+    // The free list only grows, a frame recording more buffers than the previous ones allocates the difference
+    if (usedCount == buffers.size()) {
+        VkCommandBufferAllocateInfo cmdInfo = {};
+        cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdInfo.pNext = nullptr;
+        cmdInfo.commandPool = thread.pool;
+        cmdInfo.level = level;
+        cmdInfo.commandBufferCount = 1;
+
+        VkCommandBuffer cmdBuf;
+        CommandBufferMgr::allocCommandBuffer(&deviceObj->device, thread.pool, &cmdBuf, &cmdInfo);
+        buffers.push_back(cmdBuf);
+    }
+    return buffers[usedCount++];
+}
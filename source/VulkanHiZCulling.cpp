@@ -0,0 +1,609 @@
+#include "VulkanHiZCulling.h"
+#include "VulkanDevice.h"
+#include "VulkanDescriptorAllocator.h"
+#include "ShaderRegistry.h"
+
+// Workgroup sizes of HiZBuild.comp and HiZCull.comp
+#define HIZ_BUILD_GROUP_SIZE 8
+#define HIZ_CULL_GROUP_SIZE 64
+
+namespace {
+    // Layouts shared with HiZCull.comp
+    struct CullObject {
+        glm::mat4 mvp;
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+        uint32_t draw[4];
+    };
+
+    struct CullObjectsHeader {
+        uint32_t visibleCount;
+        uint32_t padding[3];
+    };
+
+    struct CullPushConstants {
+        glm::vec2 hiZSize;
+        uint32_t objectCount;
+        uint32_t hiZValid;
+    };
+
+    struct BuildPushConstants {
+        int32_t sourceSize[2];
+        int32_t size[2];
+        uint32_t level;
+    };
+}
+
+VulkanHiZCulling::VulkanHiZCulling() {
+    deviceObj = nullptr;
+    descriptorAllocator = nullptr;
+    width = height = mipCount = 0;
+    objectCount = 0;
+    pyramid = VK_NULL_HANDLE;
+    pyramidMemory = VK_NULL_HANDLE;
+    pyramidView = VK_NULL_HANDLE;
+    depthView = VK_NULL_HANDLE;
+    sampler = VK_NULL_HANDLE;
+    memset(objectBuffers, 0, sizeof(objectBuffers));
+    memset(&indirectBuffer, 0, sizeof(indirectBuffer));
+    memset(slotCulled, 0, sizeof(slotCulled));
+    pyramidBuilt = false;
+    descriptorPool = VK_NULL_HANDLE;
+    buildSetLayout = cullSetLayout = VK_NULL_HANDLE;
+    buildLayout = cullLayout = VK_NULL_HANDLE;
+    buildPipeline = cullPipeline = VK_NULL_HANDLE;
+    testedObjects = 0;
+    visibleObjects = 0;
+}
+
+VulkanHiZCulling::~VulkanHiZCulling() = default;
+
+bool VulkanHiZCulling::initialize(VulkanDevice *device, VulkanDescriptorAllocator *allocator, VkCommandBuffer setupCmd,
+                                  uint32_t w, uint32_t h, uint32_t objects) {
+    deviceObj = device;
+    descriptorAllocator = allocator;
+    width = w;
+    height = h;
+    objectCount = objects;
+    mipCount = 1;
+    while ((std::max(width, height) >> mipCount) > 0) {
+        mipCount++;
+    }
+    pyramidBuilt = false;
+    memset(slotCulled, 0, sizeof(slotCulled));
+
+    VkResult result;
+
+    // Build: source sampled, destination level written
+    VkDescriptorSetLayoutBinding buildBindings[2] = {};
+    buildBindings[0].binding = 0;
+    buildBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    buildBindings[0].descriptorCount = 1;
+    buildBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    buildBindings[1].binding = 1;
+    buildBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    buildBindings[1].descriptorCount = 1;
+    buildBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    // Cull: objects, indirect draws, pyramid
+    VkDescriptorSetLayoutBinding cullBindings[3] = {};
+    cullBindings[0].binding = 0;
+    cullBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    cullBindings[0].descriptorCount = 1;
+    cullBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullBindings[1].binding = 1;
+    cullBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    cullBindings[1].descriptorCount = 1;
+    cullBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullBindings[2].binding = 2;
+    cullBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    cullBindings[2].descriptorCount = 1;
+    cullBindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.pNext = nullptr;
+    setLayoutInfo.bindingCount = 2;
+    setLayoutInfo.pBindings = buildBindings;
+    result = vkCreateDescriptorSetLayout(deviceObj->device, &setLayoutInfo, nullptr, &buildSetLayout);
+    assert(result == VK_SUCCESS);
+    setLayoutInfo.bindingCount = 3;
+    setLayoutInfo.pBindings = cullBindings;
+    result = vkCreateDescriptorSetLayout(deviceObj->device, &setLayoutInfo, nullptr, &cullSetLayout);
+    assert(result == VK_SUCCESS);
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pNext = nullptr;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    pipelineLayoutInfo.pSetLayouts = &buildSetLayout;
+    pushConstantRange.size = sizeof(BuildPushConstants);
+    result = vkCreatePipelineLayout(deviceObj->device, &pipelineLayoutInfo, nullptr, &buildLayout);
+    assert(result == VK_SUCCESS);
+    pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+    pushConstantRange.size = sizeof(CullPushConstants);
+    result = vkCreatePipelineLayout(deviceObj->device, &pipelineLayoutInfo, nullptr, &cullLayout);
+    assert(result == VK_SUCCESS);
+
+    buildPipeline = createComputePipeline("HiZBuild.comp", buildLayout);
+    cullPipeline = createComputePipeline("HiZCull.comp", cullLayout);
+    if (buildPipeline == VK_NULL_HANDLE || cullPipeline == VK_NULL_HANDLE) {
+        destroy();
+        return false;
+    }
+
+    // Nearest texel of the requested level, the reduction already made it conservative
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.pNext = nullptr;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = (float) mipCount;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    result = vkCreateSampler(deviceObj->device, &samplerInfo, nullptr, &sampler);
+    assert(result == VK_SUCCESS);
+
+    createPyramid(setupCmd);
+
+    VkDeviceSize objectsSize = sizeof(CullObjectsHeader) + std::max(1u, objectCount) * sizeof(CullObject);
+    for (auto &objectBuffer : objectBuffers) {
+        createBuffer(objectBuffer, objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        memset(objectBuffer.mapped, 0, objectsSize);
+    }
+    createBuffer(indirectBuffer, std::max(1u, objectCount) * sizeof(VkDrawIndirectCommand),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    return true;
+}
+
+VkPipeline VulkanHiZCulling::createComputePipeline(const char *shaderName, VkPipelineLayout layout) {
+    const EmbeddedShader *shader = findEmbeddedShader(shaderName);
+    if (!shader) {
+        std::cout << "Shader " << shaderName << " is not embedded in the binary\n";
+        return VK_NULL_HANDLE;
+    }
+
+    VkShaderModuleCreateInfo moduleInfo = {};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.pNext = nullptr;
+    moduleInfo.flags = 0;
+    moduleInfo.codeSize = shader->size;
+    moduleInfo.pCode = shader->code;
+
+    VkShaderModule module;
+    VkResult result = vkCreateShaderModule(deviceObj->device, &moduleInfo, nullptr, &module);
+    assert(result == VK_SUCCESS);
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = nullptr;
+    pipelineInfo.flags = 0;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.pNext = nullptr;
+    pipelineInfo.stage.flags = 0;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = nullptr;
+    pipelineInfo.layout = layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = 0;
+
+    VkPipeline pipeline;
+    result = vkCreateComputePipelines(deviceObj->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    assert(result == VK_SUCCESS);
+
+    // The pipeline keeps what it needs of the module
+    vkDestroyShaderModule(deviceObj->device, module, nullptr);
+    return pipeline;
+}
+
+void VulkanHiZCulling::createPyramid(VkCommandBuffer setupCmd) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.pNext = nullptr;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R32G32_SFLOAT;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = mipCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.queueFamilyIndexCount = 0;
+    imageInfo.pQueueFamilyIndices = nullptr;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.flags = 0;
+
+    VkResult result = vkCreateImage(deviceObj->device, &imageInfo, nullptr, &pyramid);
+    assert(result == VK_SUCCESS);
+
+    VkMemoryRequirements memRqrmnt;
+    vkGetImageMemoryRequirements(deviceObj->device, pyramid, &memRqrmnt);
+
+    VkMemoryAllocateInfo memAlloc = {};
+    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAlloc.pNext = nullptr;
+    memAlloc.allocationSize = memRqrmnt.size;
+    memAlloc.memoryTypeIndex = 0;
+    bool pass = deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                    &memAlloc.memoryTypeIndex);
+    assert(pass);
+    result = vkAllocateMemory(deviceObj->device, &memAlloc, nullptr, &pyramidMemory);
+    assert(result == VK_SUCCESS);
+    result = vkBindImageMemory(deviceObj->device, pyramid, pyramidMemory, 0);
+    assert(result == VK_SUCCESS);
+
+    VkImageViewCreateInfo imgViewInfo = {};
+    imgViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imgViewInfo.pNext = nullptr;
+    imgViewInfo.image = pyramid;
+    imgViewInfo.format = VK_FORMAT_R32G32_SFLOAT;
+    imgViewInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY};
+    imgViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imgViewInfo.subresourceRange.baseMipLevel = 0;
+    imgViewInfo.subresourceRange.levelCount = mipCount;
+    imgViewInfo.subresourceRange.baseArrayLayer = 0;
+    imgViewInfo.subresourceRange.layerCount = 1;
+    imgViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imgViewInfo.flags = 0;
+    result = vkCreateImageView(deviceObj->device, &imgViewInfo, nullptr, &pyramidView);
+    assert(result == VK_SUCCESS);
+
+    levelViews.resize(mipCount);
+    for (uint32_t level = 0; level < mipCount; level++) {
+        imgViewInfo.subresourceRange.baseMipLevel = level;
+        imgViewInfo.subresourceRange.levelCount = 1;
+        result = vkCreateImageView(deviceObj->device, &imgViewInfo, nullptr, &levelViews[level]);
+        assert(result == VK_SUCCESS);
+    }
+
+    // The render graph expects the pyramid ready to be sampled when a frame starts
+    VkImageMemoryBarrier2 imgMemoryBarrier = {};
+    imgMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    imgMemoryBarrier.pNext = nullptr;
+    imgMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    imgMemoryBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+    imgMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    imgMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    imgMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imgMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imgMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imgMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imgMemoryBarrier.image = pyramid;
+    imgMemoryBarrier.subresourceRange = imgViewInfo.subresourceRange;
+    imgMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imgMemoryBarrier.subresourceRange.levelCount = mipCount;
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = nullptr;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &imgMemoryBarrier;
+    deviceObj->fpCmdPipelineBarrier2(setupCmd, &dependencyInfo);
+}
+
+void VulkanHiZCulling::setDepthImage(VkImage image, VkFormat format) {
+    // Only the depth aspect can be sampled
+    VkImageViewCreateInfo imgViewInfo = {};
+    imgViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imgViewInfo.pNext = nullptr;
+    imgViewInfo.image = image;
+    imgViewInfo.format = format;
+    imgViewInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY};
+    imgViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    imgViewInfo.subresourceRange.baseMipLevel = 0;
+    imgViewInfo.subresourceRange.levelCount = 1;
+    imgViewInfo.subresourceRange.baseArrayLayer = 0;
+    imgViewInfo.subresourceRange.layerCount = 1;
+    imgViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imgViewInfo.flags = 0;
+    VkResult result = vkCreateImageView(deviceObj->device, &imgViewInfo, nullptr, &depthView);
+    assert(result == VK_SUCCESS);
+
+    createDescriptors();
+}
+
+void VulkanHiZCulling::createDescriptors() {
+    // Only the build sets, they never change. The culling sets are transient, see cull().
+    VkDescriptorPoolSize poolSizes[2];
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = mipCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = mipCount;
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.pNext = nullptr;
+    descriptorPoolInfo.flags = 0;
+    descriptorPoolInfo.maxSets = mipCount;
+    descriptorPoolInfo.poolSizeCount = 2;
+    descriptorPoolInfo.pPoolSizes = poolSizes;
+    VkResult result = vkCreateDescriptorPool(deviceObj->device, &descriptorPoolInfo, nullptr, &descriptorPool);
+    assert(result == VK_SUCCESS);
+
+    std::vector<VkDescriptorSetLayout> buildLayouts(mipCount, buildSetLayout);
+    buildSets.resize(mipCount);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = mipCount;
+    allocInfo.pSetLayouts = buildLayouts.data();
+    result = vkAllocateDescriptorSets(deviceObj->device, &allocInfo, buildSets.data());
+    assert(result == VK_SUCCESS);
+
+    // Level 0 reads the depth buffer, the others the level before them. The pyramid stays in
+    // the general layout while it is built.
+    std::vector<VkDescriptorImageInfo> sources(mipCount);
+    std::vector<VkDescriptorImageInfo> destinations(mipCount);
+    std::vector<VkWriteDescriptorSet> writes;
+    for (uint32_t level = 0; level < mipCount; level++) {
+        sources[level].sampler = sampler;
+        sources[level].imageView = level == 0 ? depthView : levelViews[level - 1];
+        sources[level].imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        destinations[level].sampler = VK_NULL_HANDLE;
+        destinations[level].imageView = levelViews[level];
+        destinations[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.pNext = nullptr;
+        write.dstSet = buildSets[level];
+        write.descriptorCount = 1;
+        write.dstArrayElement = 0;
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &sources[level];
+        writes.push_back(write);
+        write.dstBinding = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write.pImageInfo = &destinations[level];
+        writes.push_back(write);
+    }
+
+    vkUpdateDescriptorSets(deviceObj->device, (uint32_t) writes.size(), writes.data(), 0, nullptr);
+}
+
+void VulkanHiZCulling::createBuffer(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage,
+                                    VkMemoryPropertyFlags properties) {
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.pNext = nullptr;
+    bufInfo.usage = usage;
+    bufInfo.size = size;
+    bufInfo.queueFamilyIndexCount = 0;
+    bufInfo.pQueueFamilyIndices = nullptr;
+    bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufInfo.flags = 0;
+    VkResult result = vkCreateBuffer(deviceObj->device, &bufInfo, nullptr, &buffer.buf);
+    assert(result == VK_SUCCESS);
+
+    VkMemoryRequirements memRqrmnt;
+    vkGetBufferMemoryRequirements(deviceObj->device, buffer.buf, &memRqrmnt);
+
+    VkMemoryAllocateInfo memAlloc = {};
+    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAlloc.pNext = nullptr;
+    memAlloc.allocationSize = memRqrmnt.size;
+    memAlloc.memoryTypeIndex = 0;
+    bool pass = deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits, properties, &memAlloc.memoryTypeIndex);
+    assert(pass);
+    result = vkAllocateMemory(deviceObj->device, &memAlloc, nullptr, &buffer.mem);
+    assert(result == VK_SUCCESS);
+    result = vkBindBufferMemory(deviceObj->device, buffer.buf, buffer.mem, 0);
+    assert(result == VK_SUCCESS);
+
+    // Host visible buffers stay mapped
+    buffer.mapped = nullptr;
+    if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        result = vkMapMemory(deviceObj->device, buffer.mem, 0, VK_WHOLE_SIZE, 0, &buffer.mapped);
+        assert(result == VK_SUCCESS);
+    }
+}
+
+void VulkanHiZCulling::destroyBuffer(Buffer &buffer) {
+    if (buffer.buf == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyBuffer(deviceObj->device, buffer.buf, nullptr);
+    vkFreeMemory(deviceObj->device, buffer.mem, nullptr);
+    memset(&buffer, 0, sizeof(buffer));
+}
+
+void VulkanHiZCulling::destroy() {
+    if (deviceObj == nullptr) {
+        return;
+    }
+    VkDevice device = deviceObj->device;
+    vkDestroyPipeline(device, buildPipeline, nullptr);
+    vkDestroyPipeline(device, cullPipeline, nullptr);
+    vkDestroyPipelineLayout(device, buildLayout, nullptr);
+    vkDestroyPipelineLayout(device, cullLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, buildSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyImageView(device, depthView, nullptr);
+    for (VkImageView view : levelViews) {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    vkDestroyImageView(device, pyramidView, nullptr);
+    vkDestroyImage(device, pyramid, nullptr);
+    vkFreeMemory(device, pyramidMemory, nullptr);
+    for (auto &objectBuffer : objectBuffers) {
+        destroyBuffer(objectBuffer);
+    }
+    destroyBuffer(indirectBuffer);
+
+    buildPipeline = cullPipeline = VK_NULL_HANDLE;
+    buildLayout = cullLayout = VK_NULL_HANDLE;
+    buildSetLayout = cullSetLayout = VK_NULL_HANDLE;
+    descriptorPool = VK_NULL_HANDLE;
+    sampler = VK_NULL_HANDLE;
+    depthView = pyramidView = VK_NULL_HANDLE;
+    levelViews.clear();
+    buildSets.clear();
+    pyramid = VK_NULL_HANDLE;
+    pyramidMemory = VK_NULL_HANDLE;
+    deviceObj = nullptr;
+    descriptorAllocator = nullptr;
+}
+
+void VulkanHiZCulling::setObject(uint32_t frameSlot, uint32_t object, const glm::mat4 &mvp,
+                                 const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, uint32_t vertexCount) {
+    assert(object < objectCount);
+    auto *objects = (CullObject *) ((uint8_t *) objectBuffers[frameSlot].mapped + sizeof(CullObjectsHeader));
+    CullObject &cullObject = objects[object];
+    cullObject.mvp = mvp;
+    cullObject.boundsMin = glm::vec4(boundsMin, 1.0f);
+    cullObject.boundsMax = glm::vec4(boundsMax, 1.0f);
+    cullObject.draw[0] = vertexCount;
+}
+
+void VulkanHiZCulling::collect(uint32_t frameSlot) {
+    auto *header = (CullObjectsHeader *) objectBuffers[frameSlot].mapped;
+    if (slotCulled[frameSlot]) {
+        testedObjects += objectCount;
+        visibleObjects += header->visibleCount;
+    }
+    header->visibleCount = 0;
+}
+
+void VulkanHiZCulling::cull(VkCommandBuffer cmd, uint32_t frameSlot) {
+    // The frame which last used the slot is complete, its count can be read
+    collect(frameSlot);
+    slotCulled[frameSlot] = true;
+
+    // The previous frame's draws read the arguments this dispatch overwrites, and its culling
+    // wrote them. Chaining on the compute stage also orders the reads after the transition which
+    // ended the previous frame's pyramid build.
+    VkMemoryBarrier2 memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = nullptr;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    CullPushConstants pushConstants = {};
+    pushConstants.hiZSize = glm::vec2((float) width, (float) height);
+    pushConstants.objectCount = objectCount;
+    pushConstants.hiZValid = pyramidBuilt ? 1 : 0;
+
+    // The set points at the slot's object buffer, it lives as long as the frame: taken from the
+    // allocator's transient pools, which are reset when the slot comes around again
+    VkDescriptorSet cullSet;
+    VkResult result = descriptorAllocator->allocateTransient(cullSetLayout, &cullSet);
+    assert(result == VK_SUCCESS);
+
+    VkDescriptorBufferInfo objectInfo = {objectBuffers[frameSlot].buf, 0, VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo indirectInfo = {indirectBuffer.buf, 0, VK_WHOLE_SIZE};
+    VkDescriptorImageInfo pyramidInfo = {sampler, pyramidView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkWriteDescriptorSet writes[3] = {};
+    for (uint32_t binding = 0; binding < 3; binding++) {
+        writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[binding].pNext = nullptr;
+        writes[binding].dstSet = cullSet;
+        writes[binding].dstBinding = binding;
+        writes[binding].dstArrayElement = 0;
+        writes[binding].descriptorCount = 1;
+        writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+    writes[0].pBufferInfo = &objectInfo;
+    writes[1].pBufferInfo = &indirectInfo;
+    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[2].pImageInfo = &pyramidInfo;
+    vkUpdateDescriptorSets(deviceObj->device, 3, writes, 0, nullptr);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullLayout, 0, 1, &cullSet, 0, nullptr);
+    vkCmdPushConstants(cmd, cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(cmd, (objectCount + HIZ_CULL_GROUP_SIZE - 1) / HIZ_CULL_GROUP_SIZE, 1, 1);
+
+    // The draws of this frame read the arguments, and collect() reads the visible count on the
+    // CPU once the timeline reaches the frame's value
+    VkMemoryBarrier2 dispatchBarriers[2] = {memoryBarrier, memoryBarrier};
+    dispatchBarriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    dispatchBarriers[0].srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    dispatchBarriers[0].dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+    dispatchBarriers[0].dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+    dispatchBarriers[1].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    dispatchBarriers[1].srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    dispatchBarriers[1].dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    dispatchBarriers[1].dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    dependencyInfo.memoryBarrierCount = 2;
+    dependencyInfo.pMemoryBarriers = dispatchBarriers;
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+void VulkanHiZCulling::build(VkCommandBuffer cmd) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, buildPipeline);
+
+    // Each level reads the one written just before it
+    VkMemoryBarrier2 memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = nullptr;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+
+    BuildPushConstants pushConstants = {};
+    pushConstants.sourceSize[0] = (int32_t) width;
+    pushConstants.sourceSize[1] = (int32_t) height;
+    for (uint32_t level = 0; level < mipCount; level++) {
+        if (level > 0) {
+            deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+        }
+        pushConstants.size[0] = (int32_t) std::max(1u, width >> level);
+        pushConstants.size[1] = (int32_t) std::max(1u, height >> level);
+        pushConstants.level = level;
+
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, buildLayout, 0, 1, &buildSets[level], 0,
+                                nullptr);
+        vkCmdPushConstants(cmd, buildLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+        vkCmdDispatch(cmd, (pushConstants.size[0] + HIZ_BUILD_GROUP_SIZE - 1) / HIZ_BUILD_GROUP_SIZE,
+                      (pushConstants.size[1] + HIZ_BUILD_GROUP_SIZE - 1) / HIZ_BUILD_GROUP_SIZE, 1);
+
+        pushConstants.sourceSize[0] = pushConstants.size[0];
+        pushConstants.sourceSize[1] = pushConstants.size[1];
+    }
+    pyramidBuilt = true;
+}
+
+void VulkanHiZCulling::printStatistics() {
+    std::cout << "\n\nHi-Z culling statistics:\n";
+    std::cout << "\t|---[Pyramid levels]--> " << mipCount << "\n";
+    std::cout << "\t|---[Objects tested]--> " << testedObjects << "\n";
+    std::cout << "\t|---[Objects visible]--> " << visibleObjects << std::endl;
+}
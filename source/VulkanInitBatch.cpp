@@ -0,0 +1,45 @@
+#include "VulkanInitBatch.h"
+#include "VulkanDevice.h"
+#include "Wrappers.h"
+
+VulkanInitBatch::VulkanInitBatch() {
+    deviceObj = nullptr;
+    cmdPool = VK_NULL_HANDLE;
+    cmdBuf = VK_NULL_HANDLE;
+}
+
+VulkanInitBatch::~VulkanInitBatch() = default;
+
+void VulkanInitBatch::begin(VulkanDevice *device, VkCommandPool commandPool) {
+    assert(!isRecording());
+    deviceObj = device;
+    cmdPool = commandPool;
+
+    CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &cmdBuf);
+    CommandBufferMgr::beginCommandBuffer(cmdBuf);
+}
+
+VkCommandBuffer VulkanInitBatch::getCommandBuffer() {
+    assert(isRecording());
+    return cmdBuf;
+}
+
+void VulkanInitBatch::addWait(const TimelinePoint &point, VkPipelineStageFlags waitStageMask) {
+    assert(isRecording());
+    waits.push_back(TimelineWait{point.semaphore, point.value, waitStageMask});
+}
+
+void VulkanInitBatch::flush() {
+    assert(isRecording());
+
+    CommandBufferMgr::endCommandBuffer(cmdBuf);
+
+    // Only this batch is waited on, not the whole queue
+    VulkanTimeline *timeline = deviceObj->getTimeline(QUEUE_GRAPHICS);
+    uint64_t value = timeline->submit(&cmdBuf, 1, waits);
+    timeline->wait(value);
+
+    vkFreeCommandBuffers(deviceObj->device, cmdPool, 1, &cmdBuf);
+    cmdBuf = VK_NULL_HANDLE;
+    waits.clear();
+}
@@ -14,7 +14,7 @@ VkResult VulkanInstance::createInstance(std::vector<const char *> &layers, std::
     appInfo.engineVersion = 1;
 
     // VK_API_VERSION is now deprecated, use VK_MAKE_VERSION instead
-    appInfo.apiVersion = VK_MAKE_VERSION(1, 2, 0);
+    appInfo.apiVersion = VK_MAKE_VERSION(1, 3, 0);
 
     // Define the Vulkan instance create info structure
     VkInstanceCreateInfo instInfo = {};
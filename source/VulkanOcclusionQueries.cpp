@@ -0,0 +1,109 @@
+#include "VulkanOcclusionQueries.h"
+#include "VulkanDevice.h"
+
+VulkanOcclusionQueries::VulkanOcclusionQueries() {
+    deviceObj = nullptr;
+    queryPool = VK_NULL_HANDLE;
+    objectCount = 0;
+    viewCount = 1;
+    frameSlot = 0;
+    memset(slotFrames, 0, sizeof(slotFrames));
+    testedDraws = 0;
+    culledDraws = 0;
+}
+
+VulkanOcclusionQueries::~VulkanOcclusionQueries() = default;
+
+void VulkanOcclusionQueries::initialize(VulkanDevice *device, uint32_t objects, uint32_t views) {
+    deviceObj = device;
+    objectCount = objects;
+    viewCount = views;
+    frameSlot = 0;
+    memset(slotFrames, 0, sizeof(slotFrames));
+    resultFrames.assign(objectCount, 0);
+    visible.assign(objectCount, true);
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.pNext = nullptr;
+    queryPoolInfo.flags = 0;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+    queryPoolInfo.queryCount = std::max(1u, objectCount * viewCount * FRAMES_IN_FLIGHT);
+    queryPoolInfo.pipelineStatistics = 0;
+
+    VkResult result = vkCreateQueryPool(deviceObj->device, &queryPoolInfo, nullptr, &queryPool);
+    assert(result == VK_SUCCESS);
+}
+
+void VulkanOcclusionQueries::destroy() {
+    if (queryPool == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyQueryPool(deviceObj->device, queryPool, nullptr);
+    queryPool = VK_NULL_HANDLE;
+}
+
+void VulkanOcclusionQueries::beginFrame(VkCommandBuffer cmd, uint32_t frameIndex) {
+    frameSlot = frameIndex % FRAMES_IN_FLIGHT;
+
+    // The slot of this frame holds the results of a completed frame, they must be read before
+    // its queries are reset. The other slots belong to frames which may still be in flight.
+    for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+        collect(slot);
+    }
+
+    vkCmdResetQueryPool(cmd, queryPool, frameSlot * objectCount * viewCount, objectCount * viewCount);
+    slotFrames[frameSlot] = frameIndex;
+}
+
+void VulkanOcclusionQueries::collect(uint32_t slot) {
+    uint32_t frame = slotFrames[slot];
+    if (frame == 0 || objectCount == 0) {
+        return;
+    }
+
+    // Sample count and availability of each query, the queries still in flight are skipped and
+    // a result only replaces an older one. An object is visible if any of its views saw it.
+    uint32_t queryCount = objectCount * viewCount;
+    std::vector<uint64_t> results(queryCount * 2);
+    vkGetQueryPoolResults(deviceObj->device, queryPool, slot * queryCount, queryCount,
+                          results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    for (uint32_t object = 0; object < objectCount; object++) {
+        bool available = true;
+        uint64_t samples = 0;
+        for (uint32_t view = 0; view < viewCount; view++) {
+            const uint64_t *result = &results[(object * viewCount + view) * 2];
+            available = available && result[1] != 0;
+            samples += result[0];
+        }
+        if (available && frame > resultFrames[object]) {
+            visible[object] = samples != 0;
+            resultFrames[object] = frame;
+        }
+    }
+}
+
+void VulkanOcclusionQueries::beginQuery(VkCommandBuffer cmd, uint32_t object) {
+    // Any sample passing is enough, the precise count is not needed
+    vkCmdBeginQuery(cmd, queryPool, (frameSlot * objectCount + object) * viewCount, 0);
+}
+
+void VulkanOcclusionQueries::endQuery(VkCommandBuffer cmd, uint32_t object) {
+    vkCmdEndQuery(cmd, queryPool, (frameSlot * objectCount + object) * viewCount);
+}
+
+bool VulkanOcclusionQueries::isVisible(uint32_t object) {
+    testedDraws++;
+    if (!visible[object]) {
+        culledDraws++;
+        return false;
+    }
+    return true;
+}
+
+void VulkanOcclusionQueries::printStatistics() {
+    std::cout << "\n\nOcclusion culling statistics:\n";
+    std::cout << "\t|---[Draws tested]--> " << testedDraws << "\n";
+    std::cout << "\t|---[Draws culled]--> " << culledDraws << std::endl;
+}
@@ -2,6 +2,8 @@
 #include "VulkanApplication.h"
 #include "VulkanShader.h"
 #include "VulkanRenderer.h"
+#include <filesystem>
+#include <fstream>
 
 
 VulkanPipeline::VulkanPipeline() {
@@ -17,8 +19,9 @@ void VulkanPipeline::createPipelineCache() {
     VkPipelineCacheCreateInfo pipelineCacheCreateInfo;
     pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
     pipelineCacheCreateInfo.pNext = nullptr;
-    pipelineCacheCreateInfo.initialDataSize = 0;
-    pipelineCacheCreateInfo.pInitialData = nullptr;
+    // Seed the cache with the pipelines of the previous run or of the cache destroyed on resize
+    pipelineCacheCreateInfo.initialDataSize = pipelineCacheData.size();
+    pipelineCacheCreateInfo.pInitialData = pipelineCacheData.empty() ? nullptr : pipelineCacheData.data();
     pipelineCacheCreateInfo.flags = 0;
 
     result = vkCreatePipelineCache(deviceObj->device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
@@ -26,7 +29,8 @@ void VulkanPipeline::createPipelineCache() {
 }
 
 bool VulkanPipeline::createPipeline(VulkanDrawable *drawableObj, VkPipeline *pipeline, VulkanShader *shaderObj,
-                                    VkBool32 includeDepth, VkBool32 includeVi) {
+                                    VkBool32 includeDepth, VkBool32 includeVi, const ShaderVariantKey *variantKey,
+                                    PipelinePass pass) {
 #define VK_DYNAMIC_STATE_RANGE_SIZE 30
     VkDynamicState dynamicStateEnables[VK_DYNAMIC_STATE_RANGE_SIZE];
     memset(dynamicStateEnables, 0, sizeof dynamicStateEnables);
@@ -47,9 +51,8 @@ bool VulkanPipeline::createPipeline(VulkanDrawable *drawableObj, VkPipeline *pip
         vertexInputStateCreateInfo.vertexBindingDescriptionCount =
                 sizeof(drawableObj->viIpBind) / sizeof(VkVertexInputBindingDescription);
         vertexInputStateCreateInfo.pVertexBindingDescriptions = &drawableObj->viIpBind;
-        vertexInputStateCreateInfo.vertexAttributeDescriptionCount =
-                sizeof(drawableObj->viIpAttr) / sizeof(VkVertexInputAttributeDescription);
-        vertexInputStateCreateInfo.pVertexAttributeDescriptions = drawableObj->viIpAttr;
+        vertexInputStateCreateInfo.vertexAttributeDescriptionCount = (uint32_t) drawableObj->viIpAttr.size();
+        vertexInputStateCreateInfo.pVertexAttributeDescriptions = drawableObj->viIpAttr.data();
     }
 
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
@@ -89,7 +92,8 @@ bool VulkanPipeline::createPipeline(VulkanDrawable *drawableObj, VkPipeline *pip
     colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlendStateCreateInfo.flags = 0;
     colorBlendStateCreateInfo.pNext = nullptr;
-    colorBlendStateCreateInfo.attachmentCount = 1;
+    // The depth pre-pass has no color attachment
+    colorBlendStateCreateInfo.attachmentCount = pass == PIPELINE_PASS_DEPTH_ONLY ? 0 : 1;
     colorBlendStateCreateInfo.pAttachments = colorBlendAttachmentStateInfo;
     colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
 //    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_NO_OP;
@@ -120,6 +124,11 @@ bool VulkanPipeline::createPipeline(VulkanDrawable *drawableObj, VkPipeline *pip
     depthStencilStateCreateInfo.depthTestEnable = includeDepth;
     depthStencilStateCreateInfo.depthWriteEnable = includeDepth;
     depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    if (pass == PIPELINE_PASS_DEPTH_EQUAL) {
+        // The pre-pass wrote the final depth, only the samples matching it are shaded
+        depthStencilStateCreateInfo.depthWriteEnable = VK_FALSE;
+        depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    }
     depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
     depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
     depthStencilStateCreateInfo.back.failOp = VK_STENCIL_OP_KEEP;
@@ -138,7 +147,7 @@ bool VulkanPipeline::createPipeline(VulkanDrawable *drawableObj, VkPipeline *pip
     multisampleStateCreateInfo.pNext = nullptr;
     multisampleStateCreateInfo.flags = 0;
     multisampleStateCreateInfo.pSampleMask = nullptr;
-    multisampleStateCreateInfo.rasterizationSamples = NUM_SAMPLES;
+    multisampleStateCreateInfo.rasterizationSamples = appObj->rendererObj->getSampleCount();
     multisampleStateCreateInfo.sampleShadingEnable = VK_FALSE;
     multisampleStateCreateInfo.alphaToCoverageEnable = VK_FALSE;
     multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE;
@@ -160,11 +169,30 @@ bool VulkanPipeline::createPipeline(VulkanDrawable *drawableObj, VkPipeline *pip
     pipelineCreateInfo.pDynamicState = &dynamicState;
     pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
     pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
-    pipelineCreateInfo.pStages = shaderObj->shaderStages;
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.renderPass = appObj->rendererObj->renderPass;
+    // Specialized stages carry their specialization constants through pSpecializationInfo
+    pipelineCreateInfo.pStages = variantKey ? shaderObj->getVariantStages(*variantKey) : shaderObj->shaderStages;
+    // The vertex stage comes first, a depth only pipeline has no fragment shader
+    pipelineCreateInfo.stageCount = pass == PIPELINE_PASS_DEPTH_ONLY ? 1 : 2;
+    pipelineCreateInfo.renderPass = pass == PIPELINE_PASS_DEPTH_ONLY ? appObj->rendererObj->prePassRenderPass
+                                                                     : appObj->rendererObj->renderPass;
     pipelineCreateInfo.subpass = 0;
 
+    // Dynamic rendering: the pipeline is compatible with any rendering instance using the same formats
+    VkPipelineRenderingCreateInfo renderingInfo;
+    if (appObj->rendererObj->isDynamicRendering()) {
+        renderingInfo = appObj->rendererObj->sceneRenderingInfo;
+        if (!includeDepth) {
+            renderingInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+            renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+        }
+        if (pass == PIPELINE_PASS_DEPTH_ONLY) {
+            renderingInfo.colorAttachmentCount = 0;
+            renderingInfo.pColorAttachmentFormats = nullptr;
+        }
+        pipelineCreateInfo.pNext = &renderingInfo;
+        pipelineCreateInfo.renderPass = VK_NULL_HANDLE;
+    }
+
     // Create the pipeline using the meta-data store in the VkGraphicsPipelineCreateInfo object
     if (vkCreateGraphicsPipelines(deviceObj->device, pipelineCache, 1, &pipelineCreateInfo, nullptr, pipeline) ==
         VK_SUCCESS) {
@@ -173,8 +201,125 @@ bool VulkanPipeline::createPipeline(VulkanDrawable *drawableObj, VkPipeline *pip
     return false;
 }
 
-// Destroy the pipeline cache object when no more required
+VkPipeline *VulkanPipeline::getPipelineVariant(VulkanDrawable *drawableObj, VulkanShader *shaderObj,
+                                              const ShaderVariantKey &variantKey, VkBool32 includeDepth,
+                                              PipelinePass pass) {
+    PipelineVariantKey key = {drawableObj->pipelineLayout, variantKey, pass};
+    auto found = variantPipelines.find(key);
+    if (found != variantPipelines.end()) {
+        return found->second.pipeline;
+    }
+
+    auto *pipeline = (VkPipeline *) malloc(sizeof(VkPipeline));
+    if (!createPipeline(drawableObj, pipeline, shaderObj, includeDepth, true, &variantKey, pass)) {
+        free(pipeline);
+        return nullptr;
+    }
+    variantPipelines[key] = PipelineVariant{pipeline, drawableObj, includeDepth, VK_NULL_HANDLE};
+    return pipeline;
+}
+
+void VulkanPipeline::destroyPipelineVariants() {
+    discardReloadedVariants();
+    for (auto &variant : variantPipelines) {
+        vkDestroyPipeline(deviceObj->device, *variant.second.pipeline, nullptr);
+        free(variant.second.pipeline);
+    }
+    variantPipelines.clear();
+}
+
+bool VulkanPipeline::createReloadedVariants(VulkanShader *shaderObj) {
+    for (auto &variant : variantPipelines) {
+        // Same state as the original pipeline, only the shader modules differ. The
+        // pipeline cache is internally synchronized, the render thread keeps using it.
+        PipelineVariant &pipeline = variant.second;
+        if (!createPipeline(pipeline.drawable, &pipeline.reloaded, shaderObj, pipeline.includeDepth, true,
+                            &variant.first.shader, variant.first.pass)) {
+            pipeline.reloaded = VK_NULL_HANDLE;
+            discardReloadedVariants();
+            return false;
+        }
+    }
+    return true;
+}
+
+void VulkanPipeline::swapReloadedVariants(VulkanDeletionQueue *deletionQueue) {
+    TimelinePoint releasePoint = deletionQueue->getReleasePoint();
+    for (auto &variant : variantPipelines) {
+        // The handle is replaced in place, the drawables keep their pipeline pointer
+        PipelineVariant &pipeline = variant.second;
+        deletionQueue->destroyPipeline(*pipeline.pipeline, releasePoint);
+        *pipeline.pipeline = pipeline.reloaded;
+        pipeline.reloaded = VK_NULL_HANDLE;
+    }
+}
+
+void VulkanPipeline::discardReloadedVariants() {
+    for (auto &variant : variantPipelines) {
+        if (variant.second.reloaded != VK_NULL_HANDLE) {
+            vkDestroyPipeline(deviceObj->device, variant.second.reloaded, nullptr);
+            variant.second.reloaded = VK_NULL_HANDLE;
+        }
+    }
+}
+
+bool VulkanPipeline::loadPipelineCacheData(const char *fileName) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> data((size_t) file.tellg());
+    file.seekg(0);
+    file.read((char *) data.data(), (std::streamsize) data.size());
+
+    // The driver rejects foreign data on its own, checking the header here avoids
+    // handing it a cache written by another GPU or driver version.
+    VkPipelineCacheHeaderVersionOne header;
+    if (!file || data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    const VkPhysicalDeviceProperties &gpuProps = deviceObj->gpuProps;
+    if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header.vendorID != gpuProps.vendorID ||
+        header.deviceID != gpuProps.deviceID ||
+        memcmp(header.pipelineCacheUUID, gpuProps.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cout << "Pipeline cache " << fileName << " was written by another device or driver, ignored\n";
+        return false;
+    }
+
+    pipelineCacheData = std::move(data);
+    return true;
+}
+
+void VulkanPipeline::savePipelineCacheData(const char *fileName) {
+    if (pipelineCacheData.empty()) {
+        return;
+    }
+
+    // Write aside and rename, an interrupted write never leaves a truncated cache behind
+    std::string temporaryName = std::string(fileName) + ".tmp";
+    {
+        std::ofstream file(temporaryName, std::ios::binary | std::ios::trunc);
+        file.write((const char *) pipelineCacheData.data(), (std::streamsize) pipelineCacheData.size());
+        if (!file) {
+            std::cout << "Cannot write the pipeline cache " << temporaryName << "\n";
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryName, fileName, error);
+}
+
+// Destroy the pipeline cache object when no more required, its
+// content is kept to seed the next cache and to be saved on exit.
 void VulkanPipeline::destroyPipelineCache()
 {
+    size_t dataSize = 0;
+    VkResult result = vkGetPipelineCacheData(deviceObj->device, pipelineCache, &dataSize, nullptr);
+    if (result == VK_SUCCESS && dataSize > 0) {
+        pipelineCacheData.resize(dataSize);
+        result = vkGetPipelineCacheData(deviceObj->device, pipelineCache, &dataSize, pipelineCacheData.data());
+        pipelineCacheData.resize(result == VK_SUCCESS ? dataSize : 0);
+    }
     vkDestroyPipelineCache(deviceObj->device, pipelineCache, nullptr);
 }
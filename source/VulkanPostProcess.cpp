@@ -0,0 +1,683 @@
+#include "VulkanPostProcess.h"
+#include "VulkanDevice.h"
+#include "ShaderRegistry.h"
+#include "Wrappers.h"
+
+// Workgroup size of the PostTonemap.comp, PostFxaa.comp and PostDownsample.comp
+#define POST_GROUP_SIZE 8
+// Readback texels per downsampled pixel along each axis, as in PostDownsample.comp
+#define POST_DOWNSAMPLE_FACTOR 4
+// Scale of the frame colors before the filmic curve
+#define POST_EXPOSURE 1.0f
+
+namespace {
+    // Layout shared with the post-processing shaders
+    struct PostPushConstants {
+        int32_t size[2];
+        float exposure;
+        uint32_t decodeSource;
+    };
+
+    bool isSrgbFormat(VkFormat format) {
+        return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB ||
+               format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+    }
+}
+
+VulkanPostProcess::VulkanPostProcess() {
+    deviceObj = nullptr;
+    timeline = nullptr;
+    graphicsFamily = computeFamily = 0;
+    format = VK_FORMAT_UNDEFINED;
+    width = height = 0;
+    readbackWidth = readbackHeight = 0;
+    memset(inputImages, 0, sizeof(inputImages));
+    memset(&tonemapped, 0, sizeof(tonemapped));
+    memset(&filtered, 0, sizeof(filtered));
+    memset(readbackBuffers, 0, sizeof(readbackBuffers));
+    sampler = VK_NULL_HANDLE;
+    descriptorPool = VK_NULL_HANDLE;
+    imageSetLayout = readbackSetLayout = VK_NULL_HANDLE;
+    imageLayout = readbackLayout = VK_NULL_HANDLE;
+    tonemapPipeline = fxaaPipeline = downsamplePipeline = VK_NULL_HANDLE;
+    memset(tonemapSets, 0, sizeof(tonemapSets));
+    fxaaSet = VK_NULL_HANDLE;
+    memset(downsampleSets, 0, sizeof(downsampleSets));
+    cmdPool = VK_NULL_HANDLE;
+    memset(cmdChains, 0, sizeof(cmdChains));
+    memset(slotValues, 0, sizeof(slotValues));
+    processedFrames = 0;
+    stalledFrames = 0;
+    lastLuminance = 0.0f;
+}
+
+VulkanPostProcess::~VulkanPostProcess() = default;
+
+bool VulkanPostProcess::initialize(VulkanDevice *device, VkFormat frameFormat, uint32_t w, uint32_t h) {
+    deviceObj = device;
+    format = frameFormat;
+    width = w;
+    height = h;
+    readbackWidth = (width + POST_DOWNSAMPLE_FACTOR - 1) / POST_DOWNSAMPLE_FACTOR;
+    readbackHeight = (height + POST_DOWNSAMPLE_FACTOR - 1) / POST_DOWNSAMPLE_FACTOR;
+    memset(slotValues, 0, sizeof(slotValues));
+
+    // Without a dedicated family the chains go to the queue the compute timeline aliases
+    timeline = deviceObj->getTimeline(QUEUE_COMPUTE);
+    graphicsFamily = deviceObj->graphicsQueueWithPresentIndex;
+    computeFamily = deviceObj->hasDedicatedComputeQueue() ? deviceObj->computeQueueIndex : graphicsFamily;
+
+    VkResult result;
+
+    // Tone mapping and filtering: source sampled, destination written. Downsampling: source
+    // sampled, readback written.
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.pNext = nullptr;
+    setLayoutInfo.bindingCount = 2;
+    setLayoutInfo.pBindings = bindings;
+    result = vkCreateDescriptorSetLayout(deviceObj->device, &setLayoutInfo, nullptr, &imageSetLayout);
+    assert(result == VK_SUCCESS);
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    result = vkCreateDescriptorSetLayout(deviceObj->device, &setLayoutInfo, nullptr, &readbackSetLayout);
+    assert(result == VK_SUCCESS);
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PostPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pNext = nullptr;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    pipelineLayoutInfo.pSetLayouts = &imageSetLayout;
+    result = vkCreatePipelineLayout(deviceObj->device, &pipelineLayoutInfo, nullptr, &imageLayout);
+    assert(result == VK_SUCCESS);
+    pipelineLayoutInfo.pSetLayouts = &readbackSetLayout;
+    result = vkCreatePipelineLayout(deviceObj->device, &pipelineLayoutInfo, nullptr, &readbackLayout);
+    assert(result == VK_SUCCESS);
+
+    tonemapPipeline = createComputePipeline("PostTonemap.comp", imageLayout);
+    fxaaPipeline = createComputePipeline("PostFxaa.comp", imageLayout);
+    downsamplePipeline = createComputePipeline("PostDownsample.comp", readbackLayout);
+    if (tonemapPipeline == VK_NULL_HANDLE || fxaaPipeline == VK_NULL_HANDLE || downsamplePipeline == VK_NULL_HANDLE) {
+        destroy();
+        return false;
+    }
+
+    // The filter and the downsampling blend between texels
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.pNext = nullptr;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    result = vkCreateSampler(deviceObj->device, &samplerInfo, nullptr, &sampler);
+    assert(result == VK_SUCCESS);
+
+    // The input images are only read with texelFetch, the frame format needs no filtering
+    for (auto &inputImage : inputImages) {
+        createImage(inputImage, format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    }
+    createImage(tonemapped, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    createImage(filtered, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    for (auto &readbackBuffer : readbackBuffers) {
+        createBuffer(readbackBuffer, (VkDeviceSize) readbackWidth * readbackHeight * sizeof(uint32_t),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    createDescriptors();
+
+    // The chains never change, they are recorded once per slot
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.pNext = nullptr;
+    cmdPoolInfo.queueFamilyIndex = computeFamily;
+    cmdPoolInfo.flags = 0;
+    result = vkCreateCommandPool(deviceObj->device, &cmdPoolInfo, nullptr, &cmdPool);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferAllocateInfo cmdInfo = {};
+    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdInfo.pNext = nullptr;
+    cmdInfo.commandPool = cmdPool;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdInfo.commandBufferCount = FRAMES_IN_FLIGHT;
+    result = vkAllocateCommandBuffers(deviceObj->device, &cmdInfo, cmdChains);
+    assert(result == VK_SUCCESS);
+    for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+        recordChain(slot);
+    }
+    return true;
+}
+
+VkPipeline VulkanPostProcess::createComputePipeline(const char *shaderName, VkPipelineLayout layout) {
+    const EmbeddedShader *shader = findEmbeddedShader(shaderName);
+    if (!shader) {
+        std::cout << "Shader " << shaderName << " is not embedded in the binary\n";
+        return VK_NULL_HANDLE;
+    }
+
+    VkShaderModuleCreateInfo moduleInfo = {};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.pNext = nullptr;
+    moduleInfo.flags = 0;
+    moduleInfo.codeSize = shader->size;
+    moduleInfo.pCode = shader->code;
+
+    VkShaderModule module;
+    VkResult result = vkCreateShaderModule(deviceObj->device, &moduleInfo, nullptr, &module);
+    assert(result == VK_SUCCESS);
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = nullptr;
+    pipelineInfo.flags = 0;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.pNext = nullptr;
+    pipelineInfo.stage.flags = 0;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = nullptr;
+    pipelineInfo.layout = layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = 0;
+
+    VkPipeline pipeline;
+    result = vkCreateComputePipelines(deviceObj->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    assert(result == VK_SUCCESS);
+
+    // The pipeline keeps what it needs of the module
+    vkDestroyShaderModule(deviceObj->device, module, nullptr);
+    return pipeline;
+}
+
+void VulkanPostProcess::createImage(Image &image, VkFormat imageFormat, VkImageUsageFlags usage) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.pNext = nullptr;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = imageFormat;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.queueFamilyIndexCount = 0;
+    imageInfo.pQueueFamilyIndices = nullptr;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.usage = usage;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.flags = 0;
+
+    VkResult result = vkCreateImage(deviceObj->device, &imageInfo, nullptr, &image.image);
+    assert(result == VK_SUCCESS);
+
+    VkMemoryRequirements memRqrmnt;
+    vkGetImageMemoryRequirements(deviceObj->device, image.image, &memRqrmnt);
+
+    VkMemoryAllocateInfo memAlloc = {};
+    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAlloc.pNext = nullptr;
+    memAlloc.allocationSize = memRqrmnt.size;
+    memAlloc.memoryTypeIndex = 0;
+    bool pass = deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                    &memAlloc.memoryTypeIndex);
+    assert(pass);
+    result = vkAllocateMemory(deviceObj->device, &memAlloc, nullptr, &image.mem);
+    assert(result == VK_SUCCESS);
+    result = vkBindImageMemory(deviceObj->device, image.image, image.mem, 0);
+    assert(result == VK_SUCCESS);
+
+    VkImageViewCreateInfo imgViewInfo = {};
+    imgViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imgViewInfo.pNext = nullptr;
+    imgViewInfo.image = image.image;
+    imgViewInfo.format = imageFormat;
+    imgViewInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY};
+    imgViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imgViewInfo.subresourceRange.baseMipLevel = 0;
+    imgViewInfo.subresourceRange.levelCount = 1;
+    imgViewInfo.subresourceRange.baseArrayLayer = 0;
+    imgViewInfo.subresourceRange.layerCount = 1;
+    imgViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imgViewInfo.flags = 0;
+    result = vkCreateImageView(deviceObj->device, &imgViewInfo, nullptr, &image.view);
+    assert(result == VK_SUCCESS);
+}
+
+void VulkanPostProcess::destroyImage(Image &image) {
+    if (image.image == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyImageView(deviceObj->device, image.view, nullptr);
+    vkDestroyImage(deviceObj->device, image.image, nullptr);
+    vkFreeMemory(deviceObj->device, image.mem, nullptr);
+    memset(&image, 0, sizeof(image));
+}
+
+void VulkanPostProcess::createBuffer(Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage,
+                                     VkMemoryPropertyFlags properties) {
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.pNext = nullptr;
+    bufInfo.usage = usage;
+    bufInfo.size = size;
+    bufInfo.queueFamilyIndexCount = 0;
+    bufInfo.pQueueFamilyIndices = nullptr;
+    bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufInfo.flags = 0;
+    VkResult result = vkCreateBuffer(deviceObj->device, &bufInfo, nullptr, &buffer.buf);
+    assert(result == VK_SUCCESS);
+
+    VkMemoryRequirements memRqrmnt;
+    vkGetBufferMemoryRequirements(deviceObj->device, buffer.buf, &memRqrmnt);
+
+    VkMemoryAllocateInfo memAlloc = {};
+    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAlloc.pNext = nullptr;
+    memAlloc.allocationSize = memRqrmnt.size;
+    memAlloc.memoryTypeIndex = 0;
+    bool pass = deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits, properties, &memAlloc.memoryTypeIndex);
+    assert(pass);
+    result = vkAllocateMemory(deviceObj->device, &memAlloc, nullptr, &buffer.mem);
+    assert(result == VK_SUCCESS);
+    result = vkBindBufferMemory(deviceObj->device, buffer.buf, buffer.mem, 0);
+    assert(result == VK_SUCCESS);
+
+    // Host visible buffers stay mapped
+    buffer.mapped = nullptr;
+    if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        result = vkMapMemory(deviceObj->device, buffer.mem, 0, VK_WHOLE_SIZE, 0, &buffer.mapped);
+        assert(result == VK_SUCCESS);
+    }
+}
+
+void VulkanPostProcess::destroyBuffer(Buffer &buffer) {
+    if (buffer.buf == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyBuffer(deviceObj->device, buffer.buf, nullptr);
+    vkFreeMemory(deviceObj->device, buffer.mem, nullptr);
+    memset(&buffer, 0, sizeof(buffer));
+}
+
+void VulkanPostProcess::createDescriptors() {
+    VkDescriptorPoolSize poolSizes[3];
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = 2 * FRAMES_IN_FLIGHT + 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = FRAMES_IN_FLIGHT + 1;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = FRAMES_IN_FLIGHT;
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.pNext = nullptr;
+    descriptorPoolInfo.flags = 0;
+    descriptorPoolInfo.maxSets = 2 * FRAMES_IN_FLIGHT + 1;
+    descriptorPoolInfo.poolSizeCount = 3;
+    descriptorPoolInfo.pPoolSizes = poolSizes;
+    VkResult result = vkCreateDescriptorPool(deviceObj->device, &descriptorPoolInfo, nullptr, &descriptorPool);
+    assert(result == VK_SUCCESS);
+
+    VkDescriptorSetLayout imageLayouts[FRAMES_IN_FLIGHT];
+    std::fill(imageLayouts, imageLayouts + FRAMES_IN_FLIGHT, imageSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = FRAMES_IN_FLIGHT;
+    allocInfo.pSetLayouts = imageLayouts;
+    result = vkAllocateDescriptorSets(deviceObj->device, &allocInfo, tonemapSets);
+    assert(result == VK_SUCCESS);
+    allocInfo.descriptorSetCount = 1;
+    result = vkAllocateDescriptorSets(deviceObj->device, &allocInfo, &fxaaSet);
+    assert(result == VK_SUCCESS);
+
+    VkDescriptorSetLayout readbackLayouts[FRAMES_IN_FLIGHT];
+    std::fill(readbackLayouts, readbackLayouts + FRAMES_IN_FLIGHT, readbackSetLayout);
+    allocInfo.descriptorSetCount = FRAMES_IN_FLIGHT;
+    allocInfo.pSetLayouts = readbackLayouts;
+    result = vkAllocateDescriptorSets(deviceObj->device, &allocInfo, downsampleSets);
+    assert(result == VK_SUCCESS);
+
+    // Each step samples the image the previous one wrote, in the read only layout, and writes
+    // its own in the general layout
+    VkDescriptorImageInfo inputInfos[FRAMES_IN_FLIGHT];
+    VkDescriptorImageInfo tonemappedRead = {sampler, tonemapped.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkDescriptorImageInfo tonemappedWrite = {VK_NULL_HANDLE, tonemapped.view, VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo filteredRead = {sampler, filtered.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkDescriptorImageInfo filteredWrite = {VK_NULL_HANDLE, filtered.view, VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorBufferInfo readbackInfos[FRAMES_IN_FLIGHT];
+
+    std::vector<VkWriteDescriptorSet> writes;
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.pNext = nullptr;
+    write.descriptorCount = 1;
+    write.dstArrayElement = 0;
+    for (uint32_t slot = 0; slot < FRAMES_IN_FLIGHT; slot++) {
+        inputInfos[slot] = {sampler, inputImages[slot].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        readbackInfos[slot] = {readbackBuffers[slot].buf, 0, VK_WHOLE_SIZE};
+
+        write.dstSet = tonemapSets[slot];
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &inputInfos[slot];
+        write.pBufferInfo = nullptr;
+        writes.push_back(write);
+        write.dstBinding = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write.pImageInfo = &tonemappedWrite;
+        writes.push_back(write);
+
+        write.dstSet = downsampleSets[slot];
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &filteredRead;
+        writes.push_back(write);
+        write.dstBinding = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pImageInfo = nullptr;
+        write.pBufferInfo = &readbackInfos[slot];
+        writes.push_back(write);
+    }
+    write.dstSet = fxaaSet;
+    write.dstBinding = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &tonemappedRead;
+    write.pBufferInfo = nullptr;
+    writes.push_back(write);
+    write.dstBinding = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &filteredWrite;
+    writes.push_back(write);
+    vkUpdateDescriptorSets(deviceObj->device, (uint32_t) writes.size(), writes.data(), 0, nullptr);
+}
+
+void VulkanPostProcess::recordChain(uint32_t frameSlot) {
+    VkCommandBuffer cmd = cmdChains[frameSlot];
+    CommandBufferMgr::beginCommandBuffer(cmd);
+
+    VkImageSubresourceRange range = {};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    VkImageMemoryBarrier2 barriers[2] = {};
+    for (auto &barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.pNext = nullptr;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = range;
+    }
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = nullptr;
+    dependencyInfo.pImageMemoryBarriers = barriers;
+
+    // The previous chain's filter read the tone mapped image, it is written again from scratch.
+    // The copy's queue made the input visible through the semaphore, another family must acquire it.
+    uint32_t barrierCount = 0;
+    VkImageMemoryBarrier2 &tonemappedBarrier = barriers[barrierCount++];
+    tonemappedBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    tonemappedBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+    tonemappedBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    tonemappedBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    tonemappedBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    tonemappedBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    tonemappedBarrier.image = tonemapped.image;
+    if (computeFamily != graphicsFamily) {
+        VkImageMemoryBarrier2 &acquireBarrier = barriers[barrierCount++];
+        acquireBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        acquireBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        acquireBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        acquireBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        acquireBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        acquireBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        acquireBarrier.srcQueueFamilyIndex = graphicsFamily;
+        acquireBarrier.dstQueueFamilyIndex = computeFamily;
+        acquireBarrier.image = inputImages[frameSlot].image;
+    }
+    dependencyInfo.imageMemoryBarrierCount = barrierCount;
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    PostPushConstants pushConstants = {};
+    pushConstants.size[0] = (int32_t) width;
+    pushConstants.size[1] = (int32_t) height;
+    pushConstants.exposure = POST_EXPOSURE;
+    pushConstants.decodeSource = isSrgbFormat(format) ? 0 : 1;
+    uint32_t groupsX = (width + POST_GROUP_SIZE - 1) / POST_GROUP_SIZE;
+    uint32_t groupsY = (height + POST_GROUP_SIZE - 1) / POST_GROUP_SIZE;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, tonemapPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, imageLayout, 0, 1, &tonemapSets[frameSlot], 0,
+                            nullptr);
+    vkCmdPushConstants(cmd, imageLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(cmd, groupsX, groupsY, 1);
+
+    // The filter samples the tone mapped image and writes the filtered one, which the previous
+    // chain's downsampling read
+    barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barriers[0].srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].image = tonemapped.image;
+    barriers[1].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barriers[1].srcAccessMask = VK_ACCESS_2_NONE;
+    barriers[1].dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].image = filtered.image;
+    dependencyInfo.imageMemoryBarrierCount = 2;
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, fxaaPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, imageLayout, 0, 1, &fxaaSet, 0, nullptr);
+    vkCmdPushConstants(cmd, imageLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(cmd, groupsX, groupsY, 1);
+
+    // The downsampling samples the filtered image. The readback was read by the CPU before the
+    // chain was submitted, it needs no barrier before being written.
+    barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barriers[0].srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].image = filtered.image;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    pushConstants.size[0] = (int32_t) readbackWidth;
+    pushConstants.size[1] = (int32_t) readbackHeight;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, readbackLayout, 0, 1, &downsampleSets[frameSlot],
+                            0, nullptr);
+    vkCmdPushConstants(cmd, readbackLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(cmd, (readbackWidth + POST_GROUP_SIZE - 1) / POST_GROUP_SIZE,
+                  (readbackHeight + POST_GROUP_SIZE - 1) / POST_GROUP_SIZE, 1);
+
+    // The CPU reads the readback once the timeline reaches the chain's value
+    VkMemoryBarrier2 memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    dependencyInfo.imageMemoryBarrierCount = 0;
+    dependencyInfo.pImageMemoryBarriers = nullptr;
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    CommandBufferMgr::endCommandBuffer(cmd);
+}
+
+void VulkanPostProcess::destroy() {
+    if (deviceObj == nullptr) {
+        return;
+    }
+    VkDevice device = deviceObj->device;
+    if (cmdPool != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(device, cmdPool, FRAMES_IN_FLIGHT, cmdChains);
+        vkDestroyCommandPool(device, cmdPool, nullptr);
+    }
+    vkDestroyPipeline(device, tonemapPipeline, nullptr);
+    vkDestroyPipeline(device, fxaaPipeline, nullptr);
+    vkDestroyPipeline(device, downsamplePipeline, nullptr);
+    vkDestroyPipelineLayout(device, imageLayout, nullptr);
+    vkDestroyPipelineLayout(device, readbackLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, imageSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, readbackSetLayout, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    for (auto &inputImage : inputImages) {
+        destroyImage(inputImage);
+    }
+    destroyImage(tonemapped);
+    destroyImage(filtered);
+    for (auto &readbackBuffer : readbackBuffers) {
+        destroyBuffer(readbackBuffer);
+    }
+
+    cmdPool = VK_NULL_HANDLE;
+    memset(cmdChains, 0, sizeof(cmdChains));
+    tonemapPipeline = fxaaPipeline = downsamplePipeline = VK_NULL_HANDLE;
+    imageLayout = readbackLayout = VK_NULL_HANDLE;
+    imageSetLayout = readbackSetLayout = VK_NULL_HANDLE;
+    descriptorPool = VK_NULL_HANDLE;
+    sampler = VK_NULL_HANDLE;
+    timeline = nullptr;
+    deviceObj = nullptr;
+}
+
+void VulkanPostProcess::beginFrame(uint32_t frameSlot) {
+    uint64_t value = slotValues[frameSlot];
+    if (value == 0) {
+        return;
+    }
+
+    // The chain normally completed while the graphics queue rendered the frames in between
+    if (!timeline->isComplete(value)) {
+        stalledFrames++;
+        timeline->wait(value);
+    }
+
+    // Rec. 601 luma of the downsampled frame, as the filter computes it
+    auto *pixels = (const uint8_t *) readbackBuffers[frameSlot].mapped;
+    uint32_t pixelCount = readbackWidth * readbackHeight;
+    double luminance = 0.0;
+    for (uint32_t pixel = 0; pixel < pixelCount; pixel++) {
+        const uint8_t *rgba = pixels + pixel * 4;
+        luminance += 0.299 * rgba[0] + 0.587 * rgba[1] + 0.114 * rgba[2];
+    }
+    lastLuminance = (float) (luminance / (255.0 * std::max(1u, pixelCount)));
+    processedFrames++;
+    slotValues[frameSlot] = 0;
+}
+
+void VulkanPostProcess::recordCopy(VkCommandBuffer cmd, uint32_t frameSlot, VkImage frameImage) {
+    // beginFrame() waited for the chain which read the input, its content is discarded
+    VkImageMemoryBarrier2 imgMemoryBarrier = {};
+    imgMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    imgMemoryBarrier.pNext = nullptr;
+    imgMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    imgMemoryBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+    imgMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    imgMemoryBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    imgMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imgMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imgMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imgMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imgMemoryBarrier.image = inputImages[frameSlot].image;
+    imgMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imgMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imgMemoryBarrier.subresourceRange.levelCount = 1;
+    imgMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imgMemoryBarrier.subresourceRange.layerCount = 1;
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = nullptr;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &imgMemoryBarrier;
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+    VkImageCopy region = {};
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.mipLevel = 0;
+    region.srcSubresource.baseArrayLayer = 0;
+    region.srcSubresource.layerCount = 1;
+    region.srcOffset = {0, 0, 0};
+    region.dstSubresource = region.srcSubresource;
+    region.dstOffset = {0, 0, 0};
+    region.extent = {width, height, 1};
+    vkCmdCopyImage(cmd, frameImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, inputImages[frameSlot].image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // The semaphore the chain waits on makes the copy visible, the barrier only moves the image
+    // to the layout the chain samples it in. With another family it is the release half of the
+    // ownership transfer, recordChain() records the acquire.
+    imgMemoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    imgMemoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    imgMemoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    imgMemoryBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+    imgMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imgMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    if (computeFamily != graphicsFamily) {
+        imgMemoryBarrier.srcQueueFamilyIndex = graphicsFamily;
+        imgMemoryBarrier.dstQueueFamilyIndex = computeFamily;
+    }
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+void VulkanPostProcess::submit(uint32_t frameSlot, const TimelinePoint &frameComplete) {
+    // Only the chain waits for the frame, the graphics queue goes on with the next one
+    std::vector<TimelineWait> waits = {
+            {frameComplete.semaphore, frameComplete.value, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT},
+    };
+    slotValues[frameSlot] = timeline->submit(&cmdChains[frameSlot], 1, waits);
+}
+
+void VulkanPostProcess::printStatistics() {
+    std::cout << "\n\nPost-processing statistics:\n";
+    std::cout << "\t|---[Readback extent]--> " << readbackWidth << "x" << readbackHeight << "\n";
+    std::cout << "\t|---[Frames processed]--> " << processedFrames << "\n";
+    std::cout << "\t|---[Frames waited for]--> " << stalledFrames << "\n";
+    std::cout << "\t|---[Last average luminance]--> " << lastLuminance << std::endl;
+}
@@ -0,0 +1,567 @@
+#include "VulkanRenderGraph.h"
+#include "VulkanDevice.h"
+
+// Accesses which have to be made available before another access of the image
+#define RENDER_GRAPH_WRITE_ACCESS (VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | \
+                                   VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | \
+                                   VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT)
+
+namespace {
+    struct UsageScope {
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        VkImageUsageFlags imageUsage;
+        bool write;
+    };
+
+    UsageScope getUsageScope(ResourceUsage usage) {
+        const VkPipelineStageFlags2 depthStages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                                                  VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+        switch (usage) {
+            case RESOURCE_USAGE_COLOR_ATTACHMENT:
+                return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true};
+            case RESOURCE_USAGE_RESOLVE_ATTACHMENT:
+                // Resolve happens at the end of the pass in the color output stage
+                return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true};
+            case RESOURCE_USAGE_DEPTH_ATTACHMENT:
+                return {depthStages,
+                        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                        true};
+            case RESOURCE_USAGE_DEPTH_READ:
+                return {depthStages, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                        false};
+            case RESOURCE_USAGE_SAMPLED:
+                return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_IMAGE_USAGE_SAMPLED_BIT, false};
+            case RESOURCE_USAGE_STORAGE_READ:
+                return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false};
+            case RESOURCE_USAGE_STORAGE_WRITE:
+                return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true};
+            case RESOURCE_USAGE_TRANSFER_SRC:
+                return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false};
+            case RESOURCE_USAGE_TRANSFER_DST:
+                return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true};
+            case RESOURCE_USAGE_PRESENT:
+            default:
+                // The present waits on a semaphore, the barrier only has to order the transition
+                return {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, false};
+        }
+    }
+
+    // Bytes per sample of the attachment formats, used for the traffic estimate
+    VkDeviceSize getFormatSize(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+                return 2;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+                return 3;
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return 5;
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                return 8;
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+                return 16;
+            default:
+                // 8 bit RGBA, 10 bit RGB, 24 and 32 bit depth
+                return 4;
+        }
+    }
+
+    VkImageAspectFlags getFormatAspect(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            default:
+                return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+}
+
+VulkanRenderGraph::VulkanRenderGraph() {
+    deviceObj = nullptr;
+    unaliasedSize = 0;
+    compiled = false;
+    frameLoadBytes = frameStoreBytes = frameWorstBytes = 0;
+    loadedBytes = storedBytes = worstBytes = 0;
+    executedFrames = 0;
+}
+
+VulkanRenderGraph::~VulkanRenderGraph() = default;
+
+void VulkanRenderGraph::initialize(VulkanDevice *device) {
+    deviceObj = device;
+}
+
+RenderGraphResource VulkanRenderGraph::createImage(const std::string &name, VkFormat format, uint32_t width,
+                                                   uint32_t height, VkSampleCountFlagBits samples, uint32_t layers) {
+    assert(!compiled);
+    Resource resource = {};
+    resource.name = name;
+    resource.imported = false;
+    resource.format = format;
+    resource.width = width;
+    resource.height = height;
+    resource.layers = layers;
+    resource.samples = samples;
+    resource.aspectMask = getFormatAspect(format);
+    resource.usage = 0;
+    resource.lazilyAllocated = false;
+    resource.image = VK_NULL_HANDLE;
+    resource.view = VK_NULL_HANDLE;
+    resources.push_back(resource);
+    return (RenderGraphResource) (resources.size() - 1);
+}
+
+RenderGraphResource VulkanRenderGraph::importImage(const std::string &name, VkFormat format, uint32_t width,
+                                                   uint32_t height, VkImageLayout initialLayout,
+                                                   VkPipelineStageFlags2 initialStages, ResourceUsage finalUsage) {
+    assert(!compiled);
+    Resource resource = {};
+    resource.name = name;
+    resource.imported = true;
+    resource.format = format;
+    resource.width = width;
+    resource.height = height;
+    resource.layers = 1;
+    resource.samples = VK_SAMPLE_COUNT_1_BIT;
+    resource.aspectMask = getFormatAspect(format);
+    resource.lazilyAllocated = false;
+    resource.initialState = {initialLayout, 0, 0, initialStages, 0, 0};
+    resource.finalUsage = finalUsage;
+    resource.image = VK_NULL_HANDLE;
+    resource.view = VK_NULL_HANDLE;
+    resources.push_back(resource);
+    return (RenderGraphResource) (resources.size() - 1);
+}
+
+void VulkanRenderGraph::setImportedImage(RenderGraphResource resource, VkImage image, VkImageView view) {
+    assert(resources[resource].imported);
+    resources[resource].image = image;
+    resources[resource].view = view;
+}
+
+uint32_t VulkanRenderGraph::addPass(const std::string &name, std::function<void(VkCommandBuffer)> record) {
+    assert(!compiled);
+    Pass pass;
+    pass.name = name;
+    pass.record = std::move(record);
+    passes.push_back(std::move(pass));
+    return (uint32_t) (passes.size() - 1);
+}
+
+void VulkanRenderGraph::use(uint32_t pass, RenderGraphResource resource, ResourceUsage usage) {
+    assert(!compiled);
+    assert(usage != RESOURCE_USAGE_PRESENT);
+    for (auto &passUse : passes[pass].uses) {
+        assert(passUse.resource != resource);
+    }
+    passes[pass].uses.push_back(PassUse{resource, usage});
+    resources[resource].usage |= getUsageScope(usage).imageUsage;
+}
+
+void VulkanRenderGraph::compile() {
+    assert(deviceObj != nullptr && !compiled);
+
+    // Lifetime of each image, in pass indices
+    for (auto &resource : resources) {
+        resource.firstPass = UINT32_MAX;
+        resource.lastPass = 0;
+    }
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        for (auto &passUse : passes[i].uses) {
+            Resource &resource = resources[passUse.resource];
+            resource.firstPass = std::min(resource.firstPass, i);
+            resource.lastPass = std::max(resource.lastPass, i);
+        }
+    }
+
+    createTransientImages();
+    planBarriers();
+    compiled = true;
+    estimateAttachmentTraffic();
+}
+
+bool VulkanRenderGraph::isUsedAfter(RenderGraphResource resource, uint32_t pass) {
+    assert(compiled);
+    return resources[resource].imported || resources[resource].lastPass > pass;
+}
+
+AttachmentOps VulkanRenderGraph::getAttachmentOps(uint32_t pass, RenderGraphResource resource, bool clear) {
+    assert(compiled);
+    const Resource &image = resources[resource];
+    bool defined = image.imported ? image.initialState.layout != VK_IMAGE_LAYOUT_UNDEFINED || image.firstPass < pass
+                                  : image.firstPass < pass;
+
+    bool resolve = false;
+    for (auto &passUse : passes[pass].uses) {
+        resolve |= passUse.resource == resource && passUse.usage == RESOURCE_USAGE_RESOLVE_ATTACHMENT;
+    }
+
+    AttachmentOps ops;
+    if (resolve) {
+        ops.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    } else {
+        ops.loadOp = defined ? VK_ATTACHMENT_LOAD_OP_LOAD
+                             : (clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+    }
+    ops.storeOp = isUsedAfter(resource, pass) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    // Formats without stencil have nothing to load or store there
+    if (image.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) {
+        ops.stencilLoadOp = ops.loadOp;
+        ops.stencilStoreOp = ops.storeOp;
+    } else {
+        ops.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        ops.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+    return ops;
+}
+
+void VulkanRenderGraph::estimateAttachmentTraffic() {
+    frameLoadBytes = frameStoreBytes = frameWorstBytes = 0;
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        for (auto &passUse : passes[i].uses) {
+            if (passUse.usage != RESOURCE_USAGE_COLOR_ATTACHMENT && passUse.usage != RESOURCE_USAGE_RESOLVE_ATTACHMENT &&
+                passUse.usage != RESOURCE_USAGE_DEPTH_ATTACHMENT && passUse.usage != RESOURCE_USAGE_DEPTH_READ) {
+                continue;
+            }
+            const Resource &resource = resources[passUse.resource];
+            VkDeviceSize size = (VkDeviceSize) resource.width * resource.height * resource.layers *
+                                resource.samples * getFormatSize(resource.format);
+            AttachmentOps ops = getAttachmentOps(i, passUse.resource);
+            if (ops.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+                frameLoadBytes += size;
+            }
+            if (ops.storeOp == VK_ATTACHMENT_STORE_OP_STORE) {
+                frameStoreBytes += size;
+            }
+            frameWorstBytes += 2 * size;
+        }
+    }
+}
+
+void VulkanRenderGraph::createTransientImages() {
+    // Visit the images in the order they come to life, an image takes over the memory of one
+    // whose last pass ran before its first pass. Offset 0 of a block is aligned for any image.
+    std::vector<RenderGraphResource> order;
+    for (RenderGraphResource i = 0; i < resources.size(); i++) {
+        if (!resources[i].imported && resources[i].firstPass != UINT32_MAX) {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](RenderGraphResource a, RenderGraphResource b) {
+        return resources[a].firstPass < resources[b].firstPass;
+    });
+
+    // Attachments of a single pass never leave the tile memory of tiled GPUs, they do not need
+    // physical memory when the device can commit it lazily
+    const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                              VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    bool lazyMemory = false;
+    for (uint32_t i = 0; i < deviceObj->memoryProps.memoryTypeCount; i++) {
+        lazyMemory |= (deviceObj->memoryProps.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+    }
+
+    for (RenderGraphResource index : order) {
+        Resource &resource = resources[index];
+        resource.lazilyAllocated = lazyMemory && resource.firstPass == resource.lastPass &&
+                                   (resource.usage & ~attachmentUsage) == 0;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.pNext = nullptr;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = resource.format;
+        imageInfo.extent.width = resource.width;
+        imageInfo.extent.height = resource.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = resource.layers;
+        imageInfo.samples = resource.samples;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.queueFamilyIndexCount = 0;
+        imageInfo.pQueueFamilyIndices = nullptr;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.usage = resource.usage | (resource.lazilyAllocated ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.flags = 0;
+
+        VkResult result = vkCreateImage(deviceObj->device, &imageInfo, nullptr, &resource.image);
+        assert(result == VK_SUCCESS);
+
+        VkMemoryRequirements memRqrmnt;
+        vkGetImageMemoryRequirements(deviceObj->device, resource.image, &memRqrmnt);
+        unaliasedSize += memRqrmnt.size;
+
+        // The lazy type may still be missing from the types of this image
+        uint32_t typeIndex;
+        resource.lazilyAllocated = resource.lazilyAllocated &&
+                                   deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits,
+                                                                       VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                                                                       &typeIndex);
+
+        resource.memoryBlock = UINT32_MAX;
+        for (uint32_t i = 0; i < memoryBlocks.size(); i++) {
+            MemoryBlock &block = memoryBlocks[i];
+            if (block.lastPass < resource.firstPass && block.lazilyAllocated == resource.lazilyAllocated &&
+                (block.memoryTypeBits & memRqrmnt.memoryTypeBits)) {
+                block.size = std::max(block.size, memRqrmnt.size);
+                block.memoryTypeBits &= memRqrmnt.memoryTypeBits;
+                block.lastPass = resource.lastPass;
+                resource.memoryBlock = i;
+                break;
+            }
+        }
+        if (resource.memoryBlock == UINT32_MAX) {
+            memoryBlocks.push_back(MemoryBlock{VK_NULL_HANDLE, memRqrmnt.size, memRqrmnt.memoryTypeBits,
+                                               resource.lastPass, resource.lazilyAllocated});
+            resource.memoryBlock = (uint32_t) (memoryBlocks.size() - 1);
+        }
+    }
+
+    for (auto &block : memoryBlocks) {
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.pNext = nullptr;
+        memAlloc.allocationSize = block.size;
+        memAlloc.memoryTypeIndex = 0;
+        VkMemoryPropertyFlags properties = block.lazilyAllocated ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+                                                                 : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        bool pass = deviceObj->memoryTypeFromProperties(block.memoryTypeBits, properties, &memAlloc.memoryTypeIndex);
+        assert(pass);
+
+        VkResult result = vkAllocateMemory(deviceObj->device, &memAlloc, nullptr, &block.memory);
+        assert(result == VK_SUCCESS);
+    }
+
+    for (RenderGraphResource index : order) {
+        Resource &resource = resources[index];
+        VkResult result = vkBindImageMemory(deviceObj->device, resource.image,
+                                            memoryBlocks[resource.memoryBlock].memory, 0);
+        assert(result == VK_SUCCESS);
+
+        VkImageViewCreateInfo imgViewInfo = {};
+        imgViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imgViewInfo.pNext = nullptr;
+        imgViewInfo.image = resource.image;
+        imgViewInfo.format = resource.format;
+        imgViewInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY};
+        imgViewInfo.subresourceRange.aspectMask = resource.aspectMask;
+        imgViewInfo.subresourceRange.baseMipLevel = 0;
+        imgViewInfo.subresourceRange.levelCount = 1;
+        imgViewInfo.subresourceRange.baseArrayLayer = 0;
+        imgViewInfo.subresourceRange.layerCount = resource.layers;
+        imgViewInfo.viewType = resource.layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        imgViewInfo.flags = 0;
+
+        result = vkCreateImageView(deviceObj->device, &imgViewInfo, nullptr, &resource.view);
+        assert(result == VK_SUCCESS);
+    }
+}
+
+void VulkanRenderGraph::planBarriers() {
+    // Walk the passes tracking the last accesses of every image, a use needs a barrier when it
+    // changes the layout, writes, or reads from stages the previous write was not made visible to.
+    // Reads in the same layout share the previous barrier, a later write waits for all of them.
+    auto simulate = [this](std::vector<ResourceState> &states, bool emit) {
+        auto access = [&states](RenderGraphResource resource, ResourceUsage usage, std::vector<Barrier> *barriers) {
+            ResourceState &state = states[resource];
+            UsageScope scope = getUsageScope(usage);
+            if (state.layout != scope.layout || scope.write) {
+                if (barriers) {
+                    barriers->push_back(Barrier{resource, state.layout, scope.layout,
+                                                state.writeStages | state.readStages, scope.stages,
+                                                state.writeAccess, scope.access});
+                }
+                if (scope.write) {
+                    state = {scope.layout, scope.stages, scope.access & RENDER_GRAPH_WRITE_ACCESS, 0, 0, 0};
+                } else {
+                    state = {scope.layout, state.writeStages, state.writeAccess, scope.stages, scope.stages,
+                             scope.access};
+                }
+                return;
+            }
+            bool visible = (scope.stages & ~state.visibleStages) == 0 && (scope.access & ~state.visibleAccess) == 0;
+            if (state.writeAccess != 0 && !visible) {
+                if (barriers) {
+                    barriers->push_back(Barrier{resource, state.layout, state.layout, state.writeStages,
+                                                scope.stages, state.writeAccess, scope.access});
+                }
+                state.visibleStages |= scope.stages;
+                state.visibleAccess |= scope.access;
+            }
+            state.readStages |= scope.stages;
+        };
+
+        for (auto &pass : passes) {
+            for (auto &passUse : pass.uses) {
+                access(passUse.resource, passUse.usage, emit ? &pass.barriers : nullptr);
+            }
+        }
+        for (RenderGraphResource i = 0; i < resources.size(); i++) {
+            if (resources[i].imported) {
+                access(i, resources[i].finalUsage, emit ? &finalBarriers : nullptr);
+            }
+        }
+    };
+
+    // First walk: where the accesses of each image end in a frame
+    std::vector<ResourceState> states(resources.size());
+    for (RenderGraphResource i = 0; i < resources.size(); i++) {
+        states[i] = resources[i].imported ? resources[i].initialState
+                                          : ResourceState{VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0, 0, 0};
+    }
+    std::vector<ResourceState> endStates = states;
+    simulate(endStates, false);
+
+    // A transient image starts undefined once the previous user of its memory is done: the image
+    // before it in the block, or for the first one the last image of the block in the previous frame.
+    for (RenderGraphResource i = 0; i < resources.size(); i++) {
+        const Resource &resource = resources[i];
+        if (resource.imported || resource.firstPass == UINT32_MAX) {
+            continue;
+        }
+        int previous = -1;
+        int last = -1;
+        for (RenderGraphResource j = 0; j < resources.size(); j++) {
+            const Resource &other = resources[j];
+            if (other.imported || other.firstPass == UINT32_MAX || other.memoryBlock != resource.memoryBlock) {
+                continue;
+            }
+            if (other.lastPass < resource.firstPass && (previous < 0 || other.lastPass > resources[previous].lastPass)) {
+                previous = (int) j;
+            }
+            if (last < 0 || other.lastPass > resources[last].lastPass) {
+                last = (int) j;
+            }
+        }
+        const ResourceState &end = endStates[previous >= 0 ? previous : last];
+        states[i] = {VK_IMAGE_LAYOUT_UNDEFINED, end.writeStages, end.writeAccess, end.readStages, 0, 0};
+    }
+
+    simulate(states, true);
+}
+
+void VulkanRenderGraph::recordBarriers(VkCommandBuffer cmd, const std::vector<Barrier> &barriers) {
+    if (barriers.empty()) {
+        return;
+    }
+
+    std::vector<VkImageMemoryBarrier2> imageBarriers(barriers.size());
+    for (size_t i = 0; i < barriers.size(); i++) {
+        const Barrier &barrier = barriers[i];
+        const Resource &resource = resources[barrier.resource];
+        VkImageMemoryBarrier2 &imgMemoryBarrier = imageBarriers[i];
+        imgMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        imgMemoryBarrier.pNext = nullptr;
+        imgMemoryBarrier.srcStageMask = barrier.srcStages ? barrier.srcStages : VK_PIPELINE_STAGE_2_NONE;
+        imgMemoryBarrier.srcAccessMask = barrier.srcAccess;
+        imgMemoryBarrier.dstStageMask = barrier.dstStages;
+        imgMemoryBarrier.dstAccessMask = barrier.dstAccess;
+        imgMemoryBarrier.oldLayout = barrier.oldLayout;
+        imgMemoryBarrier.newLayout = barrier.newLayout;
+        imgMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imgMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imgMemoryBarrier.image = resource.image;
+        imgMemoryBarrier.subresourceRange.aspectMask = resource.aspectMask;
+        // Imported images may have a mip chain, e.g. the Hi-Z pyramid, it moves as a whole
+        imgMemoryBarrier.subresourceRange.baseMipLevel = 0;
+        imgMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        imgMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+        imgMemoryBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    }
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.pNext = nullptr;
+    dependencyInfo.dependencyFlags = 0;
+    dependencyInfo.imageMemoryBarrierCount = (uint32_t) imageBarriers.size();
+    dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+    deviceObj->fpCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+void VulkanRenderGraph::execute(VkCommandBuffer cmd) {
+    assert(compiled);
+    for (auto &pass : passes) {
+        recordBarriers(cmd, pass.barriers);
+        pass.record(cmd);
+    }
+    recordBarriers(cmd, finalBarriers);
+
+    loadedBytes += frameLoadBytes;
+    storedBytes += frameStoreBytes;
+    worstBytes += frameWorstBytes;
+    executedFrames++;
+}
+
+void VulkanRenderGraph::destroy() {
+    if (deviceObj == nullptr) {
+        return;
+    }
+    for (auto &resource : resources) {
+        if (!resource.imported && resource.image != VK_NULL_HANDLE) {
+            vkDestroyImageView(deviceObj->device, resource.view, nullptr);
+            vkDestroyImage(deviceObj->device, resource.image, nullptr);
+        }
+    }
+    for (auto &block : memoryBlocks) {
+        vkFreeMemory(deviceObj->device, block.memory, nullptr);
+    }
+    resources.clear();
+    passes.clear();
+    finalBarriers.clear();
+    memoryBlocks.clear();
+    unaliasedSize = 0;
+    compiled = false;
+}
+
+void VulkanRenderGraph::printStatistics() {
+    size_t barrierCount = finalBarriers.size();
+    for (auto &pass : passes) {
+        barrierCount += pass.barriers.size();
+    }
+    VkDeviceSize aliasedSize = 0;
+    VkDeviceSize lazySize = 0;
+    VkDeviceSize lazyCommitted = 0;
+    for (auto &block : memoryBlocks) {
+        aliasedSize += block.size;
+        if (block.lazilyAllocated) {
+            VkDeviceSize committed = 0;
+            vkGetDeviceMemoryCommitment(deviceObj->device, block.memory, &committed);
+            lazySize += block.size;
+            lazyCommitted += committed;
+        }
+    }
+    uint64_t frames = std::max<uint64_t>(executedFrames, 1);
+
+    std::cout << "\n\nRender graph statistics:\n";
+    std::cout << "\t|---[Passes]--> " << passes.size() << "\n";
+    std::cout << "\t|---[Barriers per frame]--> " << barrierCount << "\n";
+    std::cout << "\t|---[Transient memory blocks]--> " << memoryBlocks.size() << "\n";
+    std::cout << "\t|---[Transient memory]--> " << aliasedSize / 1024 << " KB ("
+              << unaliasedSize / 1024 << " KB without aliasing)\n";
+    std::cout << "\t|---[Lazily allocated memory]--> " << lazySize / 1024 << " KB ("
+              << lazyCommitted / 1024 << " KB committed)\n";
+    std::cout << "\t|---[Attachment traffic per frame]--> " << loadedBytes / frames / 1024 << " KB loaded, "
+              << storedBytes / frames / 1024 << " KB stored (" << worstBytes / frames / 1024
+              << " KB loading and storing every attachment)" << std::endl;
+}
@@ -2,6 +2,7 @@
 #include "VulkanApplication.h"
 #include "Wrappers.h"
 #include "MeshData.h"
+#include "ShaderRegistry.h"
 
 
 VulkanRenderer::VulkanRenderer(VulkanApplication *app, VulkanDevice *deviceObject) {
@@ -13,9 +14,38 @@ VulkanRenderer::VulkanRenderer(VulkanApplication *app, VulkanDevice *deviceObjec
 
     application = app;
     deviceObj = deviceObject;
+    frameIndex = 0;
+    memset(frameValues, 0, sizeof(frameValues));
+    useBindless = false;
+    useDynamicRendering = false;
+    sampleCount = NUM_SAMPLES;
+    viewCount = 1;
+    useDepthPrePass = false;
+    useHiZCulling = false;
+    useAsyncPostProcess = false;
+    useResolutionScaling = false;
+    prePassRenderPass = VK_NULL_HANDLE;
+    prePassFrameBuffer = VK_NULL_HANDLE;
+    renderPass = VK_NULL_HANDLE;
+    memset(&sceneRenderingInfo, 0, sizeof(sceneRenderingInfo));
+    memset(&sceneInheritanceInfo, 0, sizeof(sceneInheritanceInfo));
+    transformMode = TRANSFORM_UNIFORM_BUFFER;
+    reloadStages[0] = reloadStages[1] = false;
     swapChainObj = new VulkanSwapChain(this);
     auto *drawableObj = new VulkanDrawable(this);
+    drawableObj->objectIndex = (uint32_t) drawableList.size();
     drawableList.push_back(drawableObj);
+
+    // One acquire semaphore per frame in flight, a slot is reused once the frame which waited on
+    // its semaphore has completed. The drawing complete semaphores are per swap chain image.
+    VkSemaphoreCreateInfo presentCompleteSemaphoreCreateInfo = {};
+    presentCompleteSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    presentCompleteSemaphoreCreateInfo.pNext = nullptr;
+    presentCompleteSemaphoreCreateInfo.flags = 0;
+
+    for (auto &semaphore : presentCompleteSemaphores) {
+        vkCreateSemaphore(deviceObj->device, &presentCompleteSemaphoreCreateInfo, nullptr, &semaphore);
+    }
 }
 
 VulkanRenderer::~VulkanRenderer() {
@@ -28,36 +58,111 @@ VulkanRenderer::~VulkanRenderer() {
 }
 
 void VulkanRenderer::initialize() {
+    StartupTimer &timer = application->startupTimer;
+
+    // The queues and their timelines are used by the workers below
+    deviceObj->getDeviceQueue();
+
+    // The vertex data goes through the transfer queue
+    uploadManager.initialize(deviceObj);
+    deletionQueue.initialize(deviceObj);
+
+    // The render graph passes allocate their per frame sets from it, whatever the drawables use
+    descriptorAllocator.initialize(deviceObj);
+
+    // The shaders, the geometry and the pipeline cache depend on nothing but the device, they
+    // are loaded on worker threads while this thread builds the swap chain and the render pass.
+    std::future<void> shadersReady = std::async(std::launch::async, [this, &timer]() {
+        StartupPhase phase(timer, "Load shaders");
+        createShaders();
+    });
+    std::future<void> geometryReady = std::async(std::launch::async, [this, &timer]() {
+        StartupPhase phase(timer, "Upload geometry");
+        createVertexBuffer();
+    });
+    std::future<void> pipelineCacheReady;
+    if (!application->isResizing) {
+        pipelineCacheReady = std::async(std::launch::async, [this, &timer]() {
+            StartupPhase phase(timer, "Load pipeline cache");
+            pipelineObj.loadPipelineCacheData();
+        });
+    }
+
+    {
+        StartupPhase phase(timer, "Swap chain and depth");
 
-    // We need command buffers, so create a command buffer pool
-    createCommandPool();
+        // We need command buffers, so create a command buffer pool
+        createCommandPool();
 
-    // Let's create the swap chain color images and depth image
-    buildSwapChainAndDepthImage();
+        // The setup commands of all the resources are recorded in one batch, submitted once at the end
+        initBatch.begin(deviceObj, cmdPool);
 
-    // Build the vertex buffer
-    createVertexBuffer();
+        // Let's create the swap chain color images and depth image
+        buildSwapChainAndDepthImage();
+    }
 
-    // Create the render pass now..
-    createRenderPass(includeDepth);
+    // Dynamic rendering begins the scene pass with its attachments, no object is needed
+    if (!useDynamicRendering) {
+        StartupPhase phase(timer, "Render pass");
 
-    // Use render pass and create frame buffer
-    createFrameBuffer(includeDepth);
+        // Create the render pass now..
+        createRenderPass(includeDepth);
 
-    // Create the vertex and fragment shader
-    createShaders();
+        // Use render pass and create frame buffer
+        createFrameBuffer(includeDepth);
+    }
 
-    // Create descriptor set layout
-    createDescriptors();
+    // The descriptor set layouts are reflected from the shaders
+    shadersReady.get();
+    {
+        StartupPhase phase(timer, "Descriptors");
+
+        // Create descriptor set layout
+        createDescriptors();
+    }
+
+    // The pipelines need the vertex input layout and the previous pipeline cache. The copies
+    // run on the transfer queue while the pipelines compile, the setup batch acquires them.
+    geometryReady.get();
+    VkPipelineStageFlags uploadWaitStage = 0;
+    TimelinePoint uploadPoint = uploadManager.recordAcquireBarriers(initBatch.getCommandBuffer(), &uploadWaitStage);
+    if (uploadPoint.semaphore != VK_NULL_HANDLE) {
+        initBatch.addWait(uploadPoint, uploadWaitStage);
+    }
+    if (pipelineCacheReady.valid()) {
+        pipelineCacheReady.get();
+    }
+    {
+        StartupPhase phase(timer, "Pipelines");
 
-    // Manage the pipeline state objects
-    createPipelineStateManagement();
+        // Manage the pipeline state objects
+        createPipelineStateManagement();
+    }
 
-    // Build the push constants
-    createPushConstants();
+    {
+        StartupPhase phase(timer, "Submit setup commands");
+        initBatch.flush();
+        uploadManager.finish();
+    }
 }
 
 void VulkanRenderer::prepare() {
+    // The swap chain may come back with another image count after a resize
+    size_t imageCount = swapChainObj->scPublicVars.colorBuffer.size();
+    if (drawingCompleteSemaphores.size() != imageCount) {
+        for (auto &semaphore : drawingCompleteSemaphores) {
+            vkDestroySemaphore(deviceObj->device, semaphore, nullptr);
+        }
+        VkSemaphoreCreateInfo drawingCompleteSemaphoreCreateInfo = {};
+        drawingCompleteSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        drawingCompleteSemaphoreCreateInfo.pNext = nullptr;
+        drawingCompleteSemaphoreCreateInfo.flags = 0;
+        drawingCompleteSemaphores.resize(imageCount);
+        for (auto &semaphore : drawingCompleteSemaphores) {
+            vkCreateSemaphore(deviceObj->device, &drawingCompleteSemaphoreCreateInfo, nullptr, &semaphore);
+        }
+    }
+
     for (auto drawableObj : drawableList) {
         drawableObj->prepare();
     }
@@ -69,6 +174,559 @@ void VulkanRenderer::update() {
     }
 }
 
+void VulkanRenderer::enableBindless(bool enable) {
+    if (enable && !deviceObj->descriptorIndexingSupported) {
+        std::cout << "Descriptor indexing is not supported, bindless mode disabled\n";
+        enable = false;
+    }
+    if (enable && viewCount > 1) {
+        std::cout << "The views read their transforms from a uniform buffer, bindless mode disabled\n";
+        enable = false;
+    }
+    if (enable && !isShaderAvailable("DrawBindless.vert")) {
+        std::cout << "DrawBindless.vert is not embedded in the binary, bindless mode disabled\n";
+        enable = false;
+    }
+    useBindless = enable;
+}
+
+void VulkanRenderer::enableDynamicRendering(bool enable) {
+    if (enable && !deviceObj->dynamicRenderingSupported) {
+        std::cout << "Dynamic rendering is not supported, render pass mode used\n";
+        enable = false;
+    }
+    useDynamicRendering = enable;
+}
+
+void VulkanRenderer::enableDepthPrePass(bool enable) {
+    // The pre-pass only makes sense with a depth buffer
+    useDepthPrePass = enable && includeDepth;
+}
+
+void VulkanRenderer::enableHiZCulling(bool enable) {
+    // The pyramid levels are rg32f storage images
+    if (enable && !deviceObj->storageImageExtendedFormatsSupported) {
+        std::cout << "Two channel storage images are not supported, Hi-Z culling disabled\n";
+        enable = false;
+    }
+    useHiZCulling = enable && includeDepth;
+}
+
+void VulkanRenderer::enableAsyncPostProcess(bool enable) {
+    // The swap chain usage is only known once it is created, createRenderGraph() checks it
+    useAsyncPostProcess = enable;
+}
+
+void VulkanRenderer::setResolutionScaling(float minScale, float maxScale, float budgetMs) {
+    // The scene passes are timed on the queue which renders them
+    VkQueueFamilyProperties &family = deviceObj->queueFamilyProps[deviceObj->graphicsQueueWithPresentIndex];
+    if (family.timestampValidBits == 0) {
+        std::cout << "The graphics queue has no timestamps, dynamic resolution disabled\n";
+        useResolutionScaling = false;
+        return;
+    }
+
+    // The scene is upscaled into the swap chain image with a blit
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(*deviceObj->gpu, swapChainObj->scPublicVars.format, &props);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if ((props.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+        std::cout << "The swap chain format cannot be blitted, dynamic resolution disabled\n";
+        useResolutionScaling = false;
+        return;
+    }
+    resolutionScaler.setBudget(minScale, maxScale, budgetMs);
+    useResolutionScaling = true;
+}
+
+VkExtent2D VulkanRenderer::getRenderExtent() {
+    if (useResolutionScaling) {
+        return resolutionScaler.getRenderExtent((uint32_t) width, (uint32_t) height);
+    }
+    return VkExtent2D{(uint32_t) width, (uint32_t) height};
+}
+
+void VulkanRenderer::setSampleCount(VkSampleCountFlagBits samples) {
+    // Both the color and the depth attachments are multisampled
+    VkSampleCountFlags supported = deviceObj->gpuProps.limits.framebufferColorSampleCounts &
+                                   deviceObj->gpuProps.limits.framebufferDepthSampleCounts;
+    VkSampleCountFlagBits selected = VK_SAMPLE_COUNT_1_BIT;
+    for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > VK_SAMPLE_COUNT_1_BIT; count >>= 1) {
+        if (count <= (uint32_t) samples && (supported & count)) {
+            selected = (VkSampleCountFlagBits) count;
+            break;
+        }
+    }
+    if (selected != samples) {
+        printf("%d samples are not supported, using %d\n", samples, selected);
+    }
+    sampleCount = selected;
+}
+
+void VulkanRenderer::setViewCount(uint32_t views) {
+    uint32_t maxViews = std::min<uint32_t>(MAX_VIEW_COUNT, deviceObj->maxMultiviewViewCount);
+    if (views > 1 && !deviceObj->multiviewSupported) {
+        std::cout << "Multiview is not supported, rendering a single view\n";
+        views = 1;
+    }
+
+    // The views are blitted into the swap chain image
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(*deviceObj->gpu, swapChainObj->scPublicVars.format, &props);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if (views > 1 && (props.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+        std::cout << "The swap chain format cannot be blitted, rendering a single view\n";
+        views = 1;
+    }
+    if (views > 1 && !isShaderAvailable("DrawMultiview.vert")) {
+        std::cout << "DrawMultiview.vert is not embedded in the binary, rendering a single view\n";
+        views = 1;
+    }
+    if (views > maxViews) {
+        printf("%d views are not supported, using %d\n", views, maxViews);
+        views = maxViews;
+    }
+    viewCount = std::max(1u, views);
+
+    // Each view has its transform in the drawable's uniform buffer
+    if (viewCount > 1) {
+        if (useBindless) {
+            enableBindless(false);
+        }
+        if (transformMode == TRANSFORM_PUSH_CONSTANT) {
+            setTransformMode(TRANSFORM_UNIFORM_BUFFER);
+        }
+    }
+}
+
+glm::mat4 VulkanRenderer::getViewTransform(uint32_t view) {
+    // Views evenly spaced on a circle around the vertical axis, a single view is the scene camera
+    float angle = glm::radians(360.0f) * (float) view / (float) viewCount;
+    return glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void VulkanRenderer::setTransformMode(TransformMode mode) {
+    // The MVP is pushed after the fragment shader block, check the whole range fits
+    uint32_t maxPushConstantSize = deviceObj->gpuProps.limits.maxPushConstantsSize;
+    if (mode == TRANSFORM_PUSH_CONSTANT && PUSH_CONSTANT_VERTEX_OFFSET + sizeof(glm::mat4) > maxPushConstantSize) {
+        printf("Push constant transform does not fit, max allow size is %d\n", maxPushConstantSize);
+        mode = TRANSFORM_UNIFORM_BUFFER;
+    }
+    if (mode == TRANSFORM_PUSH_CONSTANT && viewCount > 1) {
+        std::cout << "The views read their transforms from a uniform buffer, push constant transform disabled\n";
+        mode = TRANSFORM_UNIFORM_BUFFER;
+    }
+    if (mode == TRANSFORM_PUSH_CONSTANT && !isShaderAvailable("DrawPushConstant.vert")) {
+        std::cout << "DrawPushConstant.vert is not embedded in the binary, push constant transform disabled\n";
+        mode = TRANSFORM_UNIFORM_BUFFER;
+    }
+    transformMode = mode;
+}
+
+void VulkanRenderer::beginFrame() {
+    frameIndex++;
+
+    // Wait for the frame which used this slot FRAMES_IN_FLIGHT frames ago, its command buffers,
+    // transient descriptor sets, uniform buffer regions and acquire semaphores are no longer in use.
+    uint32_t frameSlot = frameIndex % FRAMES_IN_FLIGHT;
+    deviceObj->getTimeline(QUEUE_GRAPHICS)->wait(frameValues[frameSlot]);
+    frameCommandPools.beginFrame(frameIndex);
+    if (useAsyncPostProcess) {
+        // The slot's input image is copied into again this frame
+        postProcess.beginFrame(frameSlot);
+    }
+    descriptorAllocator.beginFrame(frameIndex);
+
+    // The transformations computed by update() go to the slot's part of the uniform buffers
+    for (VulkanDrawable *drawableObj : drawableList) {
+        drawableObj->writeUniformBuffer(frameSlot);
+    }
+
+    // Free the resources released by the frames the GPU is done with
+    deletionQueue.collect();
+
+    updateShaderReload();
+}
+
+void VulkanRenderer::renderFrame() {
+    VulkanTimeline *timeline = deviceObj->getTimeline(QUEUE_GRAPHICS);
+    uint32_t &currentColorImage = swapChainObj->scPublicVars.currentColorBuffer;
+    VkSwapchainKHR &swapChain = swapChainObj->scPublicVars.swapChain;
+
+    // beginFrame() waited for the frame which last used this slot's semaphore
+    VkSemaphore presentCompleteSemaphore = presentCompleteSemaphores[frameIndex % FRAMES_IN_FLIGHT];
+
+    VkResult result = swapChainObj->fpAcquireNextImageKHR(deviceObj->device, swapChain, UINT64_MAX,
+                                                          presentCompleteSemaphore, VK_NULL_HANDLE, &currentColorImage);
+    assert(result == VK_SUCCESS);
+
+    // The command stream is recorded every frame into a buffer of the frame's transient pool, the
+    // render graph places the layout transitions and dependencies around its passes.
+    VkCommandBufferBeginInfo cmdBufInfo = {};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufInfo.pNext = nullptr;
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmdBufInfo.pInheritanceInfo = nullptr;
+
+    VkCommandBuffer cmdDraw = frameCommandPools.getCommandBuffer();
+    CommandBufferMgr::beginCommandBuffer(cmdDraw, &cmdBufInfo);
+    if (useResolutionScaling) {
+        // Picks the scale of this frame from the timings of the slot's previous frame
+        resolutionScaler.beginFrame(cmdDraw, frameIndex);
+    }
+    if (useDepthPrePass) {
+        occlusionQueries.beginFrame(cmdDraw, frameIndex);
+    }
+    if (useHiZCulling) {
+        // The frame slot's object buffer is no longer read, beginFrame() waited for its frame
+        uint32_t frameSlot = frameIndex % FRAMES_IN_FLIGHT;
+        for (VulkanDrawable *drawableObj : drawableList) {
+            hiZCulling.setObject(frameSlot, drawableObj->objectIndex, drawableObj->getMVP(), drawableObj->boundsMin,
+                                 drawableObj->boundsMax, drawableObj->vertexCount);
+        }
+    }
+    renderGraph.setImportedImage(backBuffer, swapChainObj->scPublicVars.colorBuffer[currentColorImage].image,
+                                 swapChainObj->scPublicVars.colorBuffer[currentColorImage].view);
+    renderGraph.execute(cmdDraw);
+    CommandBufferMgr::endCommandBuffer(cmdDraw);
+
+    // The graph's first barrier on the back buffer waits for the acquire at the color output stage
+    VkSemaphore drawingCompleteSemaphore = drawingCompleteSemaphores[currentColorImage];
+    std::vector<TimelineWait> waits = {
+            {presentCompleteSemaphore, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT},
+    };
+    uint64_t frameValue = timeline->submit(&cmdDraw, 1, waits, drawingCompleteSemaphore);
+
+    // The copy of the frame is post-processed on the compute queue while the next frame renders
+    if (useAsyncPostProcess) {
+        postProcess.submit(frameIndex % FRAMES_IN_FLIGHT, timeline->getPoint(frameValue));
+    }
+
+    VkPresentInfoKHR presentInfo = {};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = nullptr;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &drawingCompleteSemaphore;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapChain;
+    presentInfo.pImageIndices = &currentColorImage;
+    presentInfo.pResults = nullptr;
+    result = swapChainObj->fpQueuePresentKHR(timeline->queue, &presentInfo);
+    assert(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR);
+}
+
+void VulkanRenderer::recordScenePass(VkCommandBuffer cmd) {
+    uint32_t currentColorImage = swapChainObj->scPublicVars.currentColorBuffer;
+
+    VkClearValue clearValues[2];
+    clearValues[0].color = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    // Specify the depth/stencil clear value
+    clearValues[1].depthStencil.depth = 1.0f;
+    clearValues[1].depthStencil.stencil = 0;
+
+    // Each drawable contributes a secondary buffer, cached while its inputs do not change. The
+    // drawables the pre-pass queries found hidden are left out. Secondary buffers do not inherit
+    // descriptor bindings, each would bind the bindless table again: the bindless draws are
+    // recorded inline instead, see recordSceneDraws().
+    std::vector<VkCommandBuffer> cmdSecondaries;
+    for (uint32_t i = 0; i < drawableList.size() && !isBindless(); i++) {
+        if (useDepthPrePass && !occlusionQueries.isVisible(i)) {
+            continue;
+        }
+        cmdSecondaries.push_back(drawableList[i]->getDrawCommands((int) currentColorImage));
+    }
+
+    if (useDynamicRendering) {
+        recordSceneRendering(cmd, clearValues, cmdSecondaries);
+        return;
+    }
+
+    VkRenderPassBeginInfo renderPassBegin = {};
+    renderPassBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBegin.pNext = nullptr;
+    renderPassBegin.renderPass = renderPass;
+    renderPassBegin.framebuffer = frameBuffers[currentColorImage];
+    renderPassBegin.renderArea.offset.x = 0;
+    renderPassBegin.renderArea.offset.y = 0;
+    renderPassBegin.renderArea.extent = getRenderExtent();
+    renderPassBegin.clearValueCount = 2;
+    renderPassBegin.pClearValues = clearValues;
+
+    vkCmdBeginRenderPass(cmd, &renderPassBegin, isBindless() ? VK_SUBPASS_CONTENTS_INLINE
+                                                              : VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    recordSceneDraws(cmd, cmdSecondaries);
+    vkCmdEndRenderPass(cmd);
+}
+
+void VulkanRenderer::recordSceneDraws(VkCommandBuffer cmd, const std::vector<VkCommandBuffer> &cmdSecondaries) {
+    if (!isBindless()) {
+        if (!cmdSecondaries.empty()) {
+            vkCmdExecuteCommands(cmd, (uint32_t) cmdSecondaries.size(), cmdSecondaries.data());
+        }
+        return;
+    }
+
+    bindBindlessTable(cmd);
+    for (uint32_t i = 0; i < drawableList.size(); i++) {
+        if (useDepthPrePass && !occlusionQueries.isVisible(i)) {
+            continue;
+        }
+        drawableList[i]->recordSceneCommands(&cmd);
+    }
+}
+
+void VulkanRenderer::bindBindlessTable(VkCommandBuffer cmd) {
+    // The drawables' pipeline layouts all have the table's layout at set 0 and the same push
+    // constant ranges, the set stays bound across their pipeline binds
+    if (!drawableList.empty()) {
+        bindlessTable.bind(cmd, drawableList[0]->pipelineLayout);
+    }
+}
+
+void VulkanRenderer::recordDepthPrePass(VkCommandBuffer cmd) {
+    VkClearValue clearValue;
+    clearValue.depthStencil.depth = 1.0f;
+    clearValue.depthStencil.stencil = 0;
+
+    AttachmentOps depthOps = renderGraph.getAttachmentOps(depthPrePass, Depth.resource);
+    if (useDynamicRendering) {
+        VkRenderingAttachmentInfo depthAttachment = {};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.pNext = nullptr;
+        depthAttachment.imageView = Depth.view;
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+        depthAttachment.loadOp = depthOps.loadOp;
+        depthAttachment.storeOp = depthOps.storeOp;
+        depthAttachment.clearValue = clearValue;
+
+        VkRenderingAttachmentInfo stencilAttachment = depthAttachment;
+        stencilAttachment.loadOp = depthOps.stencilLoadOp;
+        stencilAttachment.storeOp = depthOps.stencilStoreOp;
+
+        VkRenderingInfo renderingInfo = {};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.pNext = nullptr;
+        renderingInfo.flags = 0;
+        renderingInfo.renderArea.offset.x = 0;
+        renderingInfo.renderArea.offset.y = 0;
+        renderingInfo.renderArea.extent = getRenderExtent();
+        renderingInfo.layerCount = 1;
+        renderingInfo.viewMask = getViewMask();
+        renderingInfo.colorAttachmentCount = 0;
+        renderingInfo.pColorAttachments = nullptr;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        bool hasStencil = renderGraph.getImageAspect(Depth.resource) & VK_IMAGE_ASPECT_STENCIL_BIT;
+        renderingInfo.pStencilAttachment = hasStencil ? &stencilAttachment : nullptr;
+        vkCmdBeginRendering(cmd, &renderingInfo);
+    } else {
+        VkRenderPassBeginInfo renderPassBegin = {};
+        renderPassBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBegin.pNext = nullptr;
+        renderPassBegin.renderPass = prePassRenderPass;
+        renderPassBegin.framebuffer = prePassFrameBuffer;
+        renderPassBegin.renderArea.offset.x = 0;
+        renderPassBegin.renderArea.offset.y = 0;
+        renderPassBegin.renderArea.extent = getRenderExtent();
+        renderPassBegin.clearValueCount = 1;
+        renderPassBegin.pClearValues = &clearValue;
+        vkCmdBeginRenderPass(cmd, &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    // Cheap to record, the depth only draws go straight into the frame's command buffer. Every
+    // drawable is drawn so that the hidden ones keep being queried.
+    if (isBindless()) {
+        bindBindlessTable(cmd);
+    }
+    for (uint32_t i = 0; i < drawableList.size(); i++) {
+        occlusionQueries.beginQuery(cmd, i);
+        drawableList[i]->recordDepthCommands(&cmd);
+        occlusionQueries.endQuery(cmd, i);
+    }
+
+    if (useDynamicRendering) {
+        vkCmdEndRendering(cmd);
+    } else {
+        vkCmdEndRenderPass(cmd);
+    }
+}
+
+void VulkanRenderer::recordSceneRendering(VkCommandBuffer cmd, const VkClearValue *clearValues,
+                                          const std::vector<VkCommandBuffer> &cmdSecondaries) {
+    // The load and store operations are chosen per frame from the render graph policy: the depth
+    // is only stored when a later pass reads it, otherwise it is discarded at the end of the pass.
+    AttachmentOps colorOps = renderGraph.getAttachmentOps(scenePass, sceneColor);
+
+    VkRenderingAttachmentInfo colorAttachment = {};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.pNext = nullptr;
+    colorAttachment.imageView = renderGraph.getImageView(sceneColor);
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+    if (sceneColor != sceneOutput) {
+        colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+        colorAttachment.resolveImageView = renderGraph.getImageView(sceneOutput);
+        colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+    colorAttachment.loadOp = colorOps.loadOp;
+    colorAttachment.storeOp = colorOps.storeOp;
+    colorAttachment.clearValue = clearValues[0];
+
+    VkRenderingAttachmentInfo depthAttachment = {};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.pNext = nullptr;
+    depthAttachment.imageView = Depth.view;
+    depthAttachment.imageLayout = useDepthPrePass ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                                  : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+    depthAttachment.clearValue = clearValues[1];
+
+    VkRenderingAttachmentInfo stencilAttachment = depthAttachment;
+    if (includeDepth) {
+        AttachmentOps depthOps = renderGraph.getAttachmentOps(scenePass, Depth.resource);
+        depthAttachment.loadOp = depthOps.loadOp;
+        depthAttachment.storeOp = depthOps.storeOp;
+        stencilAttachment.loadOp = depthOps.stencilLoadOp;
+        stencilAttachment.storeOp = depthOps.stencilStoreOp;
+    }
+
+    VkRenderingInfo renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.pNext = nullptr;
+    renderingInfo.flags = isBindless() ? 0 : VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    renderingInfo.renderArea.offset.x = 0;
+    renderingInfo.renderArea.offset.y = 0;
+    renderingInfo.renderArea.extent = getRenderExtent();
+    renderingInfo.layerCount = 1;
+    renderingInfo.viewMask = getViewMask();
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = includeDepth ? &depthAttachment : nullptr;
+    bool hasStencil = includeDepth && (renderGraph.getImageAspect(Depth.resource) & VK_IMAGE_ASPECT_STENCIL_BIT);
+    renderingInfo.pStencilAttachment = hasStencil ? &stencilAttachment : nullptr;
+
+    vkCmdBeginRendering(cmd, &renderingInfo);
+    recordSceneDraws(cmd, cmdSecondaries);
+    vkCmdEndRendering(cmd);
+}
+
+void VulkanRenderer::recordComposeViews(VkCommandBuffer cmd) {
+    // The views keep their aspect ratio side by side, the rest of the back buffer is cleared. A
+    // single view covers it all.
+    VkImage backBufferImage = renderGraph.getImage(backBuffer);
+    if (viewCount > 1) {
+        VkClearColorValue clearColor = {{0.0f, 0.0f, 0.0f, 0.0f}};
+        VkImageSubresourceRange range = {};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.baseMipLevel = 0;
+        range.levelCount = 1;
+        range.baseArrayLayer = 0;
+        range.layerCount = 1;
+        vkCmdClearColorImage(cmd, backBufferImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+    }
+
+    // Only the render extent of the scene was drawn this frame
+    VkExtent2D renderExtent = getRenderExtent();
+
+    int32_t viewHeight = height / (int32_t) viewCount;
+    int32_t top = (height - viewHeight) / 2;
+    std::vector<VkImageBlit> regions(viewCount);
+    for (uint32_t view = 0; view < viewCount; view++) {
+        VkImageBlit &region = regions[view];
+        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.srcSubresource.mipLevel = 0;
+        region.srcSubresource.baseArrayLayer = view;
+        region.srcSubresource.layerCount = 1;
+        region.srcOffsets[0] = {0, 0, 0};
+        region.srcOffsets[1] = {(int32_t) renderExtent.width, (int32_t) renderExtent.height, 1};
+        region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.dstSubresource.mipLevel = 0;
+        region.dstSubresource.baseArrayLayer = 0;
+        region.dstSubresource.layerCount = 1;
+        region.dstOffsets[0] = {width * (int32_t) view / (int32_t) viewCount, top, 0};
+        region.dstOffsets[1] = {width * (int32_t) (view + 1) / (int32_t) viewCount, top + viewHeight, 1};
+    }
+    vkCmdBlitImage(cmd, renderGraph.getImage(sceneOutput), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, backBufferImage,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, viewCount, regions.data(), VK_FILTER_LINEAR);
+}
+
+void VulkanRenderer::endFrame() {
+    // Everything the frame submitted is complete once the graphics timeline reaches this value
+    frameValues[frameIndex % FRAMES_IN_FLIGHT] = deviceObj->getTimeline(QUEUE_GRAPHICS)->getLastSubmitted().value;
+}
+
+void VulkanRenderer::updateShaderReload() {
+    // A reload is in progress, swap it in once the background work is done
+    if (shaderReload.valid()) {
+        if (shaderReload.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            finishShaderReload();
+        }
+        return;
+    }
+
+    std::vector<std::string> changedFiles = shaderWatcher.takeChangedFiles();
+    if (changedFiles.empty()) {
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        reloadStages[i] = std::find(changedFiles.begin(), changedFiles.end(), shaderFiles[i]) != changedFiles.end();
+    }
+    shaderReload = std::async(std::launch::async, &VulkanRenderer::rebuildShaders, this);
+}
+
+bool VulkanRenderer::rebuildShaders() {
+    std::vector<uint32_t> code[2];
+    for (int i = 0; i < 2; i++) {
+        if (!reloadStages[i]) {
+            continue;
+        }
+        size_t size = 0;
+        void *shaderCode = readFile(shaderFiles[i].c_str(), &size);
+        if (!shaderCode) {
+            std::cout << "Shader reload: cannot read " << shaderFiles[i] << "\n";
+            return false;
+        }
+        code[i].assign((uint32_t *) shaderCode, (uint32_t *) shaderCode + size / sizeof(uint32_t));
+        free(shaderCode);
+    }
+
+    // Only the changed modules are created, the other stages are shared with shaderObj
+    if (!reloadShaderObj.buildReloadedStages(shaderObj, code, reloadStages)) {
+        reloadShaderObj.destroyReloadedStages(reloadStages);
+        return false;
+    }
+    if (!pipelineObj.createReloadedVariants(&reloadShaderObj)) {
+        reloadShaderObj.destroyReloadedStages(reloadStages);
+        return false;
+    }
+    return true;
+}
+
+void VulkanRenderer::finishShaderReload() {
+    if (!shaderReload.valid()) {
+        return;
+    }
+    if (shaderReload.get()) {
+        applyShaderReload();
+    }
+}
+
+void VulkanRenderer::applyShaderReload() {
+    // The old modules are not used by the pipelines once created, they are destroyed right away.
+    // The old pipelines stay alive until the frames in flight are complete, the next
+    // frames are recorded with the new handles.
+    shaderObj.replaceStages(reloadShaderObj, reloadStages);
+    pipelineObj.swapReloadedVariants(&deletionQueue);
+
+    std::cout << "Shader reload: " << (reloadStages[0] ? shaderFiles[0] + " " : "")
+              << (reloadStages[1] ? shaderFiles[1] : "") << "\n";
+}
+
+void VulkanRenderer::stopShaderWatcher() {
+    shaderWatcher.stop();
+}
+
 bool VulkanRenderer::render() {
     MSG msg; // message
     PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE);
@@ -92,9 +750,9 @@ LRESULT CALLBACK VulkanRenderer::WndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LP
             PostQuitMessage(0);
             break;
         case WM_PAINT:
-            for (auto drawableObj : appObj->rendererObj->drawableList) {
-                drawableObj->render();
-            }
+            appObj->rendererObj->beginFrame();
+            appObj->rendererObj->renderFrame();
+            appObj->rendererObj->endFrame();
 
             return 0;
         case WM_SIZE:
@@ -233,142 +891,280 @@ void VulkanRenderer::createCommandPool() {
     cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     cmdPoolInfo.pNext = nullptr;
     cmdPoolInfo.queueFamilyIndex = obj->graphicsQueueWithPresentIndex;
-    cmdPoolInfo.flags = 0;
+    // Only the setup batch comes from this pool, the frames record into their own pools
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
     res = vkCreateCommandPool(obj->device, &cmdPoolInfo, nullptr, &cmdPool);
     assert(res == VK_SUCCESS);
+
+    // One pool per frame in flight and per thread which records the frame. The frame and the
+    // draws which are not cached are recorded on this thread only, thread index 0.
+    const uint32_t recordingThreadCount = 1;
+    frameCommandPools.initialize(obj, obj->graphicsQueueWithPresentIndex, recordingThreadCount);
+
+    // The queries are reset and issued by the frame command buffers, one range per frame slot
+    if (useDepthPrePass) {
+        occlusionQueries.initialize(obj, (uint32_t) drawableList.size(), viewCount);
+    }
+    if (useResolutionScaling) {
+        resolutionScaler.initialize(obj);
+    }
 }
 
 void VulkanRenderer::createDepthImage() {
-    VkResult result;
-    bool pass;
-    VkImageCreateInfo imageInfo = {};
-
     // If the depth format is undefined, use fallback as 16-byte value
     if (Depth.format == VK_FORMAT_UNDEFINED) {
         Depth.format = VK_FORMAT_D16_UNORM;
     }
 
-    const VkFormat depthFormat = Depth.format;
-
+    // The render graph creates its images with optimal tiling
     VkFormatProperties props;
-    vkGetPhysicalDeviceFormatProperties(*deviceObj->gpu, depthFormat, &props);
-    if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
-        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    } else if (props.linearTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
-        imageInfo.tiling = VK_IMAGE_TILING_LINEAR;
-    } else {
+    vkGetPhysicalDeviceFormatProperties(*deviceObj->gpu, Depth.format, &props);
+    if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
         std::cout << "Unsupported Depth Format, try other Depth formats.\n";
         exit(-1);
     }
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.pNext = nullptr;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.format = depthFormat;
-    imageInfo.extent.width = width;
-    imageInfo.extent.height = height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.samples = NUM_SAMPLES;
-    imageInfo.queueFamilyIndexCount = 0;
-    imageInfo.pQueueFamilyIndices = nullptr;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    imageInfo.flags = 0;
-
-    // User create image info and create the image objects
-    result = vkCreateImage(deviceObj->device, &imageInfo, nullptr, &Depth.image);
-    assert(result == VK_SUCCESS);
-    VkMemoryRequirements memRqrmnt;
-    vkGetImageMemoryRequirements(deviceObj->device, Depth.image, &memRqrmnt);
-
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAlloc.pNext = nullptr;
-    memAlloc.allocationSize = 0;
-    memAlloc.memoryTypeIndex = 0;
-    memAlloc.allocationSize = memRqrmnt.size;
-    pass = deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits, 0, &memAlloc.memoryTypeIndex);
-    assert(pass);
-
-    // Allocate the memory for image objects
-    result = vkAllocateMemory(deviceObj->device, &memAlloc, nullptr, &Depth.mem);
-    assert(result == VK_SUCCESS);
 
-    // Bind the allocated memeory
-    result = vkBindImageMemory(deviceObj->device, Depth.image, Depth.mem, 0);
-    assert(result == VK_SUCCESS);
+    // Only needed while the scene is drawn, the graph owns it and may share its memory. Unless the
+    // Hi-Z pyramid is built from it nothing reads it afterwards: it is never stored and lives in
+    // lazily allocated memory when available.
+    Depth.resource = renderGraph.createImage("Depth", Depth.format, (uint32_t) width, (uint32_t) height, sampleCount,
+                                             viewCount);
+}
 
-    VkImageViewCreateInfo imgViewInfo = {};
-    imgViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    imgViewInfo.pNext = nullptr;
-    imgViewInfo.image = VK_NULL_HANDLE;
-    imgViewInfo.format = depthFormat;
-    imgViewInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY};
-    imgViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    imgViewInfo.subresourceRange.baseMipLevel = 0;
-    imgViewInfo.subresourceRange.levelCount = 1;
-    imgViewInfo.subresourceRange.baseArrayLayer = 0;
-    imgViewInfo.subresourceRange.layerCount = 1;
-    imgViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    imgViewInfo.flags = 0;
-
-    if (depthFormat == VK_FORMAT_D16_UNORM_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT ||
-        depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT) {
-        imgViewInfo.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-    }
-
-    // Use command buffer to create the depth image. This includes -
-    // Command buffer allocation, recording with begin/end scope and submission.
-    CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &cmdDepthImage);
-    CommandBufferMgr::beginCommandBuffer(cmdDepthImage);
-    {
-        setImageLayout(Depth.image, imgViewInfo.subresourceRange.aspectMask, VK_IMAGE_LAYOUT_UNDEFINED,
-                       VK_IMAGE_LAYOUT_STENCIL_ATTACHMENT_OPTIMAL, (VkAccessFlagBits) 0, cmdDepthImage);
+void VulkanRenderer::createRenderGraph() {
+    // The swap chain image is acquired before the frame starts, its content is not kept: it enters
+    // undefined once the acquire semaphore is waited on at the color output stage
+    backBuffer = renderGraph.importImage("Back buffer", swapChainObj->scPublicVars.format, (uint32_t) width,
+                                         (uint32_t) height, VK_IMAGE_LAYOUT_UNDEFINED,
+                                         VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, RESOURCE_USAGE_PRESENT);
+
+    // Multiview renders each view into a layer, the layers are composed into the back buffer.
+    // Dynamic resolution renders into the part of an internal target the scale selects, the
+    // upscale blit fills the back buffer.
+    sceneOutput = backBuffer;
+    if (viewCount > 1) {
+        sceneOutput = renderGraph.createImage("Scene views", swapChainObj->scPublicVars.format, (uint32_t) width,
+                                              (uint32_t) height, VK_SAMPLE_COUNT_1_BIT, viewCount);
+    } else if (useResolutionScaling) {
+        sceneOutput = renderGraph.createImage("Scaled scene", swapChainObj->scPublicVars.format, (uint32_t) width,
+                                              (uint32_t) height);
     }
-    CommandBufferMgr::endCommandBuffer(cmdDepthImage);
-    CommandBufferMgr::submitCommandBuffer(deviceObj->queue, &cmdDepthImage);
 
-    imgViewInfo.image = Depth.image;
-    result = vkCreateImageView(deviceObj->device, &imgViewInfo, nullptr, &Depth.view);
-    assert(result == VK_SUCCESS);
+    // Multisampled color is resolved inside the pass, like the depth it never reaches memory
+    sceneColor = sceneOutput;
+    if (sampleCount != VK_SAMPLE_COUNT_1_BIT) {
+        sceneColor = renderGraph.createImage("Scene color", swapChainObj->scPublicVars.format, (uint32_t) width,
+                                             (uint32_t) height, sampleCount, viewCount);
+    }
+
+    // The pyramid is sampled by the culling and written by the build, a multisampled or layered
+    // depth buffer would have to be resolved first
+    if (useHiZCulling && (sampleCount != VK_SAMPLE_COUNT_1_BIT || viewCount > 1)) {
+        std::cout << "Hi-Z culling needs a single sampled, single view depth buffer, Hi-Z culling disabled\n";
+        useHiZCulling = false;
+    }
+    if (useHiZCulling && useResolutionScaling) {
+        std::cout << "Hi-Z culling needs the depth of the whole frame, Hi-Z culling disabled\n";
+        useHiZCulling = false;
+    }
+    VkFormatProperties depthProps;
+    vkGetPhysicalDeviceFormatProperties(*deviceObj->gpu, Depth.format, &depthProps);
+    if (useHiZCulling && !(depthProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        std::cout << "The depth format cannot be sampled, Hi-Z culling disabled\n";
+        useHiZCulling = false;
+    }
+    if (useHiZCulling && !hiZCulling.initialize(deviceObj, &descriptorAllocator, initBatch.getCommandBuffer(),
+                                                (uint32_t) width, (uint32_t) height, (uint32_t) drawableList.size())) {
+        std::cout << "The Hi-Z shaders are not available, Hi-Z culling disabled\n";
+        useHiZCulling = false;
+    }
+
+    // Culling comes first, the draws of the frame read the indirect arguments it writes
+    if (useHiZCulling) {
+        hiZPyramid = renderGraph.importImage("Hi-Z pyramid", VK_FORMAT_R32G32_SFLOAT, (uint32_t) width,
+                                             (uint32_t) height, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                             VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, RESOURCE_USAGE_SAMPLED);
+        renderGraph.setImportedImage(hiZPyramid, hiZCulling.getPyramidImage(), hiZCulling.getPyramidView());
+        uint32_t cullPass = renderGraph.addPass("Hi-Z cull", [this](VkCommandBuffer cmd) {
+            hiZCulling.cull(cmd, frameIndex % FRAMES_IN_FLIGHT);
+        });
+        renderGraph.use(cullPass, hiZPyramid, RESOURCE_USAGE_SAMPLED);
+    }
+
+    // The pre-pass writes the depth, the scene pass only tests against it
+    if (useDepthPrePass) {
+        depthPrePass = renderGraph.addPass("Depth pre-pass", [this](VkCommandBuffer cmd) { recordDepthPrePass(cmd); });
+        renderGraph.use(depthPrePass, Depth.resource, RESOURCE_USAGE_DEPTH_ATTACHMENT);
+    }
+
+    scenePass = renderGraph.addPass("Scene", [this](VkCommandBuffer cmd) { recordScenePass(cmd); });
+    renderGraph.use(scenePass, sceneColor, RESOURCE_USAGE_COLOR_ATTACHMENT);
+    if (sceneColor != sceneOutput) {
+        renderGraph.use(scenePass, sceneOutput, RESOURCE_USAGE_RESOLVE_ATTACHMENT);
+    }
+    if (includeDepth) {
+        renderGraph.use(scenePass, Depth.resource,
+                        useDepthPrePass ? RESOURCE_USAGE_DEPTH_READ : RESOURCE_USAGE_DEPTH_ATTACHMENT);
+    }
+
+    // The scene time ends here, the passes below do not depend on the render extent
+    if (useResolutionScaling) {
+        renderGraph.addPass("Scene timing", [this](VkCommandBuffer cmd) { resolutionScaler.endScene(cmd); });
+    }
+
+    if (sceneOutput != backBuffer) {
+        const char *composeName = viewCount > 1 ? "Compose views" : "Upscale";
+        uint32_t composePass = renderGraph.addPass(composeName, [this](VkCommandBuffer cmd) {
+            recordComposeViews(cmd);
+        });
+        renderGraph.use(composePass, sceneOutput, RESOURCE_USAGE_TRANSFER_SRC);
+        renderGraph.use(composePass, backBuffer, RESOURCE_USAGE_TRANSFER_DST);
+    }
+
+    // The pyramid of the next frame's culling is reduced from this frame's depth
+    if (useHiZCulling) {
+        uint32_t buildPass = renderGraph.addPass("Hi-Z build", [this](VkCommandBuffer cmd) { hiZCulling.build(cmd); });
+        renderGraph.use(buildPass, Depth.resource, RESOURCE_USAGE_SAMPLED);
+        renderGraph.use(buildPass, hiZPyramid, RESOURCE_USAGE_STORAGE_WRITE);
+    }
+
+    // The finished frame is copied out last, the post-processing owns the copy and its barriers
+    if (useAsyncPostProcess && !(swapChainObj->scPublicVars.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+        std::cout << "The swap chain images cannot be copied, post-processing disabled\n";
+        useAsyncPostProcess = false;
+    }
+    if (useAsyncPostProcess && !postProcess.initialize(deviceObj, swapChainObj->scPublicVars.format,
+                                                       (uint32_t) width, (uint32_t) height)) {
+        std::cout << "The post-processing shaders are not available, post-processing disabled\n";
+        useAsyncPostProcess = false;
+    }
+    if (useAsyncPostProcess) {
+        uint32_t copyPass = renderGraph.addPass("Post-process copy", [this](VkCommandBuffer cmd) {
+            postProcess.recordCopy(cmd, frameIndex % FRAMES_IN_FLIGHT, renderGraph.getImage(backBuffer));
+        });
+        renderGraph.use(copyPass, backBuffer, RESOURCE_USAGE_TRANSFER_SRC);
+    }
+
+    renderGraph.compile();
+    Depth.image = renderGraph.getImage(Depth.resource);
+    Depth.view = renderGraph.getImageView(Depth.resource);
+    if (useHiZCulling) {
+        hiZCulling.setDepthImage(Depth.image, Depth.format);
+    }
+
+    // Formats the pipelines and the secondary buffers are compatible with in dynamic rendering
+    sceneColorFormat = swapChainObj->scPublicVars.format;
+    bool hasStencil = includeDepth && (renderGraph.getImageAspect(Depth.resource) & VK_IMAGE_ASPECT_STENCIL_BIT);
+
+    sceneRenderingInfo = {};
+    sceneRenderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    sceneRenderingInfo.pNext = nullptr;
+    sceneRenderingInfo.viewMask = getViewMask();
+    sceneRenderingInfo.colorAttachmentCount = 1;
+    sceneRenderingInfo.pColorAttachmentFormats = &sceneColorFormat;
+    sceneRenderingInfo.depthAttachmentFormat = includeDepth ? Depth.format : VK_FORMAT_UNDEFINED;
+    sceneRenderingInfo.stencilAttachmentFormat = hasStencil ? Depth.format : VK_FORMAT_UNDEFINED;
+
+    sceneInheritanceInfo = {};
+    sceneInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    sceneInheritanceInfo.pNext = nullptr;
+    sceneInheritanceInfo.flags = 0;
+    sceneInheritanceInfo.viewMask = getViewMask();
+    sceneInheritanceInfo.colorAttachmentCount = 1;
+    sceneInheritanceInfo.pColorAttachmentFormats = &sceneColorFormat;
+    sceneInheritanceInfo.depthAttachmentFormat = sceneRenderingInfo.depthAttachmentFormat;
+    sceneInheritanceInfo.stencilAttachmentFormat = sceneRenderingInfo.stencilAttachmentFormat;
+    sceneInheritanceInfo.rasterizationSamples = sampleCount;
 }
 
 void VulkanRenderer::createVertexBuffer() {
-    CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &cmdVertexBuffer);
-    CommandBufferMgr::beginCommandBuffer(cmdVertexBuffer);
-
+    // Runs on a worker thread during initialization, it must not use the graphics command pool.
+    // The copies are recorded by the upload manager and submitted right away on the transfer queue.
     for (VulkanDrawable *drawableObj : drawableList) {
         drawableObj->createVertexBuffer(geometryData, sizeof(geometryData), sizeof(geometryData[0]), false);
     }
-    CommandBufferMgr::endCommandBuffer(cmdVertexBuffer);
-    CommandBufferMgr::submitCommandBuffer(deviceObj->queue, &cmdVertexBuffer);
+    uploadManager.submit();
 }
 
+bool VulkanRenderer::isShaderAvailable(const char *shaderName) {
+#ifdef AUTO_COMPILE_GLSL_TO_SPV
+    // Read from the source file and compiled by createShaders()
+    return true;
+#else
+    return findEmbeddedShader(shaderName) != nullptr;
+#endif
+}
+
+// Runs on a worker thread during initialization, it must not use the command pool or the queue
 void VulkanRenderer::createShaders() {
     if (application->isResizing) {
         return;
     }
-    void *vertShaderCode, *fragShaderCode;
-    size_t sizeVert, sizeFrag;
+
+    // Pick the vertex shader matching the way the transforms reach the GPU
+    std::string vertShaderName = "Draw.vert";
+    if (viewCount > 1) {
+        vertShaderName = "DrawMultiview.vert";
+    } else if (transformMode == TRANSFORM_PUSH_CONSTANT) {
+        vertShaderName = "DrawPushConstant.vert";
+    } else if (useBindless) {
+        vertShaderName = "DrawBindless.vert";
+    }
 
 #ifdef AUTO_COMPILE_GLSL_TO_SPV
-    vertShaderCode = readFile("./../Draw.vert", &sizeVert);
+    void *vertShaderCode, *fragShaderCode;
+    size_t sizeVert, sizeFrag;
+    vertShaderCode = readFile(("./../" + vertShaderName).c_str(), &sizeVert);
     fragShaderCode = readFile("./../Draw.frag", &sizeFrag);
 
     shaderObj.buildShader((const char*)vertShaderCode, (const char*)fragShaderCode);
 #else
-    vertShaderCode = readFile("Draw.vert.spv", &sizeVert);
-    fragShaderCode = readFile("Draw.frag.spv", &sizeFrag);
+    // The SPIR-V was compiled at build time and lives in the executable, no file is read
+    const EmbeddedShader *vertShader = findEmbeddedShader(vertShaderName.c_str());
+    const EmbeddedShader *fragShader = findEmbeddedShader("Draw.frag");
+    // The optional modes checked their shader when they were selected, a missing one is fatal here
+    if (!vertShader || !fragShader) {
+        std::cout << "Shader " << (vertShader ? "Draw.frag" : vertShaderName) << " is not embedded in the binary\n";
+        fflush(stdout);
+        exit(-1);
+    }
 
-    shaderObj.buildShaderModuleWithSPV((uint32_t *) vertShaderCode, sizeVert, (uint32_t *) fragShaderCode, sizeFrag);
+    shaderObj.buildShaderModuleWithSPV(vertShader->code, vertShader->size, fragShader->code, fragShader->size);
+
+#ifdef SHADER_BINARY_DIR
+    // Rebuild the modules and pipelines when the build writes the SPIR-V files again
+    shaderFiles[0] = std::string(SHADER_BINARY_DIR) + "/" + vertShaderName + ".spv";
+    shaderFiles[1] = std::string(SHADER_BINARY_DIR) + "/Draw.frag.spv";
+    shaderWatcher.watch(shaderFiles[0]);
+    shaderWatcher.watch(shaderFiles[1]);
+    shaderWatcher.start();
+#endif
 #endif
 }
 
 
 // Create the descriptor set
 void VulkanRenderer::createDescriptors() {
+    // Push constant transforms need neither uniform buffers nor descriptor sets
+    if (transformMode == TRANSFORM_PUSH_CONSTANT) {
+        return;
+    }
+
+    // In bindless mode there are no per drawable sets, each drawable
+    // registers its resources into the global table instead.
+    if (useBindless) {
+        bindlessTable.initialize(deviceObj);
+        for (auto drawableObj : drawableList) {
+            drawableObj->createBindlessDescriptor();
+        }
+        return;
+    }
+
+    // All the drawables allocate their sets from the shared allocator, initialized with the
+    // renderer, their layouts are reflected from the shaders and shared through the cache.
+    descriptorLayoutCache.initialize(deviceObj);
+
     for (auto drawableObj : drawableList) {
         // It is upto an application how it manages the
         // creation of descriptor. Descriptors can be cached
@@ -381,59 +1177,31 @@ void VulkanRenderer::createDescriptors() {
 
 }
 
-// this is not used
-void VulkanRenderer::createPushConstants() {
-    CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &cmdPushConstant);
-    CommandBufferMgr::beginCommandBuffer(cmdPushConstant);
-
-    enum ColorFlag {
-        RED = 1,
-        GREEN = 2,
-        BLUE = 3,
-        MIXED_COLOR = 4,
-    };
-
-    float mixerValue = 0.3f;
-    unsigned constColorRGBFlag = MIXED_COLOR;
-
-    // Create push constant data, this contain a constant
-    // color flag and mixer value for non-const color
-    unsigned pushConstants[2] = {};
-    pushConstants[0] = constColorRGBFlag;
-    memcpy(&pushConstants[1], &mixerValue, sizeof(float));
-
-    // Check if number of push constants does not exceed the allowed size
-    int maxPushConstantSize = getDevice()->gpuProps.limits.maxPushConstantsSize;
-    if (sizeof(pushConstants) > maxPushConstantSize) {
-        assert(0);
-        printf("Push constant size is greater than expected, max allow size is %d", maxPushConstantSize);
-    }
-
-    for (auto drawableObj : drawableList) {
-        vkCmdPushConstants(cmdPushConstant, drawableObj->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                           sizeof(pushConstants), pushConstants);
-    }
-
-    CommandBufferMgr::endCommandBuffer(cmdPushConstant);
-    CommandBufferMgr::submitCommandBuffer(deviceObj->queue, &cmdPushConstant);
-}
-
 
 void VulkanRenderer::destroyFramebuffers() {
-    for (uint32_t i = 0; i < swapChainObj->scPublicVars.swapchainImageCount; i++) {
-        vkDestroyFramebuffer(deviceObj->device, frameBuffers.at(i), NULL);
+    // Empty in dynamic rendering mode
+    for (VkFramebuffer frameBuffer : frameBuffers) {
+        vkDestroyFramebuffer(deviceObj->device, frameBuffer, NULL);
     }
     frameBuffers.clear();
+    vkDestroyFramebuffer(deviceObj->device, prePassFrameBuffer, NULL);
+    prePassFrameBuffer = VK_NULL_HANDLE;
 }
 
-void VulkanRenderer::destroyDepthBuffer() {
-    vkDestroyImageView(deviceObj->device, Depth.view, nullptr);
-    vkDestroyImage(deviceObj->device, Depth.image, nullptr);
-    vkFreeMemory(deviceObj->device, Depth.mem, nullptr);
+void VulkanRenderer::destroyRenderGraph() {
+    // Sized after the swap chain and the depth buffer, created again with the graph
+    hiZCulling.destroy();
+    postProcess.destroy();
+    renderGraph.destroy();
+    Depth.image = VK_NULL_HANDLE;
+    Depth.view = VK_NULL_HANDLE;
 }
 
 void VulkanRenderer::destroyRenderpass() {
     vkDestroyRenderPass(deviceObj->device, renderPass, nullptr);
+    renderPass = VK_NULL_HANDLE;
+    vkDestroyRenderPass(deviceObj->device, prePassRenderPass, nullptr);
+    prePassRenderPass = VK_NULL_HANDLE;
 }
 
 void VulkanRenderer::destroyDrawableVertexBuffer() {
@@ -449,66 +1217,18 @@ void VulkanRenderer::destroyDrawableUniformBuffer() {
     }
 }
 
-void VulkanRenderer::destroyCommandBuffer() {
-    VkCommandBuffer cmdBufs[] = {cmdDepthImage, cmdVertexBuffer, cmdPushConstant};
-    vkFreeCommandBuffers(deviceObj->device, cmdPool, sizeof(cmdBufs) / sizeof(VkCommandBuffer), cmdBufs);
-}
-
 void VulkanRenderer::destroyCommandPool() {
+    occlusionQueries.destroy();
+    resolutionScaler.destroy();
+    frameCommandPools.destroy();
     vkDestroyCommandPool(application->deviceObj->device, cmdPool, nullptr);
 }
 
 void VulkanRenderer::buildSwapChainAndDepthImage() {
-    deviceObj->getDeviceQueue();
-    swapChainObj->createSwapChain(cmdDepthImage);
+    swapChainObj->createSwapChain(initBatch.getCommandBuffer());
+    renderGraph.initialize(deviceObj);
     createDepthImage();
-}
-
-void VulkanRenderer::setImageLayout(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldImageLayout,
-                                    VkImageLayout newImageLayout, VkAccessFlagBits srcAccessMask,
-                                    const VkCommandBuffer &cmdBuf) {
-    // Dependency on cmd
-    assert(cmdBuf != VK_NULL_HANDLE);
-
-    // The deviceObj->queue must be initialized
-    VkImageMemoryBarrier imgMemoryBarrier = {};
-    imgMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imgMemoryBarrier.pNext = nullptr;
-    imgMemoryBarrier.srcAccessMask = srcAccessMask;
-    imgMemoryBarrier.dstAccessMask = 0;
-    imgMemoryBarrier.oldLayout = oldImageLayout;
-    imgMemoryBarrier.newLayout = newImageLayout;
-    imgMemoryBarrier.image = image;
-    imgMemoryBarrier.subresourceRange.aspectMask = aspectMask;
-    imgMemoryBarrier.subresourceRange.baseMipLevel = 0;
-    imgMemoryBarrier.subresourceRange.levelCount = 1;
-    imgMemoryBarrier.subresourceRange.layerCount = 1;
-
-    if (oldImageLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-        imgMemoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    }
-
-    switch (newImageLayout) {
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-            imgMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            break;
-
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-            imgMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            imgMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-            imgMemoryBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            imgMemoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            break;
-    }
-
-    VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    VkPipelineStageFlagBits destStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    vkCmdPipelineBarrier(cmdBuf, srcStages, destStages, 0, 0, nullptr, 0, nullptr, 1, &imgMemoryBarrier);
+    createRenderGraph();
 }
 
 void VulkanRenderer::createRenderPass(bool isDepthSupported, bool clear) {
@@ -517,31 +1237,58 @@ void VulkanRenderer::createRenderPass(bool isDepthSupported, bool clear) {
     // to get the depth buffer image.
 
     VkResult result;
-    // Attach the color buffer and depth buffer as an attachment to render pass instance
-    VkAttachmentDescription attachments[2];
+    // The load and store operations follow how the render graph consumes each attachment
+    AttachmentOps colorOps = renderGraph.getAttachmentOps(scenePass, sceneColor, clear);
+    bool resolve = sceneColor != sceneOutput;
+
+    // After a depth pre-pass the scene pass only reads the depth
+    VkImageLayout depthLayout = useDepthPrePass ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                                : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    // Attach the color buffer and depth buffer as an attachment to render pass instance, and the
+    // single sampled image the multisampled color is resolved to
+    VkAttachmentDescription attachments[3];
     attachments[0].format = swapChainObj->scPublicVars.format;
-    attachments[0].samples = NUM_SAMPLES;
-    attachments[0].loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachments[0].samples = sampleCount;
+    attachments[0].loadOp = colorOps.loadOp;
+    attachments[0].storeOp = colorOps.storeOp;
+    attachments[0].stencilLoadOp = colorOps.stencilLoadOp;
+    attachments[0].stencilStoreOp = colorOps.stencilStoreOp;
+    // The render graph transitions the attachments around the render pass instance
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     attachments[0].flags = VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
 
     // Is the depth buffer present the define attachment properties for depth buffer attachment.
     if (isDepthSupported) {
+        AttachmentOps depthOps = renderGraph.getAttachmentOps(scenePass, Depth.resource, clear);
         attachments[1].format = Depth.format;
-        attachments[1].samples = NUM_SAMPLES;
-        attachments[1].loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-        attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-        attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-        attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachments[1].samples = sampleCount;
+        attachments[1].loadOp = depthOps.loadOp;
+        attachments[1].storeOp = depthOps.storeOp;
+        attachments[1].stencilLoadOp = depthOps.stencilLoadOp;
+        attachments[1].stencilStoreOp = depthOps.stencilStoreOp;
+        attachments[1].initialLayout = depthLayout;
+        attachments[1].finalLayout = depthLayout;
         attachments[1].flags = VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
     }
 
+    // The resolve attachment follows the depth buffer
+    uint32_t attachmentCount = isDepthSupported ? 2 : 1;
+    if (resolve) {
+        AttachmentOps resolveOps = renderGraph.getAttachmentOps(scenePass, sceneOutput, clear);
+        VkAttachmentDescription &resolveAttachment = attachments[attachmentCount++];
+        resolveAttachment.format = swapChainObj->scPublicVars.format;
+        resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        resolveAttachment.loadOp = resolveOps.loadOp;
+        resolveAttachment.storeOp = resolveOps.storeOp;
+        resolveAttachment.stencilLoadOp = resolveOps.stencilLoadOp;
+        resolveAttachment.stencilStoreOp = resolveOps.stencilStoreOp;
+        resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        resolveAttachment.flags = 0;
+    }
+
     // Define the color buffer attachment binding point and layout information
     VkAttachmentReference colorReference = {};
     colorReference.attachment = 0;
@@ -550,7 +1297,12 @@ void VulkanRenderer::createRenderPass(bool isDepthSupported, bool clear) {
     // Define the depth buffer attachment binding point and layout information
     VkAttachmentReference depthReference = {};
     depthReference.attachment = 1;
-    depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthReference.layout = depthLayout;
+
+    // The multisampled color is resolved when the subpass ends
+    VkAttachmentReference resolveReference = {};
+    resolveReference.attachment = attachmentCount - 1;
+    resolveReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     // Specify the attachments - color, depth, resolve, preserve etc.
     VkSubpassDescription subpass = {};
@@ -560,7 +1312,7 @@ void VulkanRenderer::createRenderPass(bool isDepthSupported, bool clear) {
     subpass.pInputAttachments = nullptr;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorReference;
-    subpass.pResolveAttachments = nullptr;
+    subpass.pResolveAttachments = resolve ? &resolveReference : nullptr;
     subpass.pDepthStencilAttachment = isDepthSupported ? &depthReference : nullptr;
     subpass.preserveAttachmentCount = 0;
     subpass.pPreserveAttachments = nullptr;
@@ -569,32 +1321,83 @@ void VulkanRenderer::createRenderPass(bool isDepthSupported, bool clear) {
     VkRenderPassCreateInfo rpInfo = {};
     rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     rpInfo.pNext = nullptr;
-    rpInfo.attachmentCount = isDepthSupported ? 2 : 1;
+    rpInfo.attachmentCount = attachmentCount;
     rpInfo.pAttachments = attachments;
     rpInfo.subpassCount = 1;
     rpInfo.pSubpasses = &subpass;
     rpInfo.dependencyCount = 0;
     rpInfo.pDependencies = nullptr;
 
+    // Multiview broadcasts the subpass to every view, the depth pre-pass renders the same views
+    uint32_t viewMask = getViewMask();
+    VkRenderPassMultiviewCreateInfo multiviewInfo = {};
+    multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+    multiviewInfo.pNext = nullptr;
+    multiviewInfo.subpassCount = 1;
+    multiviewInfo.pViewMasks = &viewMask;
+    multiviewInfo.dependencyCount = 0;
+    multiviewInfo.pViewOffsets = nullptr;
+    multiviewInfo.correlationMaskCount = 0;
+    multiviewInfo.pCorrelationMasks = nullptr;
+    if (viewMask != 0) {
+        rpInfo.pNext = &multiviewInfo;
+    }
+
     // Create the render pass object
     result = vkCreateRenderPass(deviceObj->device, &rpInfo, nullptr, &renderPass);
     assert(result == VK_SUCCESS);
+
+    // The depth pre-pass renders into the depth buffer alone
+    if (useDepthPrePass) {
+        AttachmentOps prePassOps = renderGraph.getAttachmentOps(depthPrePass, Depth.resource, clear);
+        VkAttachmentDescription prePassAttachment = attachments[1];
+        prePassAttachment.loadOp = prePassOps.loadOp;
+        prePassAttachment.storeOp = prePassOps.storeOp;
+        prePassAttachment.stencilLoadOp = prePassOps.stencilLoadOp;
+        prePassAttachment.stencilStoreOp = prePassOps.stencilStoreOp;
+        prePassAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        prePassAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference prePassReference = {};
+        prePassReference.attachment = 0;
+        prePassReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription prePassSubpass = subpass;
+        prePassSubpass.colorAttachmentCount = 0;
+        prePassSubpass.pColorAttachments = nullptr;
+        prePassSubpass.pResolveAttachments = nullptr;
+        prePassSubpass.pDepthStencilAttachment = &prePassReference;
+
+        rpInfo.attachmentCount = 1;
+        rpInfo.pAttachments = &prePassAttachment;
+        rpInfo.pSubpasses = &prePassSubpass;
+        result = vkCreateRenderPass(deviceObj->device, &rpInfo, nullptr, &prePassRenderPass);
+        assert(result == VK_SUCCESS);
+    }
 }
 
 void VulkanRenderer::createFrameBuffer(bool includeDepth) {
     // Dependency on createDepthBuffer(), createRenderPass() and recordSwapChain()
     VkResult result;
-    VkImageView attachments[2];
+    VkImageView attachments[3];
     attachments[1] = Depth.view;
 
+    // Multisampled, the scene output is the resolve attachment after the depth buffer. With
+    // several views it is a layered image of the graph, not the swap chain image.
+    bool resolve = sceneColor != sceneOutput;
+    uint32_t outputAttachment = resolve ? (includeDepth ? 2 : 1) : 0;
+    attachments[0] = renderGraph.getImageView(sceneColor);
+    attachments[outputAttachment] = renderGraph.getImageView(sceneOutput);
+
     VkFramebufferCreateInfo fbInfo = {};
     fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     fbInfo.pNext = nullptr;
     fbInfo.renderPass = renderPass;
-    fbInfo.attachmentCount = includeDepth ? 2 : 1;
+    fbInfo.attachmentCount = (includeDepth ? 2 : 1) + (resolve ? 1 : 0);
     fbInfo.pAttachments = attachments;
     fbInfo.width = width;
     fbInfo.height = height;
+    // Must be 1 with multiview, the view mask selects the layers
     fbInfo.layers = 1;
 
     uint32_t i;
@@ -602,27 +1405,50 @@ void VulkanRenderer::createFrameBuffer(bool includeDepth) {
     frameBuffers.clear();
     frameBuffers.resize(swapChainObj->scPublicVars.swapchainImageCount);
     for (i = 0; i < swapChainObj->scPublicVars.swapchainImageCount; i++) {
-        attachments[0] = swapChainObj->scPublicVars.colorBuffer[i].view;
+        if (sceneOutput == backBuffer) {
+            attachments[outputAttachment] = swapChainObj->scPublicVars.colorBuffer[i].view;
+        }
         result = vkCreateFramebuffer(deviceObj->device, &fbInfo, nullptr, &frameBuffers.at(i));
         assert(result == VK_SUCCESS);
     }
+
+    // The depth pre-pass does not touch the swap chain image, one framebuffer serves all frames
+    if (useDepthPrePass) {
+        fbInfo.renderPass = prePassRenderPass;
+        fbInfo.attachmentCount = 1;
+        fbInfo.pAttachments = &Depth.view;
+        result = vkCreateFramebuffer(deviceObj->device, &fbInfo, nullptr, &prePassFrameBuffer);
+        assert(result == VK_SUCCESS);
+    }
 }
 
 void VulkanRenderer::createPipelineStateManagement() {
     for (auto drawableObj : drawableList) {
         // Use the descriptor layout and create the pipeline layout.
         drawableObj->createPipelineLayout();
+
+        // Match the vertex buffer layout against the vertex shader inputs
+        drawableObj->createVertexInputAttributes();
     }
     pipelineObj.createPipelineCache();
 
     for (VulkanDrawable *drawable : drawableList) {
-        auto *pipeline = (VkPipeline *) malloc(sizeof(VkPipeline));
-        if (pipelineObj.createPipeline(drawable, pipeline, &shaderObj, includeDepth)) {
-            pipelineList.push_back(pipeline);
+        // Each drawable gets the fragment shader variant specialized for its color mode,
+        // drawables sharing the layout and the variant share the pipeline.
+        PipelinePass scenePipelinePass = useDepthPrePass ? PIPELINE_PASS_DEPTH_EQUAL : PIPELINE_PASS_SCENE;
+        VkPipeline *pipeline = pipelineObj.getPipelineVariant(drawable, &shaderObj, drawable->shaderVariant,
+                                                              includeDepth, scenePipelinePass);
+        if (pipeline) {
             drawable->setPipeline(pipeline);
-        } else {
-            free(pipeline);
-            pipeline = nullptr;
+        }
+
+        // Same vertex stage as the scene pipeline, the depth of both passes is identical
+        if (useDepthPrePass) {
+            VkPipeline *depthPipeline = pipelineObj.getPipelineVariant(drawable, &shaderObj, drawable->shaderVariant,
+                                                                       includeDepth, PIPELINE_PASS_DEPTH_ONLY);
+            if (depthPipeline) {
+                drawable->setDepthPipeline(depthPipeline);
+            }
         }
     }
 }
@@ -633,16 +1459,21 @@ void VulkanRenderer::destroyPipeline() {
         free(pipeline);
     }
     pipelineList.clear();
+    pipelineObj.destroyPipelineVariants();
 }
 
-void VulkanRenderer::destroyDrawableCommandBuffer() {
+void VulkanRenderer::destroyDrawableCommandCache() {
     for (auto *drawableObj : drawableList) {
-        drawableObj->destroyCommandBuffer();
+        drawableObj->destroyCommandCache();
     }
 }
 
-void VulkanRenderer::destroyDrawableSynchronizationObjects() {
-    for (auto *drawableObj : drawableList) {
-        drawableObj->destroySynchronizationObjects();
+void VulkanRenderer::destroySynchronizationObjects() {
+    for (auto &semaphore : presentCompleteSemaphores) {
+        vkDestroySemaphore(deviceObj->device, semaphore, nullptr);
+    }
+    for (auto &semaphore : drawingCompleteSemaphores) {
+        vkDestroySemaphore(deviceObj->device, semaphore, nullptr);
     }
+    drawingCompleteSemaphores.clear();
 }
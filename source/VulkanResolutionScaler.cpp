@@ -0,0 +1,146 @@
+#include "VulkanResolutionScaler.h"
+#include "VulkanDevice.h"
+#include <cmath>
+
+// The secondary command buffers are recorded again whenever the extent changes, the scale moves
+// in steps so that small fluctuations of the frame time do not cause recordings
+#define RESOLUTION_SCALE_STEP 0.05f
+// Weight of the latest frame in the averaged scene time
+#define RESOLUTION_AVERAGE_WEIGHT 0.1
+// Fraction of the budget the averaged time must stay under before the scale climbs, and the
+// fraction of the remaining distance climbed per frame
+#define RESOLUTION_HEADROOM 0.85
+#define RESOLUTION_CLIMB_RATE 0.05f
+
+VulkanResolutionScaler::VulkanResolutionScaler() {
+    deviceObj = nullptr;
+    queryPool = VK_NULL_HANDLE;
+    timestampPeriod = 1.0;
+    timestampMask = ~0ull;
+    frameSlot = 0;
+    memset(slotPending, 0, sizeof(slotPending));
+    minScale = maxScale = 1.0f;
+    budgetMs = 0.0f;
+    desiredScale = scale = 1.0f;
+    averageMs = 0.0;
+    measuredFrames = 0;
+    overBudgetFrames = 0;
+    scaleChanges = 0;
+    lowestScale = 1.0f;
+}
+
+VulkanResolutionScaler::~VulkanResolutionScaler() = default;
+
+void VulkanResolutionScaler::setBudget(float lowerScale, float upperScale, float budget) {
+    maxScale = std::min(1.0f, std::max(RESOLUTION_SCALE_STEP, upperScale));
+    minScale = std::min(maxScale, std::max(RESOLUTION_SCALE_STEP, lowerScale));
+    budgetMs = budget;
+    desiredScale = scale = lowestScale = maxScale;
+    averageMs = 0.0;
+}
+
+void VulkanResolutionScaler::initialize(VulkanDevice *device) {
+    deviceObj = device;
+    frameSlot = 0;
+    memset(slotPending, 0, sizeof(slotPending));
+
+    // The frames are recorded for the graphics queue, its timestamps may have fewer than 64 bits
+    uint32_t validBits = deviceObj->queueFamilyProps[deviceObj->graphicsQueueWithPresentIndex].timestampValidBits;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    timestampPeriod = deviceObj->gpuProps.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.pNext = nullptr;
+    queryPoolInfo.flags = 0;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2 * FRAMES_IN_FLIGHT;
+    queryPoolInfo.pipelineStatistics = 0;
+
+    VkResult result = vkCreateQueryPool(deviceObj->device, &queryPoolInfo, nullptr, &queryPool);
+    assert(result == VK_SUCCESS);
+}
+
+void VulkanResolutionScaler::destroy() {
+    if (queryPool == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyQueryPool(deviceObj->device, queryPool, nullptr);
+    queryPool = VK_NULL_HANDLE;
+}
+
+void VulkanResolutionScaler::beginFrame(VkCommandBuffer cmd, uint32_t frameIndex) {
+    frameSlot = frameIndex % FRAMES_IN_FLIGHT;
+    collect(frameSlot);
+
+    vkCmdResetQueryPool(cmd, queryPool, frameSlot * 2, 2);
+
+    // Latched once the work submitted before is done, the time of the previous frame is not counted
+    deviceObj->fpCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, frameSlot * 2);
+    slotPending[frameSlot] = true;
+}
+
+void VulkanResolutionScaler::endScene(VkCommandBuffer cmd) {
+    deviceObj->fpCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, frameSlot * 2 + 1);
+}
+
+void VulkanResolutionScaler::collect(uint32_t slot) {
+    if (!slotPending[slot]) {
+        return;
+    }
+    slotPending[slot] = false;
+
+    // The frame is complete, the results are normally available. Without them the frame is skipped.
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(deviceObj->device, queryPool, slot * 2, 2, sizeof(timestamps), timestamps,
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+    uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+    updateScale((double) ticks * timestampPeriod / 1.0e6);
+}
+
+void VulkanResolutionScaler::updateScale(double sceneMs) {
+    measuredFrames++;
+    averageMs = averageMs == 0.0 ? sceneMs : averageMs + (sceneMs - averageMs) * RESOLUTION_AVERAGE_WEIGHT;
+
+    // The shaded pixels, and roughly the scene time, follow the square of the scale. Over the
+    // budget the scale drops right away to where this frame would have fit.
+    if (sceneMs > budgetMs) {
+        overBudgetFrames++;
+        desiredScale = std::min(desiredScale, scale * (float) std::sqrt(budgetMs / sceneMs));
+        averageMs = std::max(averageMs, sceneMs);
+    } else if (averageMs > 0.0 && averageMs < budgetMs * RESOLUTION_HEADROOM) {
+        float fitScale = scale * (float) std::sqrt(budgetMs * RESOLUTION_HEADROOM / averageMs);
+        desiredScale += (fitScale - desiredScale) * RESOLUTION_CLIMB_RATE;
+    }
+    desiredScale = std::min(maxScale, std::max(minScale, desiredScale));
+
+    // Down to the step below, up only once the step above is reached. The bounds need not be steps.
+    float steppedScale = std::floor(desiredScale / RESOLUTION_SCALE_STEP + 1.0e-3f) * RESOLUTION_SCALE_STEP;
+    steppedScale = desiredScale >= maxScale ? maxScale : std::max(minScale, steppedScale);
+    if (steppedScale != scale) {
+        scale = steppedScale;
+        scaleChanges++;
+        lowestScale = std::min(lowestScale, scale);
+    }
+}
+
+VkExtent2D VulkanResolutionScaler::getRenderExtent(uint32_t width, uint32_t height) {
+    VkExtent2D extent;
+    extent.width = std::max(1u, (uint32_t) std::lround(width * scale));
+    extent.height = std::max(1u, (uint32_t) std::lround(height * scale));
+    return extent;
+}
+
+void VulkanResolutionScaler::printStatistics() {
+    std::cout << "\n\nDynamic resolution statistics:\n";
+    std::cout << "\t|---[Scene budget ms]--> " << budgetMs << "\n";
+    std::cout << "\t|---[Frames measured]--> " << measuredFrames << "\n";
+    std::cout << "\t|---[Frames over budget]--> " << overBudgetFrames << "\n";
+    std::cout << "\t|---[Average scene ms]--> " << averageMs << "\n";
+    std::cout << "\t|---[Scale changes]--> " << scaleChanges << "\n";
+    std::cout << "\t|---[Lowest scale]--> " << lowestScale << "\n";
+    std::cout << "\t|---[Current scale]--> " << scale << std::endl;
+}
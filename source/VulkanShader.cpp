@@ -1,13 +1,28 @@
 #include "VulkanShader.h"
 #include "VulkanApplication.h"
 #include "VulkanDevice.h"
+#ifdef AUTO_COMPILE_GLSL_TO_SPV
+#include "VulkanSpirvCache.h"
+#include <future>
+#endif
 
 
-void VulkanShader::buildShaderModuleWithSPV(uint32_t *vertShaderText, size_t vertexSPVSize, uint32_t *fragShaderText,
-                                            size_t fragmentSPVSize) {
+void VulkanShader::buildShaderModuleWithSPV(const uint32_t *vertShaderText, size_t vertexSPVSize,
+                                            const uint32_t *fragShaderText, size_t fragmentSPVSize) {
     VulkanDevice *deviceObj = VulkanApplication::GetInstance()->deviceObj;
 
     VkResult result;
+    bool pass;
+
+    stageCode[0].assign(vertShaderText, vertShaderText + vertexSPVSize / sizeof(uint32_t));
+    stageCode[1].assign(fragShaderText, fragShaderText + fragmentSPVSize / sizeof(uint32_t));
+
+    // Extract the interface while the SPIR-V words are at hand
+    reflection.clear();
+    pass = reflection.reflect(vertShaderText, vertexSPVSize, VK_SHADER_STAGE_VERTEX_BIT);
+    assert(pass);
+    pass = reflection.reflect(fragShaderText, fragmentSPVSize, VK_SHADER_STAGE_FRAGMENT_BIT);
+    assert(pass);
 
     // Fill in the control structure to push the necessary
     // details of the shader.
@@ -48,13 +63,112 @@ void VulkanShader::destroyShaders() {
     VulkanDevice *deviceObj = VulkanApplication::GetInstance()->deviceObj;
     vkDestroyShaderModule(deviceObj->device, shaderStages[0].module, nullptr);
     vkDestroyShaderModule(deviceObj->device, shaderStages[1].module, nullptr);
+    variants.clear();
+}
+
+const VkPipelineShaderStageCreateInfo *VulkanShader::getVariantStages(const ShaderVariantKey &key) {
+    auto found = variants.find(key);
+    if (found != variants.end()) {
+        return found->second.stages;
+    }
+
+    ShaderVariant &variant = variants[key];
+    variant.key = key;
+
+    // Map the color mode onto Draw.frag's COLOR_MODE specialization constant
+    variant.fragMapEntries[0].constantID = SPEC_ID_COLOR_MODE;
+    variant.fragMapEntries[0].offset = offsetof(ShaderVariantKey, colorMode);
+    variant.fragMapEntries[0].size = sizeof(key.colorMode);
+
+    variant.fragSpecialization.mapEntryCount = 1;
+    variant.fragSpecialization.pMapEntries = variant.fragMapEntries;
+    variant.fragSpecialization.dataSize = sizeof(ShaderVariantKey);
+    variant.fragSpecialization.pData = &variant.key;
+
+    // Same modules as the base stages, only the fragment stage gets specialized
+    variant.stages[0] = shaderStages[0];
+    variant.stages[1] = shaderStages[1];
+    variant.stages[1].pSpecializationInfo = &variant.fragSpecialization;
+    return variant.stages;
+}
+
+bool VulkanShader::buildReloadedStages(const VulkanShader &current, const std::vector<uint32_t> code[2],
+                                       const bool changed[2]) {
+    VulkanDevice *deviceObj = VulkanApplication::GetInstance()->deviceObj;
+
+    VulkanShaderReflection newReflection;
+    for (int i = 0; i < 2; i++) {
+        // Unchanged stages share the module of the current shader
+        shaderStages[i] = current.shaderStages[i];
+        if (changed[i]) {
+            shaderStages[i].module = VK_NULL_HANDLE;
+        }
+        stageCode[i] = changed[i] ? code[i] : current.stageCode[i];
+        if (!newReflection.reflect(stageCode[i].data(), stageCode[i].size() * sizeof(uint32_t),
+                                   current.shaderStages[i].stage)) {
+            return false;
+        }
+    }
+
+    // The descriptor and pipeline layouts are kept, the new code must fit them
+    if (!newReflection.isCompatible(current.reflection)) {
+        std::cout << "Shader reload: the shader interface changed, a restart is required\n";
+        return false;
+    }
+    reflection = newReflection;
+
+    VkResult result;
+    for (int i = 0; i < 2; i++) {
+        if (!changed[i]) {
+            continue;
+        }
+        VkShaderModuleCreateInfo moduleCreateInfo = {};
+        moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleCreateInfo.pNext = nullptr;
+        moduleCreateInfo.flags = 0;
+        moduleCreateInfo.codeSize = stageCode[i].size() * sizeof(uint32_t);
+        moduleCreateInfo.pCode = stageCode[i].data();
+        result = vkCreateShaderModule(deviceObj->device, &moduleCreateInfo, nullptr, &shaderStages[i].module);
+        if (result != VK_SUCCESS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void VulkanShader::replaceStages(VulkanShader &reloaded, const bool changed[2]) {
+    VulkanDevice *deviceObj = VulkanApplication::GetInstance()->deviceObj;
+    for (int i = 0; i < 2; i++) {
+        if (changed[i]) {
+            vkDestroyShaderModule(deviceObj->device, shaderStages[i].module, nullptr);
+        }
+        shaderStages[i] = reloaded.shaderStages[i];
+        stageCode[i] = std::move(reloaded.stageCode[i]);
+    }
+    reflection = reloaded.reflection;
+
+    // The variants point to the old modules, they are generated again on demand
+    variants.clear();
+    reloaded.variants.clear();
+}
+
+void VulkanShader::destroyReloadedStages(const bool changed[2]) {
+    VulkanDevice *deviceObj = VulkanApplication::GetInstance()->deviceObj;
+    for (int i = 0; i < 2; i++) {
+        if (changed[i] && shaderStages[i].module != VK_NULL_HANDLE) {
+            vkDestroyShaderModule(deviceObj->device, shaderStages[i].module, nullptr);
+        }
+    }
+    variants.clear();
 }
 
 #ifdef AUTO_COMPILE_GLSL_TO_SPV
 
 // Helper function intaking the GLSL vertex and fragment shader.
 // It prepares the shaders to be consumed in the SPIR-V format
-// with the help of glslang library helper functions.
+// with the help of glslang library helper functions. Stages already
+// compiled by a previous run are taken from the SPIR-V cache, the
+// others compile in parallel, each on its own worker thread.
 void VulkanShader::buildShader(const char *vertShaderText, const char *fragShaderText)
 {
     VulkanDevice* deviceObj = VulkanApplication::GetInstance()->deviceObj;
@@ -62,93 +176,117 @@ void VulkanShader::buildShader(const char *vertShaderText, const char *fragShade
     VkResult  result;
     bool  retVal;
 
-    // Fill in the control structure to push the necessary
-    // details of the shader.
-    std::vector<unsigned int> vertexSPV;
-    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[0].pNext = nullptr;
-    shaderStages[0].pSpecializationInfo = nullptr;
-    shaderStages[0].flags = 0;
-    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].pName = "main";
+    const char *shaderTexts[2] = { vertShaderText, fragShaderText };
+    const VkShaderStageFlagBits stages[2] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+    const std::string compilerVersion = getCompilerVersion();
 
-    glslang::InitializeProcess();
+    VulkanSpirvCache spirvCache;
+    uint64_t cacheKeys[2];
+    std::vector<unsigned int> spirv[2];
+    std::future<bool> compiled[2];
 
-    retVal = GLSLtoSPV(VK_SHADER_STAGE_VERTEX_BIT, vertShaderText, vertexSPV);
-    assert(retVal);
+    glslang::InitializeProcess();
 
-    VkShaderModuleCreateInfo moduleCreateInfo;
-    moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    moduleCreateInfo.pNext = nullptr;
-    moduleCreateInfo.flags = 0;
-    moduleCreateInfo.codeSize = vertexSPV.size() * sizeof(unsigned int);
-    moduleCreateInfo.pCode = vertexSPV.data();
-    result = vkCreateShaderModule(deviceObj->device, &moduleCreateInfo, nullptr, &shaderStages[0].module);
-    assert(result == VK_SUCCESS);
+    for (int i = 0; i < 2; i++) {
+        cacheKeys[i] = VulkanSpirvCache::computeKey(shaderTexts[i], stages[i], compileDefines, compilerVersion);
+        if (spirvCache.load(cacheKeys[i], spirv[i])) {
+            continue;
+        }
+        compiled[i] = std::async(std::launch::async, [this, &stages, &shaderTexts, &spirv, i]() {
+            return GLSLtoSPV(stages[i], shaderTexts[i], spirv[i]);
+        });
+    }
 
-    std::vector<unsigned int> fragSPV;
-    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[1].pNext = nullptr;
-    shaderStages[1].pSpecializationInfo = nullptr;
-    shaderStages[1].flags = 0;
-    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].pName = "main";
+    for (int i = 0; i < 2; i++) {
+        if (!compiled[i].valid()) {
+            continue;
+        }
+        retVal = compiled[i].get();
+        assert(retVal);
+        spirvCache.store(cacheKeys[i], spirv[i]);
+    }
 
-    retVal = GLSLtoSPV(VK_SHADER_STAGE_FRAGMENT_BIT, fragShaderText, fragSPV);
-    assert(retVal);
+    glslang::FinalizeProcess();
 
-    moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    moduleCreateInfo.pNext = nullptr;
-    moduleCreateInfo.flags = 0;
-    moduleCreateInfo.codeSize = fragSPV.size() * sizeof(unsigned int);
-    moduleCreateInfo.pCode = fragSPV.data();
-    result = vkCreateShaderModule(deviceObj->device, &moduleCreateInfo, nullptr, &shaderStages[1].module);
-    assert(result == VK_SUCCESS);
+    std::cout << "\t|---[SPIR-V cache]--> " << spirvCache.hitCount << " hit(s), "
+              << spirvCache.missCount << " compiled\n";
 
-    glslang::FinalizeProcess();
+    // Fill in the control structure to push the necessary
+    // details of the shader.
+    reflection.clear();
+    for (int i = 0; i < 2; i++) {
+        shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[i].pNext = nullptr;
+        shaderStages[i].pSpecializationInfo = nullptr;
+        shaderStages[i].flags = 0;
+        shaderStages[i].stage = stages[i];
+        shaderStages[i].pName = "main";
+
+        stageCode[i].assign(spirv[i].begin(), spirv[i].end());
+        retVal = reflection.reflect(spirv[i].data(), spirv[i].size() * sizeof(unsigned int), stages[i]);
+        assert(retVal);
+
+        VkShaderModuleCreateInfo moduleCreateInfo;
+        moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleCreateInfo.pNext = nullptr;
+        moduleCreateInfo.flags = 0;
+        moduleCreateInfo.codeSize = spirv[i].size() * sizeof(unsigned int);
+        moduleCreateInfo.pCode = spirv[i].data();
+        result = vkCreateShaderModule(deviceObj->device, &moduleCreateInfo, nullptr, &shaderStages[i].module);
+        assert(result == VK_SUCCESS);
+    }
 }
 
 //
 // Compile a given string containing GLSL into SPV for use by VK
 // Return value of false means an error was encountered.
+// Safe to call from several threads once glslang::InitializeProcess() is done.
 //
 bool VulkanShader::GLSLtoSPV(const VkShaderStageFlagBits shaderType, const char *pshader, std::vector<unsigned int> &spirv)
 {
-    glslang::TProgram* program = new glslang::TProgram;
     const char *shaderStrings[1];
-    TBuiltInResource Resources;
+    TBuiltInResource Resources = {};
     initializeResources(Resources);
 
     // Enable SPIR-V and Vulkan rules when parsing GLSL
     EShMessages messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
 
     EShLanguage stage = getLanguage(shaderType);
-    glslang::TShader* shader = new glslang::TShader(stage);
+    glslang::TShader shader(stage);
+    glslang::TProgram program;
 
     shaderStrings[0] = pshader;
-    shader->setStrings(shaderStrings, 1);
+    shader.setStrings(shaderStrings, 1);
+    shader.setPreamble(compileDefines.c_str());
 
-    if (!shader->parse(&Resources, 100, false, messages)) {
-        puts(shader->getInfoLog());
-        puts(shader->getInfoDebugLog());
+    if (!shader.parse(&Resources, 100, false, messages)) {
+        puts(shader.getInfoLog());
+        puts(shader.getInfoDebugLog());
         return false;
     }
 
-    program->addShader(shader);
+    program.addShader(&shader);
 
     // Link the program and report if errors...
-    if (!program->link(messages)) {
-        puts(shader->getInfoLog());
-        puts(shader->getInfoDebugLog());
+    if (!program.link(messages)) {
+        puts(program.getInfoLog());
+        puts(program.getInfoDebugLog());
         return false;
     }
 
-    glslang::GlslangToSpv(*program->getIntermediate(stage), spirv);
-    delete program;
-    delete shader;
+    glslang::GlslangToSpv(*program.getIntermediate(stage), spirv);
     return true;
 }
 
+std::string VulkanShader::getCompilerVersion()
+{
+    // Everything changing the generated code: the front end, the SPIR-V generator and the parse options
+    std::stringstream version;
+    version << glslang::GetGlslVersionString() << "/" << glslang::GetSpirvGeneratorVersion()
+            << "/" << (EShMsgSpvRules | EShMsgVulkanRules) << "/100";
+    return version.str();
+}
+
 EShLanguage VulkanShader::getLanguage(const VkShaderStageFlagBits shaderType)
 {
     switch (shaderType) {
@@ -0,0 +1,467 @@
+#include "VulkanShaderReflection.h"
+
+// Subset of the SPIR-V specification (spirv.h) needed to walk the module interface
+#define SPIRV_MAGIC_NUMBER 0x07230203
+#define SPIRV_HEADER_WORD_COUNT 5
+
+enum SpirvOp {
+    SPIRV_OP_TYPE_BOOL = 20,
+    SPIRV_OP_TYPE_INT = 21,
+    SPIRV_OP_TYPE_FLOAT = 22,
+    SPIRV_OP_TYPE_VECTOR = 23,
+    SPIRV_OP_TYPE_MATRIX = 24,
+    SPIRV_OP_TYPE_IMAGE = 25,
+    SPIRV_OP_TYPE_SAMPLER = 26,
+    SPIRV_OP_TYPE_SAMPLED_IMAGE = 27,
+    SPIRV_OP_TYPE_ARRAY = 28,
+    SPIRV_OP_TYPE_RUNTIME_ARRAY = 29,
+    SPIRV_OP_TYPE_STRUCT = 30,
+    SPIRV_OP_TYPE_POINTER = 32,
+    SPIRV_OP_CONSTANT = 43,
+    SPIRV_OP_SPEC_CONSTANT = 50,
+    SPIRV_OP_VARIABLE = 59,
+    SPIRV_OP_DECORATE = 71,
+    SPIRV_OP_MEMBER_DECORATE = 72,
+    SPIRV_OP_TYPE_ACCELERATION_STRUCTURE = 5341,
+};
+
+enum SpirvDecoration {
+    SPIRV_DECORATION_BUFFER_BLOCK = 3,
+    SPIRV_DECORATION_ARRAY_STRIDE = 6,
+    SPIRV_DECORATION_BUILT_IN = 11,
+    SPIRV_DECORATION_LOCATION = 30,
+    SPIRV_DECORATION_BINDING = 33,
+    SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+    SPIRV_DECORATION_OFFSET = 35,
+};
+
+enum SpirvStorageClass {
+    SPIRV_STORAGE_UNIFORM_CONSTANT = 0,
+    SPIRV_STORAGE_INPUT = 1,
+    SPIRV_STORAGE_UNIFORM = 2,
+    SPIRV_STORAGE_PUSH_CONSTANT = 9,
+    SPIRV_STORAGE_STORAGE_BUFFER = 12,
+};
+
+enum SpirvDim {
+    SPIRV_DIM_BUFFER = 5,
+    SPIRV_DIM_SUBPASS_DATA = 6,
+};
+
+VulkanShaderReflection::VulkanShaderReflection() = default;
+
+VulkanShaderReflection::~VulkanShaderReflection() = default;
+
+bool VulkanShaderReflection::reflect(const uint32_t *code, size_t codeSize, VkShaderStageFlagBits stage) {
+    size_t wordCount = codeSize / sizeof(uint32_t);
+    if (!code || wordCount < SPIRV_HEADER_WORD_COUNT || code[0] != SPIRV_MAGIC_NUMBER) {
+        std::cout << "Shader reflection: not a SPIR-V module\n";
+        return false;
+    }
+
+    // Every result id is below the bound stored in the header
+    std::vector<SpirvId> ids(code[3]);
+    std::vector<uint32_t> variables;
+
+    const uint32_t *end = code + wordCount;
+    for (const uint32_t *insn = code + SPIRV_HEADER_WORD_COUNT; insn < end;) {
+        uint32_t opcode = insn[0] & 0xffff;
+        uint32_t count = insn[0] >> 16;
+        if (count == 0 || insn + count > end) {
+            std::cout << "Shader reflection: truncated SPIR-V instruction\n";
+            return false;
+        }
+
+        // The ids written below must be in the bound, a partially written file may not be
+        bool isReflected = (opcode >= SPIRV_OP_TYPE_BOOL && opcode <= SPIRV_OP_TYPE_POINTER) ||
+                           opcode == SPIRV_OP_DECORATE || opcode == SPIRV_OP_MEMBER_DECORATE ||
+                           opcode == SPIRV_OP_TYPE_ACCELERATION_STRUCTURE;
+        bool isValue = opcode == SPIRV_OP_CONSTANT || opcode == SPIRV_OP_SPEC_CONSTANT || opcode == SPIRV_OP_VARIABLE;
+        if ((isReflected && (count < 2 || insn[1] >= ids.size())) ||
+            (isValue && (count < 4 || insn[2] >= ids.size()))) {
+            std::cout << "Shader reflection: invalid SPIR-V instruction\n";
+            return false;
+        }
+
+        switch (opcode) {
+            case SPIRV_OP_DECORATE: {
+                SpirvId &target = ids[insn[1]];
+                switch (insn[2]) {
+                    case SPIRV_DECORATION_DESCRIPTOR_SET:
+                        target.set = insn[3];
+                        target.hasSet = true;
+                        break;
+                    case SPIRV_DECORATION_BINDING:
+                        target.binding = insn[3];
+                        target.hasBinding = true;
+                        break;
+                    case SPIRV_DECORATION_LOCATION:
+                        target.location = insn[3];
+                        target.hasLocation = true;
+                        break;
+                    case SPIRV_DECORATION_ARRAY_STRIDE:
+                        target.arrayStride = insn[3];
+                        break;
+                    case SPIRV_DECORATION_BUILT_IN:
+                        target.isBuiltIn = true;
+                        break;
+                    case SPIRV_DECORATION_BUFFER_BLOCK:
+                        target.isBufferBlock = true;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            }
+            case SPIRV_OP_MEMBER_DECORATE: {
+                SpirvId &target = ids[insn[1]];
+                uint32_t member = insn[2];
+                if (insn[3] == SPIRV_DECORATION_OFFSET) {
+                    if (target.memberOffsets.size() <= member) {
+                        target.memberOffsets.resize(member + 1);
+                    }
+                    target.memberOffsets[member] = insn[4];
+                } else if (insn[3] == SPIRV_DECORATION_BUILT_IN) {
+                    // gl_PerVertex and friends
+                    target.isBuiltIn = true;
+                }
+                break;
+            }
+            case SPIRV_OP_TYPE_BOOL:
+            case SPIRV_OP_TYPE_SAMPLER:
+            case SPIRV_OP_TYPE_ACCELERATION_STRUCTURE:
+                ids[insn[1]].opcode = opcode;
+                break;
+            case SPIRV_OP_TYPE_INT:
+                ids[insn[1]].opcode = opcode;
+                ids[insn[1]].width = insn[2];
+                ids[insn[1]].sampled = insn[3];
+                break;
+            case SPIRV_OP_TYPE_FLOAT:
+                ids[insn[1]].opcode = opcode;
+                ids[insn[1]].width = insn[2];
+                break;
+            case SPIRV_OP_TYPE_VECTOR:
+            case SPIRV_OP_TYPE_MATRIX:
+                ids[insn[1]].opcode = opcode;
+                ids[insn[1]].typeId = insn[2];
+                ids[insn[1]].width = insn[3];
+                break;
+            case SPIRV_OP_TYPE_IMAGE:
+                ids[insn[1]].opcode = opcode;
+                ids[insn[1]].typeId = insn[2];
+                ids[insn[1]].width = insn[3];
+                ids[insn[1]].sampled = insn[7];
+                break;
+            case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+            case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+                ids[insn[1]].opcode = opcode;
+                ids[insn[1]].typeId = insn[2];
+                break;
+            case SPIRV_OP_TYPE_ARRAY:
+                // The length is the id of a constant, resolved once all the constants are known
+                ids[insn[1]].opcode = opcode;
+                ids[insn[1]].typeId = insn[2];
+                ids[insn[1]].width = insn[3];
+                break;
+            case SPIRV_OP_TYPE_STRUCT:
+                ids[insn[1]].opcode = opcode;
+                ids[insn[1]].members.assign(insn + 2, insn + count);
+                break;
+            case SPIRV_OP_TYPE_POINTER:
+                ids[insn[1]].opcode = opcode;
+                ids[insn[1]].storageClass = insn[2];
+                ids[insn[1]].typeId = insn[3];
+                break;
+            case SPIRV_OP_CONSTANT:
+            case SPIRV_OP_SPEC_CONSTANT:
+                // Only 32 bit integer constants are used as array lengths
+                ids[insn[2]].opcode = opcode;
+                ids[insn[2]].constant = insn[3];
+                break;
+            case SPIRV_OP_VARIABLE:
+                ids[insn[2]].opcode = opcode;
+                ids[insn[2]].typeId = insn[1];
+                ids[insn[2]].storageClass = insn[3];
+                variables.push_back(insn[2]);
+                break;
+            default:
+                break;
+        }
+        insn += count;
+    }
+
+    for (uint32_t id : variables) {
+        const SpirvId &variable = ids[id];
+        switch (variable.storageClass) {
+            case SPIRV_STORAGE_UNIFORM_CONSTANT:
+            case SPIRV_STORAGE_UNIFORM:
+            case SPIRV_STORAGE_STORAGE_BUFFER:
+                addDescriptorBinding(ids, variable, stage);
+                break;
+            case SPIRV_STORAGE_PUSH_CONSTANT:
+                addPushConstantRange(ids, variable, stage);
+                break;
+            case SPIRV_STORAGE_INPUT: {
+                // Only the vertex stage inputs come from the vertex buffers
+                const SpirvId &type = ids[ids[variable.typeId].typeId];
+                if (stage != VK_SHADER_STAGE_VERTEX_BIT || !variable.hasLocation ||
+                    variable.isBuiltIn || type.isBuiltIn) {
+                    break;
+                }
+                ReflectedVertexInput input = {};
+                input.location = variable.location;
+                input.format = getVertexFormat(ids, ids[variable.typeId].typeId);
+                input.size = getTypeSize(ids, ids[variable.typeId].typeId);
+                vertexInputs.push_back(input);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+void VulkanShaderReflection::clear() {
+    descriptorBindings.clear();
+    pushConstantRanges.clear();
+    vertexInputs.clear();
+}
+
+bool VulkanShaderReflection::isCompatible(const VulkanShaderReflection &other) const {
+    if (descriptorBindings.size() != other.descriptorBindings.size() ||
+        pushConstantRanges.size() != other.pushConstantRanges.size() ||
+        vertexInputs.size() != other.vertexInputs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < descriptorBindings.size(); i++) {
+        const ReflectedDescriptorBinding &a = descriptorBindings[i];
+        const ReflectedDescriptorBinding &b = other.descriptorBindings[i];
+        if (a.set != b.set || a.binding != b.binding || a.descriptorType != b.descriptorType ||
+            a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < pushConstantRanges.size(); i++) {
+        const VkPushConstantRange &a = pushConstantRanges[i];
+        const VkPushConstantRange &b = other.pushConstantRanges[i];
+        if (a.stageFlags != b.stageFlags || a.offset != b.offset || a.size != b.size) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < vertexInputs.size(); i++) {
+        const ReflectedVertexInput &a = vertexInputs[i];
+        const ReflectedVertexInput &b = other.vertexInputs[i];
+        if (a.location != b.location || a.format != b.format) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t VulkanShaderReflection::getTypeSize(const std::vector<SpirvId> &ids, uint32_t typeId) const {
+    const SpirvId &type = ids[typeId];
+    switch (type.opcode) {
+        case SPIRV_OP_TYPE_BOOL:
+            return 4;
+        case SPIRV_OP_TYPE_INT:
+        case SPIRV_OP_TYPE_FLOAT:
+            return type.width / 8;
+        case SPIRV_OP_TYPE_VECTOR:
+            return type.width * getTypeSize(ids, type.typeId);
+        case SPIRV_OP_TYPE_MATRIX: {
+            // Columns of three components are padded to four in both std140 and std430
+            const SpirvId &column = ids[type.typeId];
+            uint32_t rows = column.width == 3 ? 4 : column.width;
+            return type.width * rows * getTypeSize(ids, column.typeId);
+        }
+        case SPIRV_OP_TYPE_ARRAY: {
+            uint32_t stride = type.arrayStride ? type.arrayStride : getTypeSize(ids, type.typeId);
+            return ids[type.width].constant * stride;
+        }
+        case SPIRV_OP_TYPE_STRUCT: {
+            uint32_t size = 0;
+            for (size_t i = 0; i < type.members.size(); i++) {
+                uint32_t offset = i < type.memberOffsets.size() ? type.memberOffsets[i] : 0;
+                size = std::max(size, offset + getTypeSize(ids, type.members[i]));
+            }
+            return size;
+        }
+        default:
+            // Runtime arrays and opaque types have no size
+            return 0;
+    }
+}
+
+VkFormat VulkanShaderReflection::getVertexFormat(const std::vector<SpirvId> &ids, uint32_t typeId) const {
+    static const VkFormat floatFormats[4] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+                                             VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+    static const VkFormat sintFormats[4] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+                                            VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+    static const VkFormat uintFormats[4] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+                                            VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+
+    uint32_t componentCount = 1;
+    const SpirvId *component = &ids[typeId];
+    if (component->opcode == SPIRV_OP_TYPE_VECTOR) {
+        componentCount = component->width;
+        component = &ids[component->typeId];
+    }
+
+    if (componentCount < 1 || componentCount > 4 || component->width != 32) {
+        std::cout << "Shader reflection: unsupported vertex input type\n";
+        return VK_FORMAT_UNDEFINED;
+    }
+    if (component->opcode == SPIRV_OP_TYPE_FLOAT) {
+        return floatFormats[componentCount - 1];
+    }
+    return component->sampled ? sintFormats[componentCount - 1] : uintFormats[componentCount - 1];
+}
+
+void VulkanShaderReflection::addDescriptorBinding(const std::vector<SpirvId> &ids, const SpirvId &variable,
+                                                  VkShaderStageFlagBits stage) {
+    if (!variable.hasBinding) {
+        return;
+    }
+
+    // Unwrap the pointer and the arrays of descriptors
+    uint32_t descriptorCount = 1;
+    const SpirvId *type = &ids[ids[variable.typeId].typeId];
+    while (type->opcode == SPIRV_OP_TYPE_ARRAY || type->opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY) {
+        descriptorCount = type->opcode == SPIRV_OP_TYPE_ARRAY ? descriptorCount * ids[type->width].constant : 0;
+        type = &ids[type->typeId];
+    }
+
+    VkDescriptorType descriptorType;
+    switch (type->opcode) {
+        case SPIRV_OP_TYPE_STRUCT:
+            descriptorType = variable.storageClass == SPIRV_STORAGE_STORAGE_BUFFER || type->isBufferBlock ?
+                             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            break;
+        case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+            descriptorType = ids[type->typeId].width == SPIRV_DIM_BUFFER ?
+                             VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            break;
+        case SPIRV_OP_TYPE_IMAGE:
+            if (type->width == SPIRV_DIM_SUBPASS_DATA) {
+                descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            } else if (type->width == SPIRV_DIM_BUFFER) {
+                descriptorType = type->sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER :
+                                 VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            } else {
+                descriptorType = type->sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE :
+                                 VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+            break;
+        case SPIRV_OP_TYPE_SAMPLER:
+            descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+            break;
+        case SPIRV_OP_TYPE_ACCELERATION_STRUCTURE:
+            descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+            break;
+        default:
+            std::cout << "Shader reflection: unknown descriptor type at binding " << variable.binding << "\n";
+            return;
+    }
+
+    // The same binding used by several stages becomes a single binding visible to all of them
+    for (auto &binding : descriptorBindings) {
+        if (binding.set == variable.set && binding.binding == variable.binding) {
+            assert(binding.descriptorType == descriptorType);
+            binding.stageFlags |= stage;
+            return;
+        }
+    }
+
+    ReflectedDescriptorBinding binding = {};
+    binding.set = variable.hasSet ? variable.set : 0;
+    binding.binding = variable.binding;
+    binding.descriptorType = descriptorType;
+    binding.descriptorCount = descriptorCount;
+    binding.stageFlags = stage;
+    descriptorBindings.push_back(binding);
+}
+
+void VulkanShaderReflection::addPushConstantRange(const std::vector<SpirvId> &ids, const SpirvId &variable,
+                                                  VkShaderStageFlagBits stage) {
+    const SpirvId &block = ids[ids[variable.typeId].typeId];
+    if (block.members.empty()) {
+        return;
+    }
+
+    // The range spans from the first to the last byte used by the block members,
+    // blocks using layout(offset) do not start at zero.
+    uint32_t begin = UINT32_MAX;
+    uint32_t end = 0;
+    for (size_t i = 0; i < block.members.size(); i++) {
+        uint32_t offset = i < block.memberOffsets.size() ? block.memberOffsets[i] : 0;
+        begin = std::min(begin, offset);
+        end = std::max(end, offset + getTypeSize(ids, block.members[i]));
+    }
+
+    for (auto &range : pushConstantRanges) {
+        if (range.offset == begin && range.size == end - begin) {
+            range.stageFlags |= stage;
+            return;
+        }
+    }
+
+    VkPushConstantRange range = {};
+    range.stageFlags = stage;
+    range.offset = begin;
+    range.size = end - begin;
+    pushConstantRanges.push_back(range);
+}
+
+std::vector<VkDescriptorSetLayoutBinding>
+VulkanShaderReflection::getSetLayoutBindings(uint32_t set, uint32_t runtimeArraySize) const {
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+    for (auto &reflected : descriptorBindings) {
+        if (reflected.set != set) {
+            continue;
+        }
+        VkDescriptorSetLayoutBinding layoutBinding = {};
+        layoutBinding.binding = reflected.binding;
+        layoutBinding.descriptorType = reflected.descriptorType;
+        layoutBinding.descriptorCount = reflected.descriptorCount ? reflected.descriptorCount : runtimeArraySize;
+        layoutBinding.stageFlags = reflected.stageFlags;
+        layoutBinding.pImmutableSamplers = nullptr;
+        layoutBindings.push_back(layoutBinding);
+    }
+
+    std::sort(layoutBindings.begin(), layoutBindings.end(),
+              [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) {
+                  return a.binding < b.binding;
+              });
+    return layoutBindings;
+}
+
+uint32_t VulkanShaderReflection::getSetCount() const {
+    uint32_t setCount = 0;
+    for (auto &binding : descriptorBindings) {
+        setCount = std::max(setCount, binding.set + 1);
+    }
+    return setCount;
+}
+
+uint32_t VulkanShaderReflection::getVertexInputAttributes(
+        uint32_t binding, std::vector<VkVertexInputAttributeDescription> &attributes) const {
+    std::vector<ReflectedVertexInput> inputs = vertexInputs;
+    std::sort(inputs.begin(), inputs.end(), [](const ReflectedVertexInput &a, const ReflectedVertexInput &b) {
+        return a.location < b.location;
+    });
+
+    uint32_t offset = 0;
+    attributes.clear();
+    for (auto &input : inputs) {
+        VkVertexInputAttributeDescription attribute = {};
+        attribute.binding = binding;
+        attribute.location = input.location;
+        attribute.format = input.format;
+        attribute.offset = offset;
+        attributes.push_back(attribute);
+        offset += input.size;
+    }
+    return offset;
+}
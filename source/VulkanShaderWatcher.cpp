@@ -0,0 +1,131 @@
+#include "VulkanShaderWatcher.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+// How long the watcher thread blocks before checking if it has to stop
+#define SHADER_WATCHER_PERIOD_MS 200
+
+VulkanShaderWatcher::VulkanShaderWatcher() {
+    running = false;
+#ifdef __linux__
+    inotifyFd = -1;
+#endif
+}
+
+VulkanShaderWatcher::~VulkanShaderWatcher() {
+    stop();
+}
+
+std::string VulkanShaderWatcher::normalize(const std::filesystem::path &path) {
+    std::error_code error;
+    std::filesystem::path absolute = std::filesystem::absolute(path, error);
+    return (error ? path : absolute).lexically_normal().string();
+}
+
+void VulkanShaderWatcher::watch(const std::string &path) {
+    assert(!running);
+    std::string file = normalize(path);
+    watchedFiles[file] = path;
+
+#ifdef __linux__
+    if (inotifyFd < 0) {
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0) {
+            std::cout << "Shader watcher: inotify is not available\n";
+            return;
+        }
+    }
+
+    // Editors and compilers often write a temporary file and rename it, watch the
+    // directory and filter on the file name instead of watching the file itself.
+    std::filesystem::path directory = std::filesystem::path(file).parent_path();
+    int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0) {
+        std::cout << "Shader watcher: cannot watch " << directory << "\n";
+        return;
+    }
+    watchedDirectories[wd] = directory;
+#else
+    std::error_code error;
+    lastWriteTimes[file] = std::filesystem::last_write_time(file, error);
+#endif
+}
+
+void VulkanShaderWatcher::start() {
+    if (running || watchedFiles.empty()) {
+        return;
+    }
+    running = true;
+    thread = std::thread(&VulkanShaderWatcher::run, this);
+}
+
+void VulkanShaderWatcher::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    watchedDirectories.clear();
+#endif
+}
+
+std::vector<std::string> VulkanShaderWatcher::takeChangedFiles() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> files(changedFiles.begin(), changedFiles.end());
+    changedFiles.clear();
+    return files;
+}
+
+void VulkanShaderWatcher::run() {
+#ifdef __linux__
+    if (inotifyFd < 0) {
+        return;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (running) {
+        pollfd pfd = {inotifyFd, POLLIN, 0};
+        if (poll(&pfd, 1, SHADER_WATCHER_PERIOD_MS) <= 0) {
+            continue;
+        }
+
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length;) {
+            auto *event = (inotify_event *) (buffer + offset);
+            offset += (ssize_t) (sizeof(inotify_event) + event->len);
+
+            auto directory = watchedDirectories.find(event->wd);
+            if (event->len == 0 || directory == watchedDirectories.end()) {
+                continue;
+            }
+            auto file = watchedFiles.find(normalize(directory->second / event->name));
+            if (file != watchedFiles.end()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                changedFiles.insert(file->second);
+            }
+        }
+    }
+#else
+    while (running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SHADER_WATCHER_PERIOD_MS));
+        for (auto &file : lastWriteTimes) {
+            std::error_code error;
+            auto writeTime = std::filesystem::last_write_time(file.first, error);
+            if (error || writeTime == file.second) {
+                continue;
+            }
+            file.second = writeTime;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            changedFiles.insert(watchedFiles[file.first]);
+        }
+    }
+#endif
+}
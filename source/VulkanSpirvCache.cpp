@@ -0,0 +1,91 @@
+#include "VulkanSpirvCache.h"
+#include <filesystem>
+#include <cstring>
+#include <fstream>
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+#define SPIRV_MAGIC 0x07230203
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const auto *bytes = (const uint8_t *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+VulkanSpirvCache::VulkanSpirvCache(const std::string &cacheDirectory) {
+    directory = cacheDirectory;
+    hitCount = 0;
+    missCount = 0;
+}
+
+VulkanSpirvCache::~VulkanSpirvCache() = default;
+
+uint64_t VulkanSpirvCache::computeKey(const char *source, VkShaderStageFlagBits stage, const std::string &defines,
+                                      const std::string &compilerVersion) {
+    // Each input is followed by its size so that moving bytes between inputs changes the key
+    uint64_t hash = FNV_OFFSET_BASIS;
+    size_t sourceSize = strlen(source);
+    hash = hashBytes(hash, source, sourceSize);
+    hash = hashBytes(hash, &sourceSize, sizeof(sourceSize));
+    hash = hashBytes(hash, &stage, sizeof(stage));
+    hash = hashBytes(hash, defines.data(), defines.size());
+    size_t definesSize = defines.size();
+    hash = hashBytes(hash, &definesSize, sizeof(definesSize));
+    hash = hashBytes(hash, compilerVersion.data(), compilerVersion.size());
+    return hash;
+}
+
+std::string VulkanSpirvCache::getEntryPath(uint64_t key) {
+    std::stringstream path;
+    path << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".spv";
+    return path.str();
+}
+
+bool VulkanSpirvCache::load(uint64_t key, std::vector<unsigned int> &spirv) {
+    std::ifstream file(getEntryPath(key), std::ios::binary | std::ios::ate);
+    std::streamsize size = file ? (std::streamsize) file.tellg() : 0;
+    if (size < (std::streamsize) sizeof(unsigned int) || size % sizeof(unsigned int) != 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        missCount++;
+        return false;
+    }
+
+    spirv.resize(size / sizeof(unsigned int));
+    file.seekg(0);
+    file.read((char *) spirv.data(), size);
+    if (!file || spirv[0] != SPIRV_MAGIC) {
+        spirv.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        missCount++;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    hitCount++;
+    return true;
+}
+
+void VulkanSpirvCache::store(uint64_t key, const std::vector<unsigned int> &spirv) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    // Write aside and rename, a process reading the cache concurrently never sees a partial entry
+    std::string path = getEntryPath(key);
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write((const char *) spirv.data(), (std::streamsize) (spirv.size() * sizeof(unsigned int)));
+        if (!file) {
+            std::cout << "SPIR-V cache: cannot write " << temporaryPath << "\n";
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
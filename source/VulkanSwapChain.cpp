@@ -278,7 +278,12 @@ void VulkanSwapChain::createSwapChainColorImages() {
     swapChainInfo.oldSwapchain = oldSwapchain;
     swapChainInfo.clipped = true;
     swapChainInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
-    swapChainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    // The post-processing copies the presented image out when the surface allows it
+    scPublicVars.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (scPrivateVars.surfCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+        scPublicVars.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    swapChainInfo.imageUsage = scPublicVars.imageUsage;
     swapChainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     swapChainInfo.queueFamilyIndexCount = 0;
     swapChainInfo.pQueueFamilyIndices = nullptr;
@@ -0,0 +1,119 @@
+#include "VulkanTimeline.h"
+#include "VulkanDevice.h"
+
+VulkanTimeline::VulkanTimeline() {
+    deviceObj = nullptr;
+    queue = VK_NULL_HANDLE;
+    semaphore = VK_NULL_HANDLE;
+    lastSubmittedValue = 0;
+}
+
+VulkanTimeline::~VulkanTimeline() = default;
+
+void VulkanTimeline::initialize(VulkanDevice *device, VkQueue submitQueue) {
+    deviceObj = device;
+    queue = submitQueue;
+    if (semaphore != VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkSemaphoreTypeCreateInfo typeInfo = {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.pNext = nullptr;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    semaphoreInfo.flags = 0;
+
+    VkResult result = vkCreateSemaphore(deviceObj->device, &semaphoreInfo, nullptr, &semaphore);
+    assert(result == VK_SUCCESS);
+    lastSubmittedValue = 0;
+}
+
+void VulkanTimeline::destroy() {
+    if (semaphore == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroySemaphore(deviceObj->device, semaphore, nullptr);
+    semaphore = VK_NULL_HANDLE;
+    queue = VK_NULL_HANDLE;
+}
+
+uint64_t VulkanTimeline::submit(const VkCommandBuffer *cmdBufs, uint32_t cmdBufCount,
+                                const std::vector<TimelineWait> &waits, VkSemaphore binarySignal) {
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStageMasks;
+    for (auto &wait : waits) {
+        if (wait.semaphore == VK_NULL_HANDLE) {
+            continue;
+        }
+        waitSemaphores.push_back(wait.semaphore);
+        waitValues.push_back(wait.value);
+        waitStageMasks.push_back(wait.stageMask);
+    }
+
+    std::lock_guard<std::mutex> lock(submitMutex);
+    uint64_t signalValue = lastSubmittedValue + 1;
+
+    // The binary semaphore takes a value too, it is ignored
+    VkSemaphore signalSemaphores[2] = {semaphore, binarySignal};
+    uint64_t signalValues[2] = {signalValue, 0};
+    uint32_t signalCount = binarySignal != VK_NULL_HANDLE ? 2 : 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.pNext = nullptr;
+    timelineInfo.waitSemaphoreValueCount = (uint32_t) waitValues.size();
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = signalCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = (uint32_t) waitSemaphores.size();
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStageMasks.data();
+    submitInfo.commandBufferCount = cmdBufCount;
+    submitInfo.pCommandBuffers = cmdBufs;
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    VkResult result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+    assert(result == VK_SUCCESS);
+
+    lastSubmittedValue = signalValue;
+    return signalValue;
+}
+
+uint64_t VulkanTimeline::getCompletedValue() {
+    uint64_t value = 0;
+    VkResult result = vkGetSemaphoreCounterValue(deviceObj->device, semaphore, &value);
+    assert(result == VK_SUCCESS);
+    return value;
+}
+
+void VulkanTimeline::wait(uint64_t value) {
+    wait(deviceObj, getPoint(value));
+}
+
+void VulkanTimeline::wait(VulkanDevice *device, const TimelinePoint &point) {
+    if (point.semaphore == VK_NULL_HANDLE || point.value == 0) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.pNext = nullptr;
+    waitInfo.flags = 0;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &point.semaphore;
+    waitInfo.pValues = &point.value;
+
+    VkResult result = vkWaitSemaphores(device->device, &waitInfo, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+}
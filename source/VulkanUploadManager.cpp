@@ -0,0 +1,179 @@
+#include "VulkanUploadManager.h"
+#include "VulkanDevice.h"
+#include "Wrappers.h"
+
+VulkanUploadManager::VulkanUploadManager() {
+    deviceObj = nullptr;
+    cmdPool = VK_NULL_HANDLE;
+    cmdBuf = VK_NULL_HANDLE;
+    uploadPoint = {};
+    submitted = false;
+    acquireStageMask = 0;
+}
+
+VulkanUploadManager::~VulkanUploadManager() = default;
+
+void VulkanUploadManager::initialize(VulkanDevice *device) {
+    if (deviceObj != nullptr) {
+        return;
+    }
+    deviceObj = device;
+    VkResult result;
+
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.pNext = nullptr;
+    cmdPoolInfo.queueFamilyIndex = deviceObj->transferQueueIndex;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    result = vkCreateCommandPool(deviceObj->device, &cmdPoolInfo, nullptr, &cmdPool);
+    assert(result == VK_SUCCESS);
+}
+
+void VulkanUploadManager::beginCommandBuffer() {
+    if (cmdBuf == VK_NULL_HANDLE) {
+        CommandBufferMgr::allocCommandBuffer(&deviceObj->device, cmdPool, &cmdBuf);
+    }
+
+    VkCommandBufferBeginInfo cmdBufInfo = {};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufInfo.pNext = nullptr;
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmdBufInfo.pInheritanceInfo = nullptr;
+    VkResult result = vkBeginCommandBuffer(cmdBuf, &cmdBufInfo);
+    assert(result == VK_SUCCESS);
+}
+
+void VulkanUploadManager::uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size,
+                                       VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask) {
+    assert(deviceObj != nullptr);
+    assert(!submitted);
+    VkResult result;
+    bool pass;
+
+    if (stagingBuffers.empty()) {
+        beginCommandBuffer();
+    }
+
+    // Host visible staging buffer holding the source data until the copy has executed
+    StagingBuffer staging = {};
+    VkBufferCreateInfo bufInfo = {};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.pNext = nullptr;
+    bufInfo.flags = 0;
+    bufInfo.size = size;
+    bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufInfo.queueFamilyIndexCount = 0;
+    bufInfo.pQueueFamilyIndices = nullptr;
+    result = vkCreateBuffer(deviceObj->device, &bufInfo, nullptr, &staging.buffer);
+    assert(result == VK_SUCCESS);
+
+    VkMemoryRequirements memRqrmnt;
+    vkGetBufferMemoryRequirements(deviceObj->device, staging.buffer, &memRqrmnt);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.memoryTypeIndex = 0;
+    allocInfo.allocationSize = memRqrmnt.size;
+    pass = deviceObj->memoryTypeFromProperties(memRqrmnt.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                               &allocInfo.memoryTypeIndex);
+    assert(pass);
+    result = vkAllocateMemory(deviceObj->device, &allocInfo, nullptr, &staging.memory);
+    assert(result == VK_SUCCESS);
+
+    void *pData;
+    result = vkMapMemory(deviceObj->device, staging.memory, 0, size, 0, &pData);
+    assert(result == VK_SUCCESS);
+    memcpy(pData, data, size);
+    vkUnmapMemory(deviceObj->device, staging.memory);
+
+    result = vkBindBufferMemory(deviceObj->device, staging.buffer, staging.memory, 0);
+    assert(result == VK_SUCCESS);
+    stagingBuffers.push_back(staging);
+
+    VkBufferCopy region = {};
+    region.srcOffset = 0;
+    region.dstOffset = 0;
+    region.size = size;
+    vkCmdCopyBuffer(cmdBuf, staging.buffer, dstBuffer, 1, &region);
+
+    // Release the buffer to the graphics family. The matching acquire is recorded by
+    // recordAcquireBarriers(), it also makes the copy visible to the graphics accesses.
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = dstBuffer;
+    barrier.offset = 0;
+    barrier.size = size;
+    if (deviceObj->hasDedicatedTransferQueue()) {
+        barrier.srcQueueFamilyIndex = deviceObj->transferQueueIndex;
+        barrier.dstQueueFamilyIndex = deviceObj->graphicsQueueWithPresentIndex;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                             nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccessMask;
+    acquireBarriers.push_back(barrier);
+    acquireStageMask |= dstStageMask;
+}
+
+void VulkanUploadManager::submit() {
+    if (stagingBuffers.empty() || submitted) {
+        return;
+    }
+
+    CommandBufferMgr::endCommandBuffer(cmdBuf);
+
+    // Without a dedicated family this is the graphics timeline, its submissions are serialized
+    VulkanTimeline *timeline = deviceObj->getTimeline(QUEUE_TRANSFER);
+    uploadPoint = timeline->getPoint(timeline->submit(&cmdBuf, 1));
+    submitted = true;
+}
+
+TimelinePoint VulkanUploadManager::recordAcquireBarriers(VkCommandBuffer graphicsCmdBuf,
+                                                         VkPipelineStageFlags *waitStageMask) {
+    if (!submitted) {
+        return TimelinePoint{VK_NULL_HANDLE, 0};
+    }
+
+    // The timeline wait already makes the copies visible when no ownership changes hands
+    if (deviceObj->hasDedicatedTransferQueue()) {
+        vkCmdPipelineBarrier(graphicsCmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, acquireStageMask, 0, 0, nullptr,
+                             (uint32_t) acquireBarriers.size(), acquireBarriers.data(), 0, nullptr);
+    }
+    *waitStageMask = acquireStageMask;
+    return uploadPoint;
+}
+
+void VulkanUploadManager::finish() {
+    if (!submitted) {
+        return;
+    }
+    VulkanTimeline::wait(deviceObj, uploadPoint);
+
+    for (auto &staging : stagingBuffers) {
+        vkDestroyBuffer(deviceObj->device, staging.buffer, nullptr);
+        vkFreeMemory(deviceObj->device, staging.memory, nullptr);
+    }
+    stagingBuffers.clear();
+    acquireBarriers.clear();
+    acquireStageMask = 0;
+    submitted = false;
+}
+
+void VulkanUploadManager::destroy() {
+    if (deviceObj == nullptr) {
+        return;
+    }
+    finish();
+    vkDestroyCommandPool(deviceObj->device, cmdPool, nullptr);
+    cmdBuf = VK_NULL_HANDLE;
+    deviceObj = nullptr;
+}
@@ -25,7 +25,7 @@ void CommandBufferMgr::beginCommandBuffer(VkCommandBuffer cmdBuf, VkCommandBuffe
     VkResult result;
     if (inCmdBufferInfo) {
         result = vkBeginCommandBuffer(cmdBuf, inCmdBufferInfo);
-        assert(result);
+        assert(result == VK_SUCCESS);
         return;
     }
 
@@ -49,6 +49,27 @@ void CommandBufferMgr::beginCommandBuffer(VkCommandBuffer cmdBuf, VkCommandBuffe
     assert(result == VK_SUCCESS);
 }
 
+void CommandBufferMgr::beginSecondaryCommandBuffer(VkCommandBuffer cmdBuf, VkRenderPass renderPass,
+                                                   VkFramebuffer framebuffer, VkCommandBufferUsageFlags flags,
+                                                   const VkCommandBufferInheritanceRenderingInfo *renderingInfo) {
+    VkCommandBufferInheritanceInfo cmdBufInheritInfo = {};
+    cmdBufInheritInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    cmdBufInheritInfo.pNext = renderingInfo;
+    cmdBufInheritInfo.renderPass = renderPass;
+    cmdBufInheritInfo.subpass = 0;
+    cmdBufInheritInfo.framebuffer = framebuffer;
+    cmdBufInheritInfo.occlusionQueryEnable = VK_FALSE;
+    cmdBufInheritInfo.queryFlags = 0;
+    cmdBufInheritInfo.pipelineStatistics = 0;
+
+    VkCommandBufferBeginInfo cmdBufInfo = {};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufInfo.pNext = nullptr;
+    cmdBufInfo.flags = flags | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    cmdBufInfo.pInheritanceInfo = &cmdBufInheritInfo;
+    beginCommandBuffer(cmdBuf, &cmdBufInfo);
+}
+
 void CommandBufferMgr::endCommandBuffer(VkCommandBuffer cmdBuf) {
     VkResult result;
     result = vkEndCommandBuffer(cmdBuf);